@@ -0,0 +1,395 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//
+// cost of Accumulator::push
+//
+// usage: common-bench-accumulator [iterations]
+//
+
+#include "common/Accumulator.h"
+#include "common/accumulator_kernels.h"
+#include "common/ConcurrentAccumulator.h"
+#include "common/logging.h"
+#include "common/string_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+#define TAG "BenchAccumulator"
+
+
+using enum Status;
+
+
+static volatile double sink = 0.0;
+
+
+template <typename F>
+static void run(const char *name, int iterations, F f, const char *unit = "push") {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++) {
+        f(i);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    std::printf("%-40s %10.1f ns/%s\n", name, static_cast<double>(nanos) / iterations, unit);
+}
+
+
+//
+// threads push at once, each iterations times
+//
+template <typename F>
+static void runThreads(const char *name, int threadCount, int iterations, F f) {
+
+    std::latch start(threadCount + 1);
+
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&start, &f, t, iterations]() {
+            start.arrive_and_wait();
+            for (int i = 0; i < iterations; i++) {
+                f(t, i);
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    start.arrive_and_wait();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+
+    double pushes = static_cast<double>(threadCount) * iterations;
+
+    std::printf("%-40s %10.1f Mpush/s\n", name, pushes * 1000.0 / static_cast<double>(nanos));
+}
+
+
+//
+// the previous push: copy the ring, sum it twice, sort it, and filter into a second vector
+//
+struct CopyAndSortAccumulator {
+
+    size_t capacity;
+    std::vector<int64_t> buf;
+    size_t index = 0;
+    double filteredMean = 0.0;
+    double mean = 0.0;
+
+    explicit CopyAndSortAccumulator(size_t capacityIn) : capacity(capacityIn) {
+        buf.reserve(capacity);
+    }
+
+    void push(int64_t val) {
+
+        if (buf.size() == capacity) {
+            buf[index] = val;
+        } else {
+            buf.push_back(val);
+        }
+
+        index = ((index + 1) % capacity);
+
+        std::vector<int64_t> tmp = buf;
+
+        double sum = 0.0;
+        for (int64_t x : tmp) {
+            sum += static_cast<double>(x);
+        }
+
+        mean = sum / static_cast<double>(tmp.size());
+
+        if (tmp.size() < 2) {
+            filteredMean = mean;
+            return;
+        }
+
+        sum = 0.0;
+        for (int64_t x : tmp) {
+            sum += (static_cast<double>(x) - mean) * (static_cast<double>(x) - mean);
+        }
+
+        double sd = std::sqrt(sum / static_cast<double>(tmp.size() - 1));
+
+        std::sort(tmp.begin(), tmp.end()); // NOLINT(*-use-ranges)
+
+        double median; // NOLINT(*-init-variables)
+        if (tmp.size() % 2 == 0) {
+            median = static_cast<double>(tmp[(tmp.size() - 1) / 2] + tmp[tmp.size() / 2]) / 2.0;
+        } else {
+            median = static_cast<double>(tmp[tmp.size() / 2]);
+        }
+
+        std::vector<int64_t> tmp2;
+        tmp2.reserve(tmp.size());
+        for (int64_t x : tmp) {
+            if (std::abs(static_cast<double>(x) - median) <= sd) {
+                tmp2.push_back(x);
+            }
+        }
+
+        sum = 0.0;
+        for (int64_t x : tmp2) {
+            sum += static_cast<double>(x);
+        }
+
+        filteredMean = sum / static_cast<double>(tmp2.size());
+    }
+};
+
+
+//
+// frame times in us around 16667, with some jitter and an occasional spike
+//
+static int64_t Sample(int i) {
+
+    auto u = static_cast<uint32_t>(i) * 2654435761u;
+
+    int64_t val = 16667 + static_cast<int64_t>(u >> 24) - 128;
+
+    if (i % 101 == 0) {
+        val += 20000;
+    }
+
+    return val;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    int iterations = 1000000;
+
+    if (argc > 1) {
+        if (parseInt(argv[1], &iterations) != OK || iterations <= 0) { // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::fprintf(stderr, "usage: common-bench-accumulator [iterations]\n");
+            return 2;
+        }
+    }
+
+    for (size_t capacity : { 60u, 1000u }) {
+
+        char name[64];
+
+        //
+        // the old push is so slow that it gets fewer iterations
+        //
+        CopyAndSortAccumulator old(capacity);
+
+        std::snprintf(name, sizeof(name), "copy and sort, capacity %zu", capacity);
+
+        run(name, std::max(iterations / 100, 1), [&old](int i) {
+            old.push(Sample(i));
+            sink = old.filteredMean;
+        });
+
+        Accumulator acc(capacity);
+
+        std::snprintf(name, sizeof(name), "Accumulator, capacity %zu", capacity);
+
+        run(name, iterations, [&acc](int i) {
+            acc.push(Sample(i));
+            sink = acc.getFilteredMean();
+        });
+
+        //
+        // many pushes between reads
+        //
+        for (int readEvery : { 10, 1000 }) {
+
+            for (AccumulatorMode mode : { AccumulatorMode::EAGER, AccumulatorMode::LAZY }) {
+
+                Accumulator readLight(capacity, mode);
+
+                std::snprintf(name, sizeof(name), "%s, capacity %zu, read every %d",
+                    (mode == AccumulatorMode::EAGER) ? "EAGER" : "LAZY", capacity, readEvery);
+
+                run(name, iterations, [&readLight, readEvery](int i) {
+                    readLight.push(Sample(i));
+                    if (i % readEvery == 0) {
+                        sink = readLight.getFilteredMean();
+                    }
+                });
+            }
+        }
+    }
+
+    //
+    // compile-time capacity, power of two and not
+    //
+    common::Accumulator<int64_t, 64> fixed64;
+    common::Accumulator<int64_t, 60> fixed60;
+    Accumulator lazy64(64, AccumulatorMode::LAZY);
+
+    run("LAZY, capacity 64, push only", iterations, [&lazy64](int i) {
+        lazy64.push(Sample(i));
+    });
+
+    run("Accumulator<int64_t, 64>, push only", iterations, [&fixed64](int i) {
+        fixed64.push(Sample(i));
+    });
+
+    run("Accumulator<int64_t, 60>, push only", iterations, [&fixed60](int i) {
+        fixed60.push(Sample(i));
+    });
+
+    sink = lazy64.getMean() + fixed64.getMean() + fixed60.getMean();
+
+    run("LAZY, capacity 64, read every 10", iterations, [&lazy64](int i) {
+        lazy64.push(Sample(i));
+        if (i % 10 == 0) {
+            sink = lazy64.getFilteredMean();
+        }
+    });
+
+    run("Accumulator<int64_t, 64>, read every 10", iterations, [&fixed64](int i) {
+        fixed64.push(Sample(i));
+        if (i % 10 == 0) {
+            sink = fixed64.getFilteredMean();
+        }
+    });
+
+    //
+    // reductions over 1000 samples, per kernel
+    //
+    std::vector<int64_t> samples(1000);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = Sample(static_cast<int>(i));
+    }
+
+    int reductions = std::max(iterations / 1000, 1);
+
+    for (const AccumulatorKernels *kernels : GetAvailableAccumulatorKernels()) {
+
+        char name[64];
+
+        std::snprintf(name, sizeof(name), "%s sum, 1000 samples", kernels->name);
+        run(name, reductions, [kernels, &samples](int i) {
+            (void)i;
+            sink = kernels->sum(samples);
+        }, "call");
+
+        std::snprintf(name, sizeof(name), "%s sumOfSquares, 1000 samples", kernels->name);
+        run(name, reductions, [kernels, &samples](int i) {
+            (void)i;
+            sink = kernels->sumOfSquares(samples, 16667.0);
+        }, "call");
+
+        std::snprintf(name, sizeof(name), "%s sumNear, 1000 samples", kernels->name);
+        run(name, reductions, [kernels, &samples](int i) {
+            (void)i;
+            size_t count = 0;
+            sink = kernels->sumNear(samples, 16667.0, 100.0, &count);
+        }, "call");
+    }
+
+    //
+    // bulk push of 1000 samples, then a read
+    //
+    for (AccumulatorMode mode : { AccumulatorMode::EAGER, AccumulatorMode::LAZY }) {
+
+        const char *modeName = (mode == AccumulatorMode::EAGER) ? "EAGER" : "LAZY";
+
+        char name[64];
+
+        Accumulator one(1000, mode);
+
+        std::snprintf(name, sizeof(name), "%s, 1000 pushes and a read", modeName);
+        run(name, reductions, [&one, &samples](int i) {
+            (void)i;
+            for (int64_t v : samples) {
+                one.push(v);
+            }
+            sink = one.getFilteredMean();
+        }, "batch");
+
+        Accumulator bulk(1000, mode);
+
+        std::snprintf(name, sizeof(name), "%s, bulk push of 1000 and a read", modeName);
+        run(name, reductions, [&bulk, &samples](int i) {
+            (void)i;
+            bulk.push(std::span<const int64_t>(samples));
+            sink = bulk.getFilteredMean();
+        }, "batch");
+    }
+
+    //
+    // pushes from several threads at once, total throughput
+    //
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+
+    for (int threadCount : { 1, 2, 4, 8 }) {
+
+        char name[64];
+
+        Accumulator locked(1000, AccumulatorMode::LAZY);
+        std::mutex lockedMutex;
+
+        std::snprintf(name, sizeof(name), "mutex + LAZY, %d threads", threadCount);
+        runThreads(name, threadCount, iterations, [&locked, &lockedMutex](int t, int i) {
+            std::lock_guard<std::mutex> lock(lockedMutex);
+            locked.push(Sample(i + t));
+        });
+
+        ConcurrentAccumulator concurrent(1000);
+
+        std::snprintf(name, sizeof(name), "ConcurrentAccumulator, %d threads", threadCount);
+        runThreads(name, threadCount, iterations, [&concurrent](int t, int i) {
+            concurrent.push(Sample(i + t));
+        });
+
+        sink = locked.getMean() + concurrent.getMean();
+    }
+
+    return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
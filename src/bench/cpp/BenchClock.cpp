@@ -0,0 +1,220 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//
+// cost of reading the various clocks and of formatting times
+//
+// usage: common-bench-clock [iterations]
+//
+
+#include "common/clock.h"
+#include "common/logging.h"
+#include "common/string_utils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <locale>
+#include <thread>
+
+
+#define TAG "BenchClock"
+
+
+using enum Status;
+
+
+static volatile int64_t sink = 0;
+
+
+template <typename F>
+static void run(const char *name, int iterations, F f) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++) {
+        f(i);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    std::printf("%-32s %8.3f ns/call\n", name, static_cast<double>(nanos) / iterations);
+}
+
+
+//
+// the previous formatTime: std::localtime and a swap of the global locale around strftime
+//
+static void formatTimeLocaltime(time_t timeV, char *buf, size_t len) {
+
+    tm *timeinfo = std::localtime(&timeV); // NOLINT(concurrency-mt-unsafe)
+
+    std::locale oldLocale = std::locale::global(std::locale::classic());
+
+    std::strftime(buf, len, "%F %X", timeinfo);
+
+    std::locale::global(oldLocale);
+}
+
+
+int main(int argc, char *argv[]) {
+
+    int iterations = 10000000;
+
+    if (argc > 1) {
+        if (parseInt(argv[1], &iterations) != OK || iterations <= 0) { // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::fprintf(stderr, "usage: common-bench-clock [iterations]\n");
+            return 2;
+        }
+    }
+
+    std::printf("fastClockUsesCycles: %d\n", fastClockUsesCycles());
+
+    run("empty loop", iterations, [](int i) {
+        sink = i;
+    });
+
+    run("uptimeMillis", iterations, [](int i) {
+        (void)i;
+        sink = uptimeMillis();
+    });
+
+    StartCoarseClock(COARSECLOCK_TICKER);
+
+    run("uptimeMillisCoarse, ticker", iterations, [](int i) {
+        (void)i;
+        sink = uptimeMillisCoarse();
+    });
+
+    StartCoarseClock(COARSECLOCK_KERNEL);
+
+    run("uptimeMillisCoarse, kernel", iterations, [](int i) {
+        (void)i;
+        sink = uptimeMillisCoarse();
+    });
+
+    StopCoarseClock();
+
+    run("uptimeMicros", iterations, [](int i) {
+        (void)i;
+        sink = uptimeMicros();
+    });
+
+    run("uptimeNanos", iterations, [](int i) {
+        (void)i;
+        sink = uptimeNanos();
+    });
+
+    run("uptimeNanosFast", iterations, [](int i) {
+        (void)i;
+        sink = uptimeNanosFast();
+    });
+
+    run("readCycles", iterations, [](int i) {
+        (void)i;
+        sink = static_cast<int64_t>(readCycles());
+    });
+
+    run("MonotonicClock::now", iterations, [](int i) {
+        (void)i;
+        sink = common::MonotonicClock::now().time_since_epoch().count();
+    });
+
+    run("FastClock::now", iterations, [](int i) {
+        (void)i;
+        sink = common::FastClock::now().time_since_epoch().count();
+    });
+
+    run("steady_clock::now", iterations, [](int i) {
+        (void)i;
+        sink = std::chrono::steady_clock::now().time_since_epoch().count();
+    });
+
+    //
+    // formatting, with a new second every call so that nothing can be reused from the previous call
+    //
+    char buf[FORMATTIME_ISO8601_MICROS_LEN + 1];
+
+    time_t base = std::time(nullptr);
+
+    run("formatTime, localtime+locale", iterations, [&buf, base](int i) {
+        formatTimeLocaltime(base + i, buf, sizeof(buf));
+        sink = buf[0];
+    });
+
+    run("formatTime", iterations, [&buf, base](int i) {
+        formatTime(base + i, buf, sizeof(buf));
+        sink = buf[0];
+    });
+
+    int64_t baseMillis = timeSinceEpochMillis();
+
+    run("formatTimeIso8601Millis", iterations, [&buf, baseMillis](int i) {
+        formatTimeIso8601Millis(baseMillis + (i * 1001LL), buf, sizeof(buf));
+        sink = buf[0];
+    });
+
+    int64_t baseMicros = timeSinceEpochMicros();
+
+    run("formatTimeIso8601Micros", iterations, [&buf, baseMicros](int i) {
+        formatTimeIso8601Micros(baseMicros + (i * 1000001LL), buf, sizeof(buf));
+        sink = buf[0];
+    });
+
+    //
+    // how late sleeps wake up, 1 ms deadlines
+    //
+    int sleeps = 500;
+
+    int64_t late = 0;
+    for (int i = 0; i < sleeps; i++) {
+        int64_t deadline = uptimeMicros() + 1000;
+        std::this_thread::sleep_until(common::MonotonicClock::time_point(std::chrono::microseconds(deadline)));
+        late += uptimeMicros() - deadline;
+    }
+
+    std::printf("%-32s %8.3f us late\n", "sleep_until", static_cast<double>(late) / sleeps);
+
+    late = 0;
+    for (int i = 0; i < sleeps; i++) {
+        int64_t deadline = uptimeMicros() + 1000;
+        late += sleepUntilMicros(deadline) - deadline;
+    }
+
+    std::printf("%-32s %8.3f us late, spins %lld us\n", "sleepUntilMicros", static_cast<double>(late) / sleeps,
+        static_cast<long long>(sleepSpinMicros()));
+
+    return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
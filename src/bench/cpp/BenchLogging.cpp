@@ -0,0 +1,213 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//
+// cost of LOG* calls whose level is disabled, and of formatting enabled LOGI, LOGI_expanded, and LOGI_KV calls into a
+// sink that discards them
+//
+// usage: common-bench-logging [iterations]
+//
+
+#include "common/flight_recorder.h"
+#include "common/log_kv.h"
+#include "common/log_shm_sink.h"
+#include "common/log_stats.h"
+#include "common/logging.h"
+#include "common/string_utils.h"
+
+#include <chrono>
+#include <cstdio>
+
+
+#define TAG "BenchLogging"
+
+
+using enum Status;
+
+
+static volatile int sink = 0;
+
+
+//
+// never called when the level is disabled
+//
+static int expensive() {
+    sink = sink + 1;
+    return sink;
+}
+
+static void discardWrite(void *context, int level, const char *tag, const char *buf, size_t len) {
+    (void)context;
+    (void)level;
+    (void)tag;
+    (void)buf;
+    sink = static_cast<int>(len);
+}
+
+static const LogSink discardSink = { discardWrite, nullptr, nullptr };
+
+
+template <typename F>
+static void run(const char *name, int iterations, F f) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++) {
+        f(i);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    std::printf("%-32s %8.3f ns/call\n", name, static_cast<double>(nanos) / iterations);
+}
+
+
+int main(int argc, char *argv[]) {
+
+    int iterations = 100000000;
+
+    if (argc > 1) {
+        if (parseInt(argv[1], &iterations) != OK || iterations <= 0) { // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::fprintf(stderr, "usage: common-bench-logging [iterations]\n");
+            return 2;
+        }
+    }
+
+    SetLogLevel(LOGLEVEL_INFO);
+
+    run("empty loop", iterations, [](int i) {
+        sink = i;
+    });
+
+    run("LOGD disabled", iterations, [](int i) {
+        LOGD("i: %d", i);
+    });
+
+    run("LOGD disabled, expensive arg", iterations, [](int i) {
+        LOGD("i: %d %d", i, expensive());
+    });
+
+    run("LOGT disabled, 4 args", iterations, [](int i) {
+        LOGT("%d %d %s %f", i, i + 1, "abc", 1.5);
+    });
+
+    run("LOGD_expanded disabled", iterations, [](int i) {
+        LOGD_expanded(TAG, "i: %d", i);
+    });
+
+    if (sink != iterations - 1) {
+        std::fprintf(stderr, "expensive() was evaluated\n");
+        return 1;
+    }
+
+    if (StartFlightRecorder(4096) != OK) {
+        return 1;
+    }
+
+    run("LOGD recorded", iterations, [](int i) {
+        LOGD("i: %d", i);
+    });
+
+    run("LOGT recorded, 4 args", iterations, [](int i) {
+        LOGT("%d %d %s %f", i, i + 1, "abc", 1.5);
+    });
+
+    StopFlightRecorder();
+
+    StartLogStats();
+
+    run("LOGD disabled, counted", iterations, [](int i) {
+        LOGD("i: %d", i);
+    });
+
+    StopLogStats();
+
+    SetLogSink(&discardSink);
+
+    //
+    // LOGI_expanded goes through LogInfoV, which leaves fmt to vsnprintf, and LOGI uses the format it parsed at
+    // compile time
+    //
+    run("LOGI_expanded printf, 3 args", iterations / 10, [](int i) {
+        LOGI_expanded(TAG, "frame ms=%f fps=%d name=%s\n", i * 0.25, i, "main");
+    });
+
+    run("LOGI printf, 3 args", iterations / 10, [](int i) {
+        LOGI("frame ms=%f fps=%d name=%s", i * 0.25, i, "main");
+    });
+
+    run("LOGI_expanded printf, 3 ints", iterations / 10, [](int i) {
+        LOGI_expanded(TAG, "x=%d y=%d z=%d\n", i, i + 1, i + 2);
+    });
+
+    run("LOGI printf, 3 ints", iterations / 10, [](int i) {
+        LOGI("x=%d y=%d z=%d", i, i + 1, i + 2);
+    });
+
+    SetLogPrefix(LOGPREFIX_ALL);
+
+    run("LOGI printf, 3 args, prefix", iterations / 10, [](int i) {
+        LOGI("frame ms=%f fps=%d name=%s", i * 0.25, i, "main");
+    });
+
+    SetLogPrefix(LOGPREFIX_NONE);
+
+    StartLogStats();
+
+    run("LOGI printf, 3 args, counted", iterations / 10, [](int i) {
+        LOGI("frame ms=%f fps=%d name=%s", i * 0.25, i, "main");
+    });
+
+    StopLogStats();
+
+    run("LOGI_KV, 3 pairs", iterations / 10, [](int i) {
+        LOGI_KV("frame", "ms", i * 0.25, "fps", i, "name", "main");
+    });
+
+    SetLogSink(nullptr);
+
+    if (StartSharedMemoryLogging("/common-bench-logging", 4096) == OK) {
+
+        run("LOGI printf, 3 args, shm ring", iterations / 10, [](int i) {
+            LOGI("frame ms=%f fps=%d name=%s", i * 0.25, i, "main");
+        });
+
+        StopSharedMemoryLogging();
+
+        RemoveSharedMemoryLog("/common-bench-logging");
+    }
+
+    return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -18,43 +18,311 @@
 
 #pragma once
 
+#include <algorithm> // for nth_element, max_element
+#include <array>
+#include <cmath> // for sqrt, abs
+#include <type_traits> // for is_same_v
 #include <vector>
 #include <span>
 #include <cstdint>
 #include <cstddef>
 
 
+//
+// EAGER: push keeps the statistics up to date, in O(log n)
+// LAZY: push only records the sample, and the getters compute the statistics in O(n) when there are new samples
+//
+// LAZY is for accumulators that get many pushes between reads
+//
+enum class AccumulatorMode : uint8_t {
+    EAGER,
+    LAZY,
+};
+
+//
+// statistics over the last capacity samples
+//
+// in EAGER mode, push is O(log n) and does not allocate:
+// running sums for the mean and variance are updated as samples enter and leave the window,
+// and the samples are also kept in a treap ordered by value, with counts and sums in each node, for the median and
+// the sum of the samples within one sd of it
+//
 class Accumulator {
 private:
 
+    //
+    // node i of the treap holds buf[i]
+    //
+    struct Node {
+        int64_t value;
+        uint32_t priority;
+        uint32_t left;
+        uint32_t right;
+        uint32_t count;
+        double sum;
+    };
+
     size_t _capacity;
+    AccumulatorMode mode;
     std::vector<int64_t> buf;
     size_t index;
-    double filteredMean;
-    double mean;
+
+    //
+    // cached by the getters in LAZY mode
+    //
+    mutable double filteredMean;
+    mutable double mean;
+    mutable bool dirty;
+
+    //
+    // LAZY mode: copy of buf for nth_element
+    //
+    mutable std::vector<int64_t> scratch;
+
+    std::vector<Node> nodes;
+    uint32_t root;
+    uint32_t rng;
+    int64_t shift;
+    double shiftedSum;
+    double shiftedSumSquares;
 
     double computeFilteredMean() const;
     double computeMean() const;
+    void computeFromSamples() const;
+    void pushEager(int64_t val);
+    void updateStatistics();
+
+    void momentsAdd(int64_t val);
+    void momentsRemove(int64_t val);
+    void momentsResync();
+    double momentsMean() const;
+    double momentsVariance() const;
+
+    bool nodeLess(uint32_t a, uint32_t b) const;
+    void nodeUpdate(uint32_t t);
+    uint32_t treapMerge(uint32_t l, uint32_t r);
+    void treapSplit(uint32_t t, uint32_t key, uint32_t *l, uint32_t *r);
+    uint32_t treapErase(uint32_t t, uint32_t key);
+    void treapInsert(uint32_t key);
+    int64_t treapKth(size_t k) const;
+    void treapRange(double lo, double hi, size_t *count, double *sum) const;
 
 public:
 
-    explicit Accumulator(size_t capacity);
+    explicit Accumulator(size_t capacity, AccumulatorMode mode = AccumulatorMode::EAGER);
 
     size_t capacity() const;
 
+    //
+    // in LAZY mode, the first call after a push computes the statistics, so concurrent calls are not safe even
+    // though they are const
+    //
     double getFilteredMean() const;
     double getMean() const;
 
     int64_t last() const;
     void push(int64_t val);
+
+    //
+    // same as pushing each sample, but in EAGER mode the statistics are only computed once, and in LAZY mode the
+    // samples are copied in runs
+    //
+    void push(std::span<const int64_t> vals);
+
     bool empty() const;
     size_t size() const;
-    int64_t &operator[](size_t index);
+
+    //
+    // read-only, because the statistics are only updated by push
+    //
+    int64_t operator[](size_t index) const;
 
     void copyContiguous(std::span<int64_t> dst, size_t *count);
 };
 
 
+namespace common {
+
+//
+// Accumulator with a compile-time capacity and the samples in an inline std::array, so it can live inside other
+// objects with no heap allocation
+//
+// when N is a power of two, the ring index wraps with a mask
+//
+// the statistics are computed by the getters, in O(N) over a fixed-size array, which the compiler can unroll
+// getMean and getFilteredMean must not be called when empty
+//
+template <typename T, size_t N>
+class Accumulator {
+
+    static_assert(std::is_same_v<T, int64_t> || std::is_same_v<T, double> || std::is_same_v<T, float>,
+        "T must be int64_t, double, or float");
+    static_assert(N > 0, "N must be greater than 0");
+
+private:
+
+    static constexpr bool POWER_OF_TWO = ((N & (N - 1)) == 0);
+
+    std::array<T, N> buf{};
+    size_t index = 0;
+    size_t count = 0;
+
+    static size_t next(size_t i) {
+        if constexpr (POWER_OF_TWO) {
+            return (i + 1) & (N - 1);
+        } else {
+            return (i + 1 == N) ? 0 : (i + 1);
+        }
+    }
+
+    //
+    // call f with the samples, as a span with a static extent when full
+    //
+    template <typename F>
+    double withSamples(F f) const {
+
+        if (count == N) {
+            return f(std::span<const T, N>(buf));
+        }
+
+        return f(std::span<const T>(buf.data(), count));
+    }
+
+    static double sum(auto samples) {
+
+        double s = 0.0;
+        for (T x : samples) {
+            s += static_cast<double>(x);
+        }
+
+        return s;
+    }
+
+    static double sumOfSquares(auto samples, double mean) {
+
+        double s = 0.0;
+        for (T x : samples) {
+            s += (static_cast<double>(x) - mean) * (static_cast<double>(x) - mean);
+        }
+
+        return s;
+    }
+
+public:
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+    double getMean() const {
+        return withSamples([](auto samples) {
+            return sum(samples) / static_cast<double>(samples.size());
+        });
+    }
+
+    //
+    // the mean of the samples within one sample standard deviation of the median
+    //
+    double getFilteredMean() const {
+        return withSamples([](auto samples) {
+
+            size_t n = samples.size();
+
+            if (n == 1) {
+                return static_cast<double>(samples[0]);
+            }
+
+            double mean = sum(samples) / static_cast<double>(n);
+
+            double sd = std::sqrt(sumOfSquares(samples, mean) / static_cast<double>(n - 1));
+
+            std::array<T, N> tmp; // NOLINT(*-pro-type-member-init)
+            std::copy(samples.begin(), samples.end(), tmp.begin()); // NOLINT(*-use-ranges)
+
+            auto first = tmp.begin();
+            auto last = first + static_cast<ptrdiff_t>(n);
+            auto mid = first + static_cast<ptrdiff_t>(n / 2);
+
+            std::nth_element(first, mid, last); // NOLINT(*-use-ranges)
+
+            double median; // NOLINT(*-init-variables)
+            if (n % 2 == 0) {
+                median = (static_cast<double>(*std::max_element(first, mid)) + static_cast<double>(*mid)) / 2.0; // NOLINT(*-use-ranges)
+            } else {
+                median = static_cast<double>(*mid);
+            }
+
+            size_t kept = 0;
+            double s = 0.0;
+            for (T x : samples) {
+                if (std::abs(static_cast<double>(x) - median) <= sd) {
+                    kept++;
+                    s += static_cast<double>(x);
+                }
+            }
+
+            return s / static_cast<double>(kept);
+        });
+    }
+
+    T last() const {
+        if constexpr (POWER_OF_TWO) {
+            return buf[(index - 1) & (N - 1)];
+        } else {
+            return buf[(index == 0) ? (N - 1) : (index - 1)];
+        }
+    }
+
+    void push(T val) {
+
+        buf[index] = val;
+
+        index = next(index);
+
+        if (count < N) {
+            count++;
+        }
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    //
+    // by slot in the ring, like ::Accumulator
+    //
+    T operator[](size_t i) const {
+        return buf[i];
+    }
+
+    //
+    // oldest first
+    //
+    void copyContiguous(std::span<T> dst, size_t *countp) const {
+
+        if (count != N) {
+
+            std::copy(buf.begin(), buf.begin() + static_cast<ptrdiff_t>(count), dst.begin()); // NOLINT(*-use-ranges)
+
+        } else {
+
+            auto split = buf.begin() + static_cast<ptrdiff_t>(index);
+
+            auto out = std::copy(split, buf.end(), dst.begin()); // NOLINT(*-use-ranges)
+            std::copy(buf.begin(), split, out); // NOLINT(*-use-ranges)
+        }
+
+        *countp = count;
+    }
+};
+
+} // namespace common
+
+
 
 
 
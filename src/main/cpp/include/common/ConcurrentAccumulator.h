@@ -0,0 +1,133 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+
+//
+// Accumulator that any number of threads can push to at once
+//
+// each thread pushes to its own shard, a ring of the last shardCapacity samples from that thread, with no locks and
+// no shared writes: a store of the sample and a release store of the shard's count
+// shards are cache-line aligned, so pushing threads do not share cache lines
+//
+// the first maxShards threads that are alive at once get their own shards, and threads past that share one
+// extra shard behind a mutex
+// a thread that exits gives its shard to the next thread that starts, along with the samples in it
+//
+// the getters merge the shards into one window, which takes O(n) for the mean and O(n log n) at worst for the rest,
+// so they are for occasional reads
+// samples that are pushed while a getter runs may or may not be counted
+//
+class ConcurrentAccumulator {
+private:
+
+    struct alignas(64) Shard {
+
+        //
+        // samples ever pushed, stored with release after the sample
+        //
+        std::atomic<uint64_t> count;
+
+        //
+        // next slot to write, only used by the writer
+        //
+        size_t next;
+
+        std::atomic<int64_t> *slots;
+    };
+
+    size_t _shardCapacity;
+    size_t maxShards;
+
+    //
+    // maxShards + 1, the last one shared by any other threads
+    //
+    std::unique_ptr<Shard[]> shards;
+
+    //
+    // the rings of all shards, padded so that no two shards share a cache line
+    //
+    std::unique_ptr<std::atomic<int64_t>[]> storage;
+
+    std::mutex overflowMutex;
+
+    static void pushToShard(Shard &shard, size_t capacity, int64_t val);
+
+public:
+
+    explicit ConcurrentAccumulator(size_t shardCapacity, size_t maxShards = 64);
+
+    size_t shardCapacity() const;
+
+    void push(int64_t val);
+
+    //
+    // samples in the combined window of all shards
+    //
+    size_t size() const;
+    bool empty() const;
+
+    //
+    // copy the combined window into dst, in no particular order
+    //
+    void copySamples(std::vector<int64_t> &dst) const;
+
+    //
+    // these must not be called when empty
+    //
+    double getMean() const;
+
+    //
+    // the mean of the samples within one sample standard deviation of the median, as in Accumulator
+    //
+    double getFilteredMean() const;
+
+    //
+    // nearest-rank quantile, q in [0, 1], the smallest sample with at least q of the samples at or below it
+    //
+    int64_t getQuantile(double q) const;
+
+    //
+    // several quantiles from one merge, qs in increasing order
+    //
+    void getQuantiles(std::span<const double> qs, std::span<int64_t> out) const;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
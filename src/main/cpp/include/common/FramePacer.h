@@ -0,0 +1,98 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/Accumulator.h"
+
+#include <cstdint>
+#include <cstddef>
+
+
+//
+// paces a render or simulation loop at a fixed period:
+//
+// FramePacer pacer(16667);
+// while (running) {
+//     int64_t deadline = pacer.waitForNextFrame();
+//     ...
+// }
+//
+// deadlines are uptimeMicros() values one period apart, and each wait uses sleepUntilMicros
+//
+// a frame that runs past one or more deadlines skips them and counts them as missed, so that later deadlines stay
+// in phase instead of bunching up to catch up
+//
+class FramePacer {
+private:
+
+    int64_t periodMicros;
+    int64_t nextDeadline;
+    int64_t missed;
+    Accumulator overshoot;
+
+public:
+
+    explicit FramePacer(int64_t periodMicros, size_t historyCapacity = 120);
+
+    int64_t period() const;
+
+    //
+    // takes effect from the next deadline on
+    //
+    void setPeriod(int64_t periodMicros);
+
+    //
+    // start over after a pause, so that the next wait does not count the pause as missed frames
+    //
+    // keeps missedFrames and getOvershoot
+    //
+    void reset();
+
+    //
+    // sleep until the next deadline and return it
+    //
+    // the first call after construction or reset starts the pacer, and its deadline is one period after the call
+    //
+    int64_t waitForNextFrame();
+
+    //
+    // microseconds that each recent wait woke after its deadline
+    //
+    const Accumulator &getOvershoot() const;
+
+    //
+    // deadlines skipped because a frame ran past them
+    //
+    int64_t missedFrames() const;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,78 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+
+//
+// reductions over int64_t samples, used by Accumulator
+//
+// each sample is converted to double exactly as static_cast<double> would, and is compared exactly as the scalar
+// code does, but the sums are added in a different order, so results may differ from scalar in the last bits
+// sums of integers that stay below 2^53 are exact in any order
+//
+struct AccumulatorKernels {
+
+    const char *name;
+
+    //
+    // sum of x
+    //
+    double (*sum)(std::span<const int64_t> x);
+
+    //
+    // sum of (x - mean)^2
+    //
+    double (*sumOfSquares)(std::span<const int64_t> x, double mean);
+
+    //
+    // sum and count of the x with |x - center| <= radius
+    //
+    double (*sumNear)(std::span<const int64_t> x, double center, double radius, size_t *count);
+};
+
+//
+// the fastest kernels that this CPU supports: AVX2 or SSE2 on x86-64, NEON on ARM64, otherwise scalar
+//
+// chosen on the first call
+//
+const AccumulatorKernels *GetAccumulatorKernels();
+
+//
+// every set of kernels that this CPU supports, scalar first, for tests and benchmarks
+//
+std::span<const AccumulatorKernels *const> GetAvailableAccumulatorKernels();
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,111 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/logging.h"
+#include "common/status.h"
+
+#include <cstdarg> // for va_list
+#include <cstdio> // for FILE
+
+
+//
+// Binary logging
+//
+// While binary logging is running, LOGE, LOGW, LOGI, LOGD, and LOGT do not format anything on the calling thread.
+// They record the callsite id, a timestamp, and the raw argument bytes into a thread-local buffer that is written
+// to the file in chunks.
+//
+// LOGF, LOGE_andCaptureUnusual, LOGW_andCaptureUnusual, and direct calls through LOG*_expanded still produce text.
+//
+// Use the common-logdecode tool to turn the file back into text.
+//
+//
+// File format, all integers in native byte order:
+//
+// header:
+//   magic "CLOGBIN1"
+//   int64 timeSinceEpochMillis when logging started
+//   int64 uptimeMicros when logging started
+//
+// site record, written once per callsite per file, before any of its events:
+//   uint8 BINARY_LOG_RECORD_SITE
+//   uint32 id
+//   int32 level
+//   int32 line
+//   uint32 length + bytes of tag, file, fmt
+//
+// event record:
+//   uint8 BINARY_LOG_RECORD_EVENT
+//   uint32 id
+//   int64 uptimeMicros
+//   uint32 length + bytes of arguments encoded by EncodePrintfArgs
+//
+
+#define BINARY_LOG_MAGIC "CLOGBIN1"
+
+#define BINARY_LOG_RECORD_SITE 1
+#define BINARY_LOG_RECORD_EVENT 2
+
+
+//
+// start writing binary records to path, truncating it
+//
+Status StartBinaryLogging(const char *path);
+
+//
+// flush all thread buffers and close the file
+//
+void StopBinaryLogging();
+
+//
+// write all thread buffers to the file
+//
+void FlushBinaryLog();
+
+bool IsBinaryLogging();
+
+//
+// called from LogSite_expanded
+//
+// returns false if the record could not be written, and the caller should fall back to text
+//
+bool BinaryLogWriteV(LogSite *site, va_list args);
+
+//
+// read binary records from in and write text to out
+//
+// if timestamps, then prefix each line with wall-clock time reconstructed from the header
+//
+Status DecodeBinaryLog(FILE *in, FILE *out, bool timestamps);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -46,6 +46,24 @@ extern "C" {
 //
 #define FORMATTIME_LEN 19
 
+//
+// len("2025-12-31T12:59:59.123+01:00") = 29
+// len("2025-12-31T12:59:59.123456+01:00") = 32
+//
+#define FORMATTIME_ISO8601_MILLIS_LEN 29
+#define FORMATTIME_ISO8601_MICROS_LEN 32
+
+//
+// thread-local storage class for nowStrBuf
+//
+#ifdef __cplusplus
+#define COMMON_CLOCK_THREAD_LOCAL thread_local
+#elif _MSC_VER
+#define COMMON_CLOCK_THREAD_LOCAL __declspec(thread)
+#else
+#define COMMON_CLOCK_THREAD_LOCAL _Thread_local
+#endif // __cplusplus
+
 //
 // monotonic
 //
@@ -56,6 +74,98 @@ int64_t uptimeMillis(void);
 //
 int64_t uptimeMicros(void);
 
+//
+// sources for StartCoarseClock
+//
+// COARSECLOCK_OFF: uptimeMillisCoarse calls uptimeMillis
+// COARSECLOCK_KERNEL: uptimeMillisCoarse reads CLOCK_MONOTONIC_COARSE, which is only as fine as the kernel tick
+// COARSECLOCK_TICKER: a background thread publishes uptimeMillis every millisecond, and uptimeMillisCoarse is a single
+// relaxed load
+// COARSECLOCK_AUTO: COARSECLOCK_KERNEL if its resolution is 1 ms or better, otherwise COARSECLOCK_TICKER
+//
+#define COARSECLOCK_OFF 0
+#define COARSECLOCK_KERNEL 1
+#define COARSECLOCK_TICKER 2
+#define COARSECLOCK_AUTO 3
+
+//
+// monotonic, same clock as uptimeMillis, for code that needs millisecond timestamps millions of times a second, such
+// as rate limiters
+//
+// lags uptimeMillis by up to about 1 ms, or by up to a kernel tick with COARSECLOCK_KERNEL
+//
+int64_t uptimeMillisCoarse(void);
+
+//
+// pick the source of uptimeMillisCoarse, usually once at startup
+//
+// COARSECLOCK_KERNEL falls back to COARSECLOCK_TICKER on platforms without CLOCK_MONOTONIC_COARSE
+//
+// the ticker thread is stopped at exit
+//
+void StartCoarseClock(int source);
+
+//
+// go back to COARSECLOCK_OFF
+//
+void StopCoarseClock(void);
+
+//
+// the source in use: COARSECLOCK_OFF, COARSECLOCK_KERNEL, or COARSECLOCK_TICKER
+//
+int GetCoarseClockSource(void);
+
+//
+// monotonic
+//
+int64_t uptimeNanos(void);
+
+//
+// monotonic, same clock as uptimeNanos
+//
+// reads the invariant TSC on x86-64 or CNTVCT_EL0 on ARM64 and converts it with a calibrated multiplier, which takes
+// a few ns instead of a clock_gettime call
+//
+// the first call calibrates the counter against uptimeNanos, which takes about 1 ms, and the calibration is
+// rechecked about once a second after that
+//
+// falls back to the monotonic clock if there is no suitable counter, see fastClockUsesCycles
+//
+// monotonic within a thread
+//
+int64_t uptimeNanosFast(void);
+
+//
+// the raw hardware counter used by uptimeNanosFast
+//
+// on platforms without one, nanoseconds from the monotonic clock
+//
+uint64_t readCycles(void);
+
+//
+// 1 if uptimeNanosFast uses the hardware counter, 0 if it falls back to the monotonic clock
+//
+// calibrates the counter if needed
+//
+int fastClockUsesCycles(void);
+
+//
+// sleep until uptimeMicros() reaches deadlineMicros, and return uptimeMicros() at wakeup
+//
+// sleeps with clock_nanosleep(TIMER_ABSTIME) until shortly before the deadline, then spin-waits with a pause
+// instruction, so that it wakes within a few us of the deadline instead of a scheduler wakeup latency after it
+//
+// how long it spins adapts to the wakeup latency measured by earlier calls, see sleepSpinMicros
+//
+// returns immediately if the deadline has passed
+//
+int64_t sleepUntilMicros(int64_t deadlineMicros);
+
+//
+// how long before the deadline sleepUntilMicros stops sleeping and starts spinning
+//
+int64_t sleepSpinMicros(void);
+
 //
 // NOT monotonic
 //
@@ -69,20 +179,109 @@ int64_t timeSinceEpochSeconds(void);
 //
 int64_t timeSinceEpochMillis(void);
 
-extern char nowStrBuf[FORMATTIME_LEN + 1];
+//
+// NOT monotonic
+//
+int64_t timeSinceEpochMicros(void);
+
+//
+// each thread has its own nowStrBuf
+//
+extern COMMON_CLOCK_THREAD_LOCAL char nowStrBuf[FORMATTIME_LEN + 1];
 
+//
+// compute the current time and store in nowStrBuf
+//
 void GrabNow(void);
 
 //
-// formats time as %Y-%m-%d %H:%M:%S in "C" locale
+// the formatTime functions format local time with digits only, so they do not depend on the locale, and are safe to
+// call from any thread
+//
+// localtime_r is only called to find the UTC offset, which is cached per thread for each 15-minute block of time,
+// because time zone transitions happen on 15-minute boundaries
+// so a change of TZ is noticed within 15 minutes
+//
+// the buffer must have room for the length plus a NUL
+//
+
+//
+// formats time as %Y-%m-%d %H:%M:%S
 //
 void formatTime(time_t timeV, char *buf, size_t len);
 
+//
+// formats time as ISO 8601 with milliseconds and the UTC offset, such as 2025-12-31T12:59:59.123+01:00
+//
+void formatTimeIso8601Millis(int64_t epochMillis, char *buf, size_t len);
+
+//
+// formats time as ISO 8601 with microseconds and the UTC offset, such as 2025-12-31T12:59:59.123456+01:00
+//
+void formatTimeIso8601Micros(int64_t epochMicros, char *buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
 
 
+#ifdef __cplusplus
+
+#include <chrono>
+#include <ratio> // for nano
+
+namespace common {
+
+//
+// std::chrono clocks, so that timing code can use time_point and duration arithmetic without converting
+//
+// both meet the TrivialClock requirements, count nanoseconds, and have the same epoch as uptimeNanos
+//
+
+//
+// uptimeNanos
+//
+struct MonotonicClock {
+
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<MonotonicClock>;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+        return time_point(duration(uptimeNanos()));
+    }
+};
+
+//
+// uptimeNanosFast
+//
+// is_steady is false: uptimeNanosFast does not go backwards within a thread, but two threads may read counters
+// that are slightly out of sync, so a time_point taken on one thread may be later than one taken after it on another
+//
+// use MonotonicClock for time_points that are compared across threads
+//
+struct FastClock {
+
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<FastClock>;
+
+    static constexpr bool is_steady = false;
+
+    static time_point now() noexcept {
+        return time_point(duration(uptimeNanosFast()));
+    }
+};
+
+} // namespace common
+
+#endif // __cplusplus
+
+
 //
 // JNI functions
 //
@@ -0,0 +1,108 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/logging.h"
+#include "common/status.h"
+
+#include <cstdarg> // for va_list
+#include <cstddef> // for size_t
+
+
+//
+// Flight recorder
+//
+// While the flight recorder is running, every LOG* call is recorded into an in-memory ring at every level, including
+// levels turned off by SetLogLevel. Only the callsite, a timestamp, a thread number, and the raw argument bytes are
+// recorded. Nothing is formatted until the ring is dumped.
+//
+// ABORT dumps the ring, and so do the fatal signal handlers if they are installed.
+//
+// Arguments of LOG* calls below the active level are evaluated while the flight recorder is running.
+//
+// A record is dropped if its slot is still being written by a thread a full lap behind, such as one interrupted by a
+// signal.
+//
+
+
+//
+// start recording the last capacity records (rounded up to power of 2)
+//
+Status StartFlightRecorder(size_t capacity);
+
+//
+// stop recording, the ring keeps what it has
+//
+void StopFlightRecorder();
+
+bool IsFlightRecording();
+
+//
+// where ABORT and the signal handlers dump, default is stderr
+//
+// the fd should already be open, nothing is opened while crashing
+//
+void SetFlightRecorderFd(int fd);
+
+//
+// dump on SIGSEGV, SIGBUS, SIGILL, SIGFPE, and SIGABRT, then pass the signal on to the handler that was installed
+// before, or let it kill the process if there was none
+//
+// also installs an alternate signal stack for the calling thread, if it has none, so that a stack overflow can still
+// be dumped
+// other threads need their own alternate stack for that
+//
+// not supported on Windows
+//
+void InstallFlightRecorderSignalHandlers();
+
+//
+// format and write every record in the ring to fd, oldest first
+//
+// does not allocate, lock, or call snprintf, so that it can be called from a signal handler
+// arguments are formatted with FormatEncodedPrintfArgsSignalSafe, so flags and width are ignored
+//
+void DumpFlightRecorder(int fd);
+
+//
+// called by ABORT and the signal handlers
+//
+// dumps to the fd from SetFlightRecorderFd, at most once
+//
+void DumpFlightRecorderOnCrash();
+
+//
+// called from LogSite_expanded
+//
+void FlightRecorderWriteV(LogSite *site, va_list args);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,67 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/status.h"
+
+#include <cstddef> // for size_t
+
+
+//
+// File logging
+//
+// While file logging is running, formatted messages go to segment files in a directory instead of stderr.
+//
+// Each segment is preallocated to segmentSize bytes and memory-mapped, so writing a message is a memcpy into the
+// mapping. When a segment is full, the next one is created and the oldest is deleted so that at most segmentCount
+// segments are kept. Closed segments are truncated to the bytes actually written.
+//
+// Segments are named log-NNNNNNNN.txt with increasing numbers. Numbering continues after any segments left in the
+// directory by a previous run, so the logs from a crashed run are kept.
+//
+// Works together with StartAsyncLogging, in which case the drainer thread does the writing.
+//
+// not supported on Android or Windows
+//
+
+
+//
+// create dir if needed and start writing segments
+//
+Status StartFileLogging(const char *dir, size_t segmentSize, size_t segmentCount);
+
+//
+// flush, close the current segment, and go back to stderr
+//
+void StopFileLogging();
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
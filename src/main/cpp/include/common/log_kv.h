@@ -0,0 +1,304 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/logging.h"
+
+#include <charconv> // for to_chars
+#include <cmath> // for isfinite
+#include <cstddef> // for size_t
+#include <cstring> // for memcpy
+#include <string_view>
+#include <type_traits>
+
+
+//
+// Structured key-value logging
+//
+// LOGI_KV("frame", "ms", dt, "fps", fps) writes one JSON Lines record:
+//
+// {"level":"I","tag":"Renderer","msg":"frame","ms":16.6,"fps":60}
+//
+// Keys and values alternate. Values may be bool, integers, enums, floats, doubles, strings (const char *,
+// std::string, std::string_view), or nullptr. Doubles are written with std::to_chars in their shortest round-trip
+// form, and non-finite doubles are written as null.
+//
+// The record is serialized into a thread-local buffer without printf and without allocating, and then written like
+// any other message: to stderr, to the sink set by SetLogSink, or to the async ring.
+//
+// KV sites follow the global and TAG levels the same as LOG* sites, but they are not binary logged or recorded by
+// the flight recorder.
+//
+// C++-only
+//
+
+
+//
+// size of the thread-local buffer
+//
+// fields that do not fit are dropped and the record ends with "truncated":true
+//
+constexpr size_t LOG_KV_BUFFER_SIZE = 4096;
+
+
+//
+// serializes one record into buf
+//
+class LogKvWriter {
+private:
+
+    //
+    // room always left for ,"truncated":true}\n and the terminating NUL
+    //
+    static constexpr size_t RESERVE = 32;
+
+    char *const buf;
+    char *const limit;
+    char *pos;
+    bool overflow;
+    bool truncated;
+
+    void put(char c) {
+        if (pos == limit) {
+            overflow = true;
+            return;
+        }
+        *pos++ = c; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    void putRaw(const char *s, size_t len) {
+        if (static_cast<size_t>(limit - pos) < len) {
+            overflow = true;
+            return;
+        }
+        std::memcpy(pos, s, len);
+        pos += len; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    void putString(std::string_view s);
+
+    template <typename T>
+    void putNumber(T value) {
+        auto [end, ec] = std::to_chars(pos, limit, value);
+        if (ec != std::errc()) {
+            overflow = true;
+            return;
+        }
+        pos = end;
+    }
+
+    template <typename T>
+    void putValue(const T &value) {
+
+        if constexpr (std::is_same_v<T, bool>) {
+
+            if (value) {
+                putRaw("true", 4);
+            } else {
+                putRaw("false", 5);
+            }
+
+        } else if constexpr (std::is_same_v<T, char>) {
+
+            putString(std::string_view(&value, 1));
+
+        } else if constexpr (std::is_integral_v<T>) {
+
+            putNumber(value);
+
+        } else if constexpr (std::is_enum_v<T>) {
+
+            putNumber(static_cast<std::underlying_type_t<T>>(value));
+
+        } else if constexpr (std::is_floating_point_v<T>) {
+
+            if (std::isfinite(value)) {
+                putNumber(value);
+            } else {
+                putRaw("null", 4);
+            }
+
+        } else if constexpr (std::is_null_pointer_v<T>) {
+
+            putRaw("null", 4);
+
+        } else if constexpr (std::is_convertible_v<T, const char *>) {
+
+            const char *s = value;
+
+            if (s == nullptr) {
+                putRaw("null", 4);
+            } else {
+                putString(s);
+            }
+
+        } else if constexpr (std::is_convertible_v<T, std::string_view>) {
+
+            putString(value);
+
+        } else {
+
+            static_assert(!sizeof(T), "unsupported LOG*_KV value type"); // NOLINT(*-sizeof-expression)
+        }
+    }
+
+public:
+
+    LogKvWriter(char *buf, size_t size) :
+        buf(buf),
+        limit(buf + size - RESERVE), // NOLINT(*-pro-bounds-pointer-arithmetic)
+        pos(buf),
+        overflow(false),
+        truncated(false) {}
+
+    //
+    // write level, tag, and msg
+    //
+    void begin(int level, const char *tag, const char *msg);
+
+    template <typename T>
+    void field(const char *key, const T &value) {
+
+        if (truncated) {
+            return;
+        }
+
+        char *mark = pos;
+
+        put(',');
+        putString(key);
+        put(':');
+        putValue(value);
+
+        if (overflow) {
+            pos = mark;
+            overflow = false;
+            truncated = true;
+        }
+    }
+
+    //
+    // close the record and return its length, not counting the terminating NUL
+    //
+    size_t finish();
+};
+
+
+//
+// the calling thread's buffer, LOG_KV_BUFFER_SIZE bytes
+//
+char *LogKvBuffer();
+
+inline void LogKvFields(LogKvWriter &w) {
+    (void)w;
+}
+
+template <typename T, typename... Rest>
+void LogKvFields(LogKvWriter &w, const char *key, const T &value, const Rest &... rest) {
+    w.field(key, value);
+    LogKvFields(w, rest...);
+}
+
+template <typename... Args>
+void LogKv(LogSite *site, const char *msg, const Args &... args) {
+
+    static_assert(sizeof...(Args) % 2 == 0, "LOG*_KV needs key-value pairs");
+
+    if ((COMMON_LOGGING_LOAD_RELAXED(&site->state) & LOGSITE_STATE_OUTPUT) == 0) {
+        return;
+    }
+
+    LogKvWriter w(LogKvBuffer(), LOG_KV_BUFFER_SIZE);
+
+    w.begin(site->level, site->tag, msg);
+
+    LogKvFields(w, args...);
+
+    size_t len = w.finish();
+
+    LogSiteWrite(site, LogKvBuffer(), len);
+}
+
+
+//
+// same fast path as COMMON_LOGGING_SITE_CALL
+//
+#define COMMON_LOGGING_KV_SITE_CALL(level, msg, ...) \
+    do { \
+        static LogSite commonLoggingSite = COMMON_LOGGING_SITE_INIT(level, LOGSITE_FLAG_KV, TAG, msg, nullptr); \
+        if (COMMON_LOGGING_UNLIKELY(COMMON_LOGGING_LOAD_RELAXED(&commonLoggingSite.state) != 0) && LogSiteEnabled(&commonLoggingSite)) { \
+            LogKv(&commonLoggingSite, msg __VA_OPT__(,) __VA_ARGS__); \
+        } \
+    } while (false)
+
+//
+// still type-checks the arguments, but never evaluates them
+//
+#define COMMON_LOGGING_KV_DISABLED(msg, ...) \
+    do { \
+        if (false) { \
+            LogKv(nullptr, msg __VA_OPT__(,) __VA_ARGS__); \
+        } \
+    } while (false)
+
+
+#if DISABLE_LOGE
+#define LOGE_KV(msg, ...) COMMON_LOGGING_KV_DISABLED(msg __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOGE_KV(msg, ...) COMMON_LOGGING_KV_SITE_CALL(LOGLEVEL_ERROR, msg __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+#if DISABLE_LOGW
+#define LOGW_KV(msg, ...) COMMON_LOGGING_KV_DISABLED(msg __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOGW_KV(msg, ...) COMMON_LOGGING_KV_SITE_CALL(LOGLEVEL_WARN, msg __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+#if DISABLE_LOGI
+#define LOGI_KV(msg, ...) COMMON_LOGGING_KV_DISABLED(msg __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOGI_KV(msg, ...) COMMON_LOGGING_KV_SITE_CALL(LOGLEVEL_INFO, msg __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGI
+
+#if DISABLE_LOGD
+#define LOGD_KV(msg, ...) COMMON_LOGGING_KV_DISABLED(msg __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOGD_KV(msg, ...) COMMON_LOGGING_KV_SITE_CALL(LOGLEVEL_DEBUG, msg __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGD
+
+#if DISABLE_LOGT
+#define LOGT_KV(msg, ...) COMMON_LOGGING_KV_DISABLED(msg __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOGT_KV(msg, ...) COMMON_LOGGING_KV_SITE_CALL(LOGLEVEL_TRACE, msg __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGT
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
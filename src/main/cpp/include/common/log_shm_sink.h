@@ -0,0 +1,152 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/status.h"
+
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t, uint32_t, uint64_t
+#include <functional>
+#include <string_view>
+
+
+//
+// Shared-memory logging
+//
+// While shared-memory logging is running, formatted messages go into a ring of fixed-size records in a POSIX
+// shared-memory object instead of stderr. Writing a message is a memcpy into the mapping, with no syscall, and the
+// ring outlives the process, so a reader in another process (common-logcat) can tail it, filter it, and persist it,
+// including after a crash.
+//
+// Records are written with the same seqlock as the flight recorder: seq is 2 * pos + 1 while the record for pos is
+// being written and 2 * pos + 2 once it is complete, so the reader never needs a lock. A writer claims its slot by
+// moving seq forward from an even value, and drops its record if a writer a full lap behind is still in the slot.
+//
+// Text longer than a record is truncated. Leave SetLogPrefix at LOGPREFIX_NONE, since every record already has the
+// time, pid, thread, level, and TAG.
+//
+// Works together with StartAsyncLogging, in which case the drainer thread does the writing.
+//
+// not supported on Android or Windows
+//
+
+
+//
+// bytes of text per record, the rest of the record is the header
+//
+constexpr size_t LOG_SHM_TEXT_SIZE = 448;
+
+constexpr size_t LOG_SHM_TAG_SIZE = 24;
+
+constexpr int64_t LOG_SHM_STALL_MILLIS = 1000;
+
+
+//
+// create or reuse the shared-memory object name (for example "/myapp-log") with capacity records (rounded up to
+// power of 2) and start writing to it
+//
+// if name already holds a ring with the same capacity, then writing continues after its last record, so that logs
+// from a previous run are kept
+//
+Status StartSharedMemoryLogging(const char *name, size_t capacity);
+
+//
+// flush, unmap, and go back to stderr
+//
+// the shared-memory object is kept for readers
+//
+void StopSharedMemoryLogging();
+
+//
+// shm_unlink name
+//
+Status RemoveSharedMemoryLog(const char *name);
+
+
+struct SharedMemoryLogRecord {
+    uint64_t pos;
+    int64_t uptimeMicros;
+
+    //
+    // wall-clock time, computed from the time the ring was created
+    //
+    int64_t epochMillis;
+
+    int level;
+    uint32_t pid;
+    uint32_t thread;
+    bool truncated;
+    std::string_view tag;
+    std::string_view text;
+};
+
+//
+// reader side, used by common-logcat
+//
+class SharedMemoryLogReader {
+private:
+
+    void *base;
+    size_t size;
+    uint64_t nextPos;
+
+    //
+    // the incomplete record that poll last stopped at, and since when
+    //
+    uint64_t stalledPos;
+    int64_t stalledSinceMillis;
+
+public:
+
+    SharedMemoryLogReader();
+    ~SharedMemoryLogReader();
+
+    SharedMemoryLogReader(const SharedMemoryLogReader&) = delete;
+    SharedMemoryLogReader& operator=(const SharedMemoryLogReader&) = delete;
+
+    //
+    // map name read-only, positioned at the oldest record still in the ring
+    //
+    Status open(const char *name);
+
+    //
+    // call f with every complete record from the current position up to the newest, in order
+    //
+    // stops at a record that is still being written, unless skipIncomplete is set or the record has stayed
+    // incomplete for LOG_SHM_STALL_MILLIS, since its writer may have crashed in the middle of it
+    //
+    // returns the number of records that were overwritten before they could be read
+    //
+    uint64_t poll(const std::function<void(const SharedMemoryLogRecord &)> &f, bool skipIncomplete);
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,67 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/logging.h"
+#include "common/printf_args.h"
+
+#include <cstddef> // for size_t
+
+
+//
+// sites with more conversions than this cannot be recorded in binary form
+//
+constexpr size_t LOGSITE_MAX_SPECS = 32;
+
+//
+// sites with larger ids cannot be recorded in binary form
+//
+constexpr size_t LOGSITE_MAX_INFOS = 16384;
+
+
+//
+// information about a site that is computed once, for modules that record arguments without formatting them
+//
+struct LogSiteInfo {
+    PrintfSpec specs[LOGSITE_MAX_SPECS];
+    size_t specCount;
+};
+
+
+//
+// parse the format of site the first time, and return the same LogSiteInfo after that
+//
+// returns nullptr if site has not been reached yet, has too many conversions, or there are too many sites
+//
+const LogSiteInfo *GetLogSiteInfo(const LogSite *site);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,101 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <string>
+#include <vector>
+
+
+//
+// Log volume statistics
+//
+// While enabled, every message is counted per TAG and per level, with the number of bytes written, and so is every
+// message that was suppressed because its level is turned off by SetLogLevel or SetLogLevelForTag.
+//
+// Counters are kept per thread and only merged by GetLogStats, so counting is a table lookup and a relaxed store on
+// the calling thread. Suppressed sites take their slow path while enabled, but their arguments are still not
+// evaluated.
+//
+// Counts are cumulative from the first StartLogStats, so diff two snapshots to get a rate.
+//
+// Bytes are the bytes of text output; binary-logged messages are counted without bytes.
+//
+
+
+//
+// index into LogTagStats::levels is level - LOGLEVEL_FATAL
+//
+constexpr size_t LOG_STATS_LEVEL_COUNT = 6;
+
+//
+// distinct TAGs counted per thread, the rest are counted under "(other)"
+//
+constexpr size_t LOG_STATS_MAX_TAGS_PER_THREAD = 128;
+
+struct LogLevelCounts {
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t suppressed;
+};
+
+struct LogTagStats {
+    std::string tag;
+    LogLevelCounts levels[LOG_STATS_LEVEL_COUNT];
+};
+
+
+void StartLogStats();
+
+void StopLogStats();
+
+bool IsLogStatsEnabled();
+
+//
+// merge every thread's counters, sorted by TAG
+//
+std::vector<LogTagStats> GetLogStats();
+
+//
+// log one line per TAG and level with any counts, at LOGLEVEL_INFO
+//
+void LogStatsSummary();
+
+//
+// called from logging.cpp
+//
+void LogStatsCountMessage(int level, const char *tag, size_t bytes);
+
+void LogStatsCountSuppressed(int level, const char *tag);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -25,11 +25,14 @@
 #include "common/platform.h"
 
 #ifdef __cplusplus
+#include "common/printf_args.h" // for ParsePrintfFormatStatic
 #include <cstdarg> // for va_list
 #include <cstddef> // for size_t
+#include <cstdint> // for int64_t
 #else
 #include <stdarg.h> // for va_list
 #include <stddef.h> // for size_t
+#include <stdint.h> // for int64_t
 #endif // __cplusplus
 
 
@@ -62,6 +65,113 @@ typedef void (*LOG_decl)(const char *tag, const char *fmt, ...); // NOLINT(*-use
 typedef void (*LOG_declV)(const char *tag, const char *fmt, va_list args); // NOLINT(*-use-using)
 
 
+//
+// flags for LogSite
+//
+#define LOGSITE_FLAG_CAPTURE_UNUSUAL 1
+#define LOGSITE_FLAG_ENTRY_EXIT 2
+#define LOGSITE_FLAG_KV 4
+
+//
+// bits of LogSite state
+//
+// state is computed from the site's level, the level of its TAG, and the global level
+// it is recomputed whenever SetLogLevel or SetLogLevelForTag is called
+//
+// LOGSITE_STATE_RECORD is set for every site except LOG*_KV sites while the flight recorder is running
+//
+// LOGSITE_STATE_SPAN is set for LOG_ENTRY_EXIT sites while tracing
+//
+// LOGSITE_STATE_STATS is set for every site while log stats are enabled, so that suppressed messages can be counted
+//
+// LOGSITE_STATE_UNRESOLVED is only set before the site is first reached, and sends it down the slow path once
+//
+#define LOGSITE_STATE_OUTPUT 0x01
+#define LOGSITE_STATE_RECORD 0x02
+#define LOGSITE_STATE_SPAN 0x04
+#define LOGSITE_STATE_STATS 0x08
+#define LOGSITE_STATE_UNRESOLVED 0x80
+
+//
+// every LOGF, LOGE, LOGW, LOGI, LOGD, LOGT expansion owns a static LogSite
+//
+// everything except id is known at compile time
+//
+typedef struct LogSite { // NOLINT(*-use-using)
+    int level;
+    int flags;
+    const char *tag;
+    const char *fmt;
+    const char *file;
+    int line;
+
+    //
+    // assigned when the site is first reached, 0 means not reached yet
+    //
+    int id;
+
+    //
+    // LOGSITE_STATE_* bits, 0 means disabled
+    //
+    // read with COMMON_LOGGING_LOAD_RELAXED
+    //
+    int state;
+
+    //
+    // fmt parsed at compile time in C++, NULL in C and for sites that do not take printf arguments
+    //
+    const struct PrintfFormat *format;
+} LogSite;
+
+//
+// the LOG*_EVERY_N, LOG*_FIRST_N, and LOG*_EVERY_MS expansions also own a static LogRateLimit
+//
+typedef struct LogRateLimit { // NOLINT(*-use-using)
+
+    //
+    // number of times the enabled site was reached
+    //
+    int64_t count;
+
+    //
+    // EVERY_MS: messages suppressed since the last one was logged
+    //
+    int64_t suppressed;
+
+    //
+    // EVERY_MS: uptimeMillis of the last message logged, -1 means none yet
+    //
+    int64_t lastMillis;
+} LogRateLimit;
+
+
+#if __GNUC__ || __clang__
+
+#define COMMON_LOGGING_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+
+//
+// keep the logging call out of the hot path of the caller
+//
+#define COMMON_LOGGING_UNLIKELY(x) __builtin_expect(!!(x), 0)
+
+#define COMMON_LOGGING_FETCH_ADD_RELAXED(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+
+#else
+
+#include <intrin.h> // for _InterlockedExchangeAdd64
+
+//
+// aligned int loads are atomic on MSVC targets
+//
+#define COMMON_LOGGING_LOAD_RELAXED(p) (*(volatile const int *)(p))
+
+#define COMMON_LOGGING_UNLIKELY(x) (x)
+
+#define COMMON_LOGGING_FETCH_ADD_RELAXED(p, v) _InterlockedExchangeAdd64((volatile long long *)(p), (v))
+
+#endif // __GNUC__ || __clang__
+
+
 #if __GNUC__ || __clang__
 
 //
@@ -83,6 +193,12 @@ typedef void (*LOG_declV)(const char *tag, const char *fmt, va_list args); // NO
 extern "C" {
 #endif // __cplusplus
 
+//
+// LOGF_expanded et al can be called directly, and check the global level (but not TAG levels) themselves
+//
+// SetLogLevel does not change these pointers, so they are safe to read from any thread
+//
+
 // var arg
 
 extern PRINTF_ATTRIBUTE LOG_decl LOGF_expanded;
@@ -94,6 +210,13 @@ extern PRINTF_ATTRIBUTE LOG_decl LOGI_expanded;
 extern PRINTF_ATTRIBUTE LOG_decl LOGD_expanded;
 extern PRINTF_ATTRIBUTE LOG_decl LOGT_expanded;
 
+//
+// entry point of the LOG* macros, only called for enabled sites
+//
+// dispatches to the log function for the site's level, or to binary logging
+//
+PRINTF_ATTRIBUTE void LogSite_expanded(LogSite *site, const char *fmt, ...);
+
 // va_list
 
 //
@@ -105,7 +228,9 @@ extern PRINTF_ATTRIBUTE LOG_decl LOGT_expanded;
 //
 extern LOG_declV LOGF_expandedV;
 extern LOG_declV LOGE_expandedV;
+extern LOG_declV LOGE_andCaptureUnusual_expandedV;
 extern LOG_declV LOGW_expandedV;
+extern LOG_declV LOGW_andCaptureUnusual_expandedV;
 extern LOG_declV LOGI_expandedV;
 extern LOG_declV LOGD_expandedV;
 extern LOG_declV LOGT_expandedV;
@@ -200,6 +325,90 @@ extern LOG_declV LOGT_expandedV;
     do { (void)a; (void)b; (void)c; (void)d; (void)e; (void)f; (void)g; (void)h; } while (false)
 
 
+//
+// declare the static LogSite for this expansion and pass it along
+//
+// a disabled site costs one load and one branch, and the arguments are not evaluated
+//
+// the first time through, LogSiteEnabled resolves the site against the global and TAG levels
+//
+#define COMMON_LOGGING_SITE_INIT(level, flags, tag, fmt, format) \
+    { level, flags, tag, fmt, __FILE__, __LINE__, 0, LOGSITE_STATE_UNRESOLVED, format }
+
+//
+// in C++, the literal format of each site is split into text and conversions at compile time, so that formatting
+// only copies the text and converts the arguments
+//
+#ifdef __cplusplus
+#define COMMON_LOGGING_FORMAT_DECL(fmt) \
+    static constexpr auto commonLoggingParsedFormat = ParsePrintfFormatStatic<ParsePrintfFormat(fmt, nullptr, 0)>(fmt); \
+    static constexpr PrintfFormat commonLoggingFormat = commonLoggingParsedFormat.format();
+#define COMMON_LOGGING_FORMAT (&commonLoggingFormat)
+#else
+#define COMMON_LOGGING_FORMAT_DECL(fmt)
+#define COMMON_LOGGING_FORMAT NULL
+#endif // __cplusplus
+
+#define COMMON_LOGGING_SITE_CALL(level, flags, fmt, ...) \
+    do { \
+        COMMON_LOGGING_FORMAT_DECL(fmt) \
+        static LogSite commonLoggingSite = COMMON_LOGGING_SITE_INIT(level, flags, TAG, fmt, COMMON_LOGGING_FORMAT); \
+        if (COMMON_LOGGING_UNLIKELY(COMMON_LOGGING_LOAD_RELAXED(&commonLoggingSite.state) != 0) && LogSiteEnabled(&commonLoggingSite)) { \
+            LogSite_expanded(&commonLoggingSite, fmt __VA_OPT__(,) __VA_ARGS__); \
+        } \
+    } while (false)
+
+
+//
+// rate-limited versions of COMMON_LOGGING_SITE_CALL
+//
+// a suppressed message costs the same load and branch as above, plus one atomic increment
+// EVERY_MS also reads uptimeMillisCoarse, see StartCoarseClock
+//
+// when a message is logged after some were suppressed, a "suppressed N messages" line is logged first
+//
+#define COMMON_LOGGING_RATE_LIMIT_INIT { 0, 0, -1 }
+
+#define COMMON_LOGGING_SITE_CALL_EVERY_N(level, flags, n, fmt, ...) \
+    do { \
+        COMMON_LOGGING_FORMAT_DECL(fmt) \
+        static LogSite commonLoggingSite = COMMON_LOGGING_SITE_INIT(level, flags, TAG, fmt, COMMON_LOGGING_FORMAT); \
+        static LogRateLimit commonLoggingRateLimit = COMMON_LOGGING_RATE_LIMIT_INIT; \
+        if (COMMON_LOGGING_UNLIKELY(COMMON_LOGGING_LOAD_RELAXED(&commonLoggingSite.state) != 0) && LogSiteEnabled(&commonLoggingSite)) { \
+            int64_t commonLoggingN = ((n) > 0) ? (n) : 1; \
+            int64_t commonLoggingCount = COMMON_LOGGING_FETCH_ADD_RELAXED(&commonLoggingRateLimit.count, 1); \
+            if (commonLoggingCount % commonLoggingN == 0) { \
+                LogSiteSuppressed(&commonLoggingSite, (commonLoggingCount == 0) ? 0 : commonLoggingN - 1); \
+                LogSite_expanded(&commonLoggingSite, fmt __VA_OPT__(,) __VA_ARGS__); \
+            } \
+        } \
+    } while (false)
+
+#define COMMON_LOGGING_SITE_CALL_FIRST_N(level, flags, n, fmt, ...) \
+    do { \
+        COMMON_LOGGING_FORMAT_DECL(fmt) \
+        static LogSite commonLoggingSite = COMMON_LOGGING_SITE_INIT(level, flags, TAG, fmt, COMMON_LOGGING_FORMAT); \
+        static LogRateLimit commonLoggingRateLimit = COMMON_LOGGING_RATE_LIMIT_INIT; \
+        if (COMMON_LOGGING_UNLIKELY(COMMON_LOGGING_LOAD_RELAXED(&commonLoggingSite.state) != 0) && LogSiteEnabled(&commonLoggingSite)) { \
+            if (COMMON_LOGGING_FETCH_ADD_RELAXED(&commonLoggingRateLimit.count, 1) < (n)) { \
+                LogSite_expanded(&commonLoggingSite, fmt __VA_OPT__(,) __VA_ARGS__); \
+            } \
+        } \
+    } while (false)
+
+#define COMMON_LOGGING_SITE_CALL_EVERY_MS(level, flags, ms, fmt, ...) \
+    do { \
+        COMMON_LOGGING_FORMAT_DECL(fmt) \
+        static LogSite commonLoggingSite = COMMON_LOGGING_SITE_INIT(level, flags, TAG, fmt, COMMON_LOGGING_FORMAT); \
+        static LogRateLimit commonLoggingRateLimit = COMMON_LOGGING_RATE_LIMIT_INIT; \
+        if (COMMON_LOGGING_UNLIKELY(COMMON_LOGGING_LOAD_RELAXED(&commonLoggingSite.state) != 0) && LogSiteEnabled(&commonLoggingSite)) { \
+            if (LogSiteEveryMillis(&commonLoggingSite, &commonLoggingRateLimit, (ms))) { \
+                LogSite_expanded(&commonLoggingSite, fmt __VA_OPT__(,) __VA_ARGS__); \
+            } \
+        } \
+    } while (false)
+
+
 //
 // define LOGF
 //
@@ -208,7 +417,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGF(fmt, ...) \
-    LOGF_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_FATAL, 0, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGF
 
 
@@ -220,7 +429,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGE(fmt, ...) \
-    LOGE_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_ERROR, 0, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGE
 
 
@@ -232,7 +441,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGE_andCaptureUnusual(fmt, ...) \
-    LOGE_andCaptureUnusual_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_ERROR, LOGSITE_FLAG_CAPTURE_UNUSUAL, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGE
 
 
@@ -244,7 +453,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGW(fmt, ...) \
-    LOGW_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_WARN, 0, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGW
 
 
@@ -256,7 +465,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGW_andCaptureUnusual(fmt, ...) \
-    LOGW_andCaptureUnusual_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_WARN, LOGSITE_FLAG_CAPTURE_UNUSUAL, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGW
 
 
@@ -268,7 +477,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGI(fmt, ...) \
-    LOGI_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_INFO, 0, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGI
 
 
@@ -280,7 +489,7 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGD(fmt, ...) \
-    LOGD_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_DEBUG, 0, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGD
 
 
@@ -292,38 +501,206 @@ extern LOG_declV LOGT_expandedV;
     GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
 #else
 #define LOGT(fmt, ...) \
-    LOGT_expanded(TAG, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+    COMMON_LOGGING_SITE_CALL(LOGLEVEL_TRACE, 0, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
 #endif // DISABLE_LOGT
 
 
+//
+// define rate-limited LOGE, LOGE_andCaptureUnusual, LOGW, LOGW_andCaptureUnusual, LOGI, LOGD
+//
+// LOG*_EVERY_N(n, fmt, ...): log the 1st, (n+1)th, (2n+1)th, ... message, and every message if n <= 0
+// LOG*_FIRST_N(n, fmt, ...): log the first n messages and then nothing
+// LOG*_EVERY_MS(ms, fmt, ...): log at most one message every ms milliseconds
+//
+// counting only starts once the site is enabled
+//
+
+#if DISABLE_LOGE
+#define LOGE_EVERY_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGE_EVERY_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_N(LOGLEVEL_ERROR, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+#if DISABLE_LOGE
+#define LOGE_FIRST_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGE_FIRST_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_FIRST_N(LOGLEVEL_ERROR, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+#if DISABLE_LOGE
+#define LOGE_EVERY_MS(ms, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGE_EVERY_MS(ms, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_MS(LOGLEVEL_ERROR, 0, ms, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+
+#if DISABLE_LOGE
+#define LOGE_andCaptureUnusual_EVERY_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGE_andCaptureUnusual_EVERY_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_N(LOGLEVEL_ERROR, LOGSITE_FLAG_CAPTURE_UNUSUAL, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+#if DISABLE_LOGE
+#define LOGE_andCaptureUnusual_FIRST_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGE_andCaptureUnusual_FIRST_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_FIRST_N(LOGLEVEL_ERROR, LOGSITE_FLAG_CAPTURE_UNUSUAL, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+#if DISABLE_LOGE
+#define LOGE_andCaptureUnusual_EVERY_MS(ms, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGE_andCaptureUnusual_EVERY_MS(ms, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_MS(LOGLEVEL_ERROR, LOGSITE_FLAG_CAPTURE_UNUSUAL, ms, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGE
+
+
+#if DISABLE_LOGW
+#define LOGW_EVERY_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGW_EVERY_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_N(LOGLEVEL_WARN, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+#if DISABLE_LOGW
+#define LOGW_FIRST_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGW_FIRST_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_FIRST_N(LOGLEVEL_WARN, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+#if DISABLE_LOGW
+#define LOGW_EVERY_MS(ms, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGW_EVERY_MS(ms, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_MS(LOGLEVEL_WARN, 0, ms, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+
+#if DISABLE_LOGW
+#define LOGW_andCaptureUnusual_EVERY_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGW_andCaptureUnusual_EVERY_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_N(LOGLEVEL_WARN, LOGSITE_FLAG_CAPTURE_UNUSUAL, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+#if DISABLE_LOGW
+#define LOGW_andCaptureUnusual_FIRST_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGW_andCaptureUnusual_FIRST_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_FIRST_N(LOGLEVEL_WARN, LOGSITE_FLAG_CAPTURE_UNUSUAL, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+#if DISABLE_LOGW
+#define LOGW_andCaptureUnusual_EVERY_MS(ms, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGW_andCaptureUnusual_EVERY_MS(ms, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_MS(LOGLEVEL_WARN, LOGSITE_FLAG_CAPTURE_UNUSUAL, ms, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGW
+
+
+#if DISABLE_LOGI
+#define LOGI_EVERY_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGI_EVERY_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_N(LOGLEVEL_INFO, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGI
+
+#if DISABLE_LOGI
+#define LOGI_FIRST_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGI_FIRST_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_FIRST_N(LOGLEVEL_INFO, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGI
+
+#if DISABLE_LOGI
+#define LOGI_EVERY_MS(ms, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGI_EVERY_MS(ms, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_MS(LOGLEVEL_INFO, 0, ms, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGI
+
+
+#if DISABLE_LOGD
+#define LOGD_EVERY_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGD_EVERY_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_N(LOGLEVEL_DEBUG, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGD
+
+#if DISABLE_LOGD
+#define LOGD_FIRST_N(n, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGD_FIRST_N(n, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_FIRST_N(LOGLEVEL_DEBUG, 0, n, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGD
+
+#if DISABLE_LOGD
+#define LOGD_EVERY_MS(ms, fmt, ...) \
+    GET_MACRO(_0 __VA_OPT__(,) __VA_ARGS__, LOG8, LOG7, LOG6, LOG5, LOG4, LOG3, LOG2, LOG1, LOG0)(__VA_ARGS__)
+#else
+#define LOGD_EVERY_MS(ms, fmt, ...) \
+    COMMON_LOGGING_SITE_CALL_EVERY_MS(LOGLEVEL_DEBUG, 0, ms, fmt COMMON_LOGGING_C __VA_OPT__(,) __VA_ARGS__)
+#endif // DISABLE_LOGD
+
+
+
 void LOGE_chunks(const char *buf, size_t len);
 
 
 #ifdef __cplusplus
 
+//
+// the site decides whether entry and exit are logged, the same as LOGT
+//
+// while tracing, entry and exit are also recorded as a span
+//
 class LogTracer {
 private:
 
-    const char *tag;
+    const LogSite *site;
     const char *function;
+    int state;
+    int64_t beginMicros;
 
 public:
 
-    LogTracer(const char *tag, const char *function);
+    LogTracer(LogSite *site, const char *function);
     ~LogTracer();
 };
 
 class DebugLogTracer {
 private:
 
-    const char *tag;
+    const LogSite *site;
     const char *function;
-    const char *file;
-    int line;
+    int state;
+    int64_t beginMicros;
 
 public:
 
-    DebugLogTracer(const char *tag, const char *function, const char *file, int line);
+    DebugLogTracer(LogSite *site, const char *function);
     ~DebugLogTracer();
 };
 
@@ -333,12 +710,14 @@ public:
 #if LOCAL_DEBUGGING
 
 #define COMMON_LOGGING_LOG_ENTRY_EXIT_FOR(tag, x, y, z) \
-    DebugLogTracer SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLogger(tag, x, y, z)
+    static LogSite SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLoggerSite = COMMON_LOGGING_SITE_INIT(LOGLEVEL_TRACE, LOGSITE_FLAG_ENTRY_EXIT, tag, "enter/exit %s %s:%d", nullptr); \
+    DebugLogTracer SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLogger(&SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLoggerSite, x)
 
 #else
 
 #define COMMON_LOGGING_LOG_ENTRY_EXIT_FOR(tag, x, y, z) \
-    LogTracer SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLogger(tag, x)
+    static LogSite SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLoggerSite = COMMON_LOGGING_SITE_INIT(LOGLEVEL_TRACE, LOGSITE_FLAG_ENTRY_EXIT, tag, "enter/exit %s", nullptr); \
+    LogTracer SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLogger(&SomeLongNameThatIsNotLikelyToBeUsedInTheFunctionLoggerSite, x)
 
 #endif // LOCAL_DEBUGGING
 
@@ -367,6 +746,173 @@ extern "C" {
 
 void SetLogLevel(int level);
 
+//
+// override the global level for every site whose TAG is tag
+//
+// for example, SetLogLevelForTag("file", LOGLEVEL_DEBUG) turns on LOGD in file.cpp only
+//
+void SetLogLevelForTag(const char *tag, int level);
+
+//
+// go back to using the global level for tag
+//
+void ClearLogLevelForTag(const char *tag);
+
+//
+// dynamic debug: turn individual sites on or off, regardless of the global and TAG levels
+//
+// pattern is a glob with * and ?, matched against the TAG, the file name without directories, and file:line, for
+// example "renderer.cpp", "renderer.cpp:120", "renderer.cpp:12?", or "Render*"
+//
+// later rules win over earlier ones, and rules also apply to sites that are first reached after they were added
+//
+// LOGF and LOGE are never turned off
+//
+void EnableLogSites(const char *pattern);
+
+void DisableLogSites(const char *pattern);
+
+//
+// go back to the global and TAG levels for every site
+//
+void ClearLogSiteRules(void);
+
+//
+// call f for every site that has been reached at least once, with whether it is currently enabled
+//
+// sites are registered the first time they are reached, whether or not they are enabled
+//
+void ForEachLogSite(void (*f)(void *context, const LogSite *site, int enabled), void *context);
+
+//
+// resolve site if needed and return non-zero if it is enabled
+//
+int LogSiteEnabled(LogSite *site);
+
+//
+// recompute the state of every site, for modules that add LOGSITE_STATE_* bits
+//
+void RecomputeLogSiteStates(void);
+
+//
+// small number for the calling thread, assigned on first use, starting at 1
+//
+unsigned int LogThreadNumber(void);
+
+//
+// write an already formatted message at the level and TAG of site, buf must be NUL-terminated
+//
+// used by LOG*_KV
+//
+void LogSiteWrite(const LogSite *site, const char *buf, size_t len);
+
+//
+// log "suppressed N messages" at the level and TAG of site, if count > 0
+//
+void LogSiteSuppressed(LogSite *site, int64_t count);
+
+//
+// return non-zero if at least ms milliseconds have passed since the last message from site was logged
+//
+// otherwise count the message as suppressed and return 0
+//
+int LogSiteEveryMillis(LogSite *site, LogRateLimit *limit, int64_t ms);
+
+
+//
+// arguments for StartAsyncLogging
+//
+// LOGASYNC_OVERFLOW_DROP: if the ring is full, then drop the message and count it
+// LOGASYNC_OVERFLOW_BLOCK: if the ring is full, then wait for the drainer thread to make room
+//
+#define LOGASYNC_OVERFLOW_DROP 0
+#define LOGASYNC_OVERFLOW_BLOCK 1
+
+//
+// opt-in async mode
+//
+// messages are formatted on the calling thread into a lock-free ring of capacity slots (rounded up to power of 2)
+// and a background thread writes them in batches
+//
+// LOGF messages are always written synchronously, after flushing everything before them
+//
+// not supported on Android
+//
+void StartAsyncLogging(size_t capacity, int overflowPolicy);
+
+//
+// flush and stop the drainer thread
+//
+// registered with atexit by StartAsyncLogging
+//
+void StopAsyncLogging(void);
+
+//
+// block until every message logged before the call has been written
+//
+void FlushLogs(void);
+
+//
+// number of messages dropped because of LOGASYNC_OVERFLOW_DROP
+//
+size_t AsyncLogDroppedCount(void);
+
+
+//
+// destination for formatted messages, instead of stderr
+//
+// write is called with the complete message, from the logging thread or from the async drainer thread, and must be
+// safe to call from multiple threads
+//
+// tag is the TAG passed to the LOG* call and is assumed to be a string literal
+//
+// flush is called by FlushLogs and before a LOGF message is written, and may be NULL
+//
+// not supported on Android
+//
+typedef struct LogSink { // NOLINT(*-use-using)
+    void (*write)(void *context, int level, const char *tag, const char *buf, size_t len);
+    void (*flush)(void *context);
+    void *context;
+} LogSink;
+
+//
+// sink must stay valid until it is replaced, NULL goes back to stderr
+//
+void SetLogSink(const LogSink *sink);
+
+const LogSink *GetLogSink(void);
+
+
+//
+// what to put in front of every printf-style message, any combination of:
+//
+// LOGPREFIX_WALLTIME: local time with milliseconds, 2025-12-31 12:59:59.123
+// LOGPREFIX_UPTIME: monotonic seconds with microseconds, 4567.890123
+// LOGPREFIX_THREAD: LogThreadNumber, T3
+// LOGPREFIX_LEVEL: level letter, I
+// LOGPREFIX_TAG: TAG
+//
+// for example: 2025-12-31 12:59:59.123 4567.890123 T3 I/Renderer: frame done
+//
+// the calendar part of the wall time is cached per thread and only formatted again when the second changes
+//
+// LOG*_KV records are not prefixed, so that they stay valid JSON Lines
+//
+// default is LOGPREFIX_NONE, not supported on Android, where logd adds its own
+//
+#define LOGPREFIX_NONE 0
+#define LOGPREFIX_WALLTIME 0x01
+#define LOGPREFIX_UPTIME 0x02
+#define LOGPREFIX_THREAD 0x04
+#define LOGPREFIX_LEVEL 0x08
+#define LOGPREFIX_TAG 0x10
+#define LOGPREFIX_ALL 0x1f
+
+void SetLogPrefix(int flags);
+
+int GetLogPrefix(void);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
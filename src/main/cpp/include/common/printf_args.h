@@ -0,0 +1,385 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstdarg> // for va_list
+#include <cstddef> // for size_t
+#include <cstdint> // for uint8_t
+
+
+//
+// the C type that a printf conversion consumes with va_arg
+//
+enum class PrintfArgKind : uint8_t {
+    NONE, // %%
+    INT, // d i o u x X c with no length or with hh or h
+    LONG, // l
+    LONG_LONG, // ll
+    INTMAX, // j
+    SIZE, // z
+    PTRDIFF, // t
+    DOUBLE, // f F e E g G a A
+    LONG_DOUBLE, // L
+    STRING, // s
+    POINTER, // p
+    WINT, // lc
+    WSTRING, // ls
+    WRITEBACK, // n
+};
+
+
+//
+// one conversion specification in a printf-style format string
+//
+struct PrintfSpec {
+    size_t begin; // offset of '%'
+    size_t end; // offset one past the conversion character
+    uint8_t starCount; // number of * for width and precision, each consumes an int before the argument
+    PrintfArgKind kind;
+    char conversion; // d s f etc.
+    bool plain; // no flags, no width, no *, and no h or hh
+    int precision; // -1 if none or *
+};
+
+
+//
+// maximum number of bytes stored for a single string argument
+//
+constexpr size_t PRINTF_ARGS_MAX_STRING = 1024;
+
+//
+// longer conversion specifications, such as %0000000000000000000000000000000000000000000000000000000000000001d, are
+// not formatted one at a time
+//
+constexpr size_t PRINTF_ARGS_MAX_SPEC = 63;
+
+
+//
+// parse fmt and store at most max specs
+//
+// returns the total number of specs in fmt, which may be more than max
+//
+// constexpr so that the LOG* macros can parse their literal formats at compile time
+//
+constexpr size_t ParsePrintfFormat(const char *fmt, PrintfSpec *specs, size_t max) {
+
+    size_t count = 0;
+
+    size_t i = 0;
+    while (fmt[i] != '\0') {
+
+        if (fmt[i] != '%') {
+            i++;
+            continue;
+        }
+
+        PrintfSpec spec{};
+        spec.begin = i;
+        i++;
+
+        if (fmt[i] == '%') {
+
+            i++;
+
+            spec.end = i;
+            spec.kind = PrintfArgKind::NONE;
+            spec.conversion = '%';
+            spec.plain = true;
+
+            if (count < max) {
+                specs[count] = spec;
+            }
+            count++;
+
+            continue;
+        }
+
+        size_t flagsBegin = i;
+
+        //
+        // flags
+        //
+        while (fmt[i] == '-' || fmt[i] == '+' || fmt[i] == ' ' || fmt[i] == '#' || fmt[i] == '0' || fmt[i] == '\'') {
+            i++;
+        }
+
+        //
+        // width
+        //
+        if (fmt[i] == '*') {
+            spec.starCount++;
+            i++;
+        } else {
+            while ('0' <= fmt[i] && fmt[i] <= '9') {
+                i++;
+            }
+        }
+
+        spec.plain = (i == flagsBegin);
+        spec.precision = -1;
+
+        //
+        // precision
+        //
+        if (fmt[i] == '.') {
+            i++;
+            if (fmt[i] == '*') {
+                spec.starCount++;
+                spec.plain = false;
+                i++;
+            } else {
+                spec.precision = 0;
+                while ('0' <= fmt[i] && fmt[i] <= '9') {
+                    spec.precision = (spec.precision * 10) + (fmt[i] - '0');
+                    i++;
+                }
+            }
+        }
+
+        //
+        // length
+        //
+        char length = '\0';
+        bool doubled = false;
+        switch (fmt[i]) {
+            case 'h':
+            case 'l': {
+                length = fmt[i];
+                i++;
+                if (fmt[i] == length) {
+                    doubled = true;
+                    i++;
+                }
+                break;
+            }
+            case 'j':
+            case 'z':
+            case 't':
+            case 'L': {
+                length = fmt[i];
+                i++;
+                break;
+            }
+            default:
+                break;
+        }
+
+        char conversion = fmt[i];
+        if (conversion == '\0') {
+
+            //
+            // malformed: ran off the end
+            //
+            break;
+        }
+        i++;
+
+        spec.end = i;
+        spec.conversion = conversion;
+
+        //
+        // h and hh narrow the argument, which only printf itself does
+        //
+        if (length == 'h') {
+            spec.plain = false;
+        }
+
+        switch (conversion) {
+            case 'd':
+            case 'i':
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X': {
+                switch (length) {
+                    case 'l':
+                        spec.kind = doubled ? PrintfArgKind::LONG_LONG : PrintfArgKind::LONG;
+                        break;
+                    case 'j':
+                        spec.kind = PrintfArgKind::INTMAX;
+                        break;
+                    case 'z':
+                        spec.kind = PrintfArgKind::SIZE;
+                        break;
+                    case 't':
+                        spec.kind = PrintfArgKind::PTRDIFF;
+                        break;
+                    default:
+                        spec.kind = PrintfArgKind::INT;
+                        break;
+                }
+                break;
+            }
+            case 'c': {
+                spec.kind = (length == 'l') ? PrintfArgKind::WINT : PrintfArgKind::INT;
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                spec.kind = (length == 'L') ? PrintfArgKind::LONG_DOUBLE : PrintfArgKind::DOUBLE;
+                break;
+            }
+            case 's': {
+                spec.kind = (length == 'l') ? PrintfArgKind::WSTRING : PrintfArgKind::STRING;
+                break;
+            }
+            case 'p': {
+                spec.kind = PrintfArgKind::POINTER;
+                break;
+            }
+            case 'n': {
+                spec.kind = PrintfArgKind::WRITEBACK;
+                break;
+            }
+            default: {
+
+                //
+                // unknown conversion, does not consume anything
+                //
+                spec.kind = PrintfArgKind::NONE;
+                break;
+            }
+        }
+
+        if (count < max) {
+            specs[count] = spec;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+
+//
+// a format that has been parsed at compile time
+//
+// direct is false if FormatPrintfV must hand the whole format to vsnprintf, because of %n, positional arguments,
+// unknown conversions, or a trailing %
+//
+struct PrintfFormat {
+    const PrintfSpec *specs;
+    size_t count;
+    bool direct;
+};
+
+template <size_t N>
+struct ParsedPrintfFormat {
+
+    PrintfSpec specs[(N == 0) ? 1 : N];
+    bool direct;
+
+    constexpr PrintfFormat format() const {
+        return { specs, N, direct };
+    }
+};
+
+//
+// N must be ParsePrintfFormat(fmt, nullptr, 0)
+//
+template <size_t N>
+constexpr ParsedPrintfFormat<N> ParsePrintfFormatStatic(const char *fmt) {
+
+    ParsedPrintfFormat<N> parsed{};
+
+    ParsePrintfFormat(fmt, parsed.specs, N);
+
+    parsed.direct = true;
+
+    size_t end = 0;
+
+    for (size_t i = 0; i < N; i++) {
+
+        const PrintfSpec &spec = parsed.specs[i];
+
+        if (spec.kind == PrintfArgKind::WRITEBACK || (spec.kind == PrintfArgKind::NONE && spec.conversion != '%') ||
+                spec.end - spec.begin > PRINTF_ARGS_MAX_SPEC) {
+            parsed.direct = false;
+        }
+
+        end = spec.end;
+    }
+
+    for (size_t i = end; fmt[i] != '\0'; i++) {
+        if (fmt[i] == '%') {
+            parsed.direct = false;
+        }
+    }
+
+    return parsed;
+}
+
+//
+// consume the arguments described by specs from args and encode them into dst
+//
+// integers, pointers, and floating point values take 8 bytes each in native byte order
+// strings are stored as a 4-byte length followed by the bytes, truncated to PRINTF_ARGS_MAX_STRING
+//
+// returns the number of bytes written, or 0 with *overflow set if dst is too small
+//
+size_t EncodePrintfArgs(const PrintfSpec *specs, size_t count, va_list args, uint8_t *dst, size_t dstLen, bool *overflow);
+
+//
+// format fmt with args like vsnprintf, but without parsing fmt again
+//
+// literal text is copied, and conversions without flags or width are converted directly, such as %d, %zu, %x, %s,
+// %.3f, and %g
+// other conversions are passed to snprintf one at a time
+//
+// floating point is converted with std::to_chars when the locale's decimal point is '.', and with snprintf otherwise,
+// so the output matches printf in any locale
+//
+// format may be nullptr, and then this is just vsnprintf
+//
+int FormatPrintfV(char *out, size_t outLen, const char *fmt, const PrintfFormat *format, va_list args);
+
+//
+// format fmt with arguments previously encoded by EncodePrintfArgs
+//
+// behaves like snprintf: out is always NUL-terminated and the return value is the length that would have been written
+//
+size_t FormatEncodedPrintfArgs(const char *fmt, const PrintfSpec *specs, size_t count, const uint8_t *src, size_t srcLen, char *out, size_t outLen);
+
+//
+// FormatEncodedPrintfArgs without snprintf or the locale, so that it can be called from a signal handler
+//
+// flags and width are ignored, floats always use '.', and conversions that need snprintf, such as %a, are written as ?
+//
+size_t FormatEncodedPrintfArgsSignalSafe(const char *fmt, const PrintfSpec *specs, size_t count, const uint8_t *src, size_t srcLen, char *out, size_t outLen);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
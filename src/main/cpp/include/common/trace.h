@@ -0,0 +1,87 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "common/logging.h"
+#include "common/status.h"
+
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t
+
+
+//
+// Tracing
+//
+// While tracing, every LOG_ENTRY_EXIT records a span with its begin and end time and thread into a per-thread buffer,
+// whether or not LOGT is enabled.
+//
+// WriteChromeTrace writes the spans as Chrome trace-event JSON, which can be opened in https://ui.perfetto.dev or
+// chrome://tracing
+//
+// LOG_ENTRY_EXIT does nothing with DISABLE_LOGT, so there is nothing to trace either.
+//
+
+
+//
+// spans after this many in one thread are dropped, until the next StartTracing
+//
+constexpr size_t TRACE_MAX_SPANS_PER_THREAD = 1 << 20;
+
+
+//
+// discard spans from a previous run and start recording
+//
+Status StartTracing();
+
+//
+// stop recording, the spans are kept for WriteChromeTrace
+//
+void StopTracing();
+
+bool IsTracing();
+
+//
+// write every recorded span to path
+//
+Status WriteChromeTrace(const char *path);
+
+//
+// number of spans dropped because a thread reached TRACE_MAX_SPANS_PER_THREAD
+//
+size_t TraceDroppedCount();
+
+//
+// called from LogTracer and DebugLogTracer
+//
+void TraceSpan(const LogSite *site, const char *name, int64_t beginMicros, int64_t endMicros);
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -24,19 +24,33 @@
 #include <jni.h>
 #endif // IS_PLATFORM_ANDROID
 
-#include <string>
+#include <cstdarg> // for va_list
+#include <string_view>
 
 
-using unusualMessageCapturer_decl = void (*)(const std::string &message);
+//
+// message is only valid for the duration of the call, copy it to keep it
+//
+using unusualMessageCapturer_decl = void (*)(std::string_view message);
 
 
 void SetUnusualMessageCapturer(unusualMessageCapturer_decl capturer);
 
 void SetUnusualMessageCapturerWhileAborting(unusualMessageCapturer_decl capturer);
 
-void captureUnusualMessage(const std::string &message);
+void captureUnusualMessage(std::string_view message);
 
-void captureUnusualMessageWhileAborting(const std::string &message);
+void captureUnusualMessageWhileAborting(std::string_view message);
+
+//
+// used by ABORT_expandedV
+//
+// write the message at LOGLEVEL_FATAL, formatting it only once, and return it for
+// captureUnusualMessageWhileAborting, without any prefix or trailing newline
+//
+// the returned message is in a thread-local buffer and is valid until the next unusual message on the calling thread
+//
+std::string_view LogFatalForCaptureV(const char *tag, const char *fmt, va_list args);
 
 
 //
@@ -18,6 +18,8 @@
 
 #include "common/Accumulator.h"
 
+#include "common/accumulator_kernels.h"
+
 #undef NDEBUG
 
 #include "common/assert.h"
@@ -25,19 +27,43 @@
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <cstdint> // for UINT32_MAX
 
 
 #define TAG "Accumulator"
 
 
-Accumulator::Accumulator(size_t capacity) :
+//
+// no child
+//
+constexpr uint32_t NIL = UINT32_MAX;
+
+
+Accumulator::Accumulator(size_t capacity, AccumulatorMode modeIn) :
     _capacity(capacity),
+    mode(modeIn),
     buf(),
     index(),
     filteredMean(),
-    mean() {
+    mean(),
+    dirty(),
+    scratch(),
+    nodes(),
+    root(NIL),
+    rng(0x9e3779b9),
+    shift(),
+    shiftedSum(),
+    shiftedSumSquares() {
+
+    ASSERT(capacity < NIL);
 
     buf.reserve(capacity);
+
+    if (mode == AccumulatorMode::LAZY) {
+        scratch.reserve(capacity);
+    } else {
+        nodes.resize(capacity);
+    }
 }
 
 
@@ -50,6 +76,10 @@ double Accumulator::getFilteredMean() const {
 
     ASSERT(!buf.empty());
 
+    if (dirty) {
+        computeFromSamples();
+    }
+
     return filteredMean;
 }
 
@@ -57,74 +87,419 @@ double Accumulator::getMean() const {
 
     ASSERT(!buf.empty());
 
+    if (dirty) {
+        computeFromSamples();
+    }
+
     return mean;
 }
 
+//
+// LAZY mode: compute both statistics from buf, in O(n) and without allocating
+//
+void Accumulator::computeFromSamples() const {
+
+    size_t n = buf.size();
+
+    dirty = false;
+
+    if (n == 1) {
+
+        filteredMean = static_cast<double>(buf[0]);
+        mean = static_cast<double>(buf[0]);
+
+        return;
+    }
+
+    const AccumulatorKernels *kernels = GetAccumulatorKernels();
+
+    mean = kernels->sum(buf) / static_cast<double>(n);
+
+    double sd = ::sqrt(kernels->sumOfSquares(buf, mean) / static_cast<double>(n - 1));
+
+    //
+    // scratch has capacity reserved, so this does not allocate
+    //
+    scratch.assign(buf.begin(), buf.end());
+
+    auto mid = scratch.begin() + static_cast<ptrdiff_t>(n / 2);
+
+    std::nth_element(scratch.begin(), mid, scratch.end()); // NOLINT(*-use-ranges)
+
+    double median; // NOLINT(*-init-variables)
+    if (n % 2 == 0) {
+
+        //
+        // the other middle sample is the largest of the lower half
+        //
+        int64_t lower = *std::max_element(scratch.begin(), mid); // NOLINT(*-use-ranges)
+
+        median = (static_cast<double>(lower) + static_cast<double>(*mid)) / 2.0;
+
+    } else {
+
+        median = static_cast<double>(*mid);
+    }
+
+    size_t count = 0;
+    double sum = kernels->sumNear(buf, median, sd, &count);
+
+    filteredMean = sum / static_cast<double>(count);
+}
+
+//
+// the mean of the samples within one sample standard deviation of the median
+//
 double Accumulator::computeFilteredMean() const {
 
     ASSERT(2 <= buf.size());
 
-    std::vector<int64_t> tmp = buf;
+    size_t n = buf.size();
+
+    double sd = ::sqrt(momentsVariance());
+
+    double median; // NOLINT(*-init-variables)
+    if (n % 2 == 0) {
 
+        median = (static_cast<double>(treapKth((n - 1) / 2)) + static_cast<double>(treapKth(n / 2))) / 2.0;
+
+    } else {
+
+        median = static_cast<double>(treapKth(n / 2));
+    }
+
+    size_t count = 0;
     double sum = 0.0;
-    for (int64_t x : tmp) {
-        sum += static_cast<double>(x);
+    treapRange(median - sd, median + sd, &count, &sum);
+
+    return sum / static_cast<double>(count);
+}
+
+
+double Accumulator::computeMean() const {
+
+    ASSERT(2 <= buf.size());
+
+    return momentsMean();
+}
+
+
+//
+// running moments
+//
+// sums of (x - shift) and (x - shift)^2, where shift is near the mean
+//
+// for integer samples within 2^26 of shift every term and sum is exact, so adding and removing samples does not
+// build up rounding errors, and a variance that the old two-pass computation got exactly is also exact here,
+// which matters because samples exactly one sd from the median are kept by the filter
+//
+
+void Accumulator::momentsAdd(int64_t val) {
+
+    double d = static_cast<double>(val) - static_cast<double>(shift);
+
+    shiftedSum += d;
+    shiftedSumSquares += d * d;
+}
+
+void Accumulator::momentsRemove(int64_t val) {
+
+    double d = static_cast<double>(val) - static_cast<double>(shift);
+
+    shiftedSum -= d;
+    shiftedSumSquares -= d * d;
+}
+
+//
+// move shift to the current mean and recompute the sums, once per trip around the ring, which is O(1) amortized
+// per push
+//
+// keeps shift near the mean when the samples drift, and drops any rounding errors from samples that were not exact
+//
+void Accumulator::momentsResync() {
+
+    const AccumulatorKernels *kernels = GetAccumulatorKernels();
+
+    auto n = static_cast<double>(buf.size());
+
+    double sum = kernels->sum(buf);
+
+    shift = static_cast<int64_t>(std::llround(sum / n));
+
+    shiftedSum = sum - (n * static_cast<double>(shift));
+    shiftedSumSquares = kernels->sumOfSquares(buf, static_cast<double>(shift));
+}
+
+double Accumulator::momentsMean() const {
+    return static_cast<double>(shift) + (shiftedSum / static_cast<double>(buf.size()));
+}
+
+//
+// sample variance
+//
+double Accumulator::momentsVariance() const {
+
+    auto n = static_cast<double>(buf.size());
+
+    double m2 = shiftedSumSquares - ((shiftedSum * shiftedSum) / n);
+
+    return std::max(m2, 0.0) / (n - 1);
+}
+
+
+//
+// treap
+//
+// ordered by value, then by slot, so that every key is unique and a slot can be found to erase it
+//
+
+bool Accumulator::nodeLess(uint32_t a, uint32_t b) const {
+
+    if (nodes[a].value != nodes[b].value) {
+        return nodes[a].value < nodes[b].value;
     }
 
-    double meanTmp = sum / static_cast<double>(buf.size());
+    return a < b;
+}
+
+void Accumulator::nodeUpdate(uint32_t t) {
+
+    Node &node = nodes[t];
+
+    node.count = 1;
+    node.sum = static_cast<double>(node.value);
 
-    sum = 0.0;
-    for (int64_t x : tmp) {
-        sum += (static_cast<double>(x) - meanTmp) * (static_cast<double>(x) - meanTmp);
+    if (node.left != NIL) {
+        node.count += nodes[node.left].count;
+        node.sum += nodes[node.left].sum;
     }
 
-    double sd = ::sqrt(sum / static_cast<double>(buf.size() - 1));
+    if (node.right != NIL) {
+        node.count += nodes[node.right].count;
+        node.sum += nodes[node.right].sum;
+    }
+}
 
-    std::sort(tmp.begin(), tmp.end()); // NOLINT(*-use-ranges)
+//
+// every key in l is less than every key in r
+//
+uint32_t Accumulator::treapMerge(uint32_t l, uint32_t r) {
 
-    double median; // NOLINT(*-init-variables)
-    if (tmp.size() % 2 == 0) {
+    if (l == NIL) {
+        return r;
+    }
+
+    if (r == NIL) {
+        return l;
+    }
+
+    if (nodes[l].priority > nodes[r].priority) {
+
+        nodes[l].right = treapMerge(nodes[l].right, r);
+
+        nodeUpdate(l);
+
+        return l;
+    }
+
+    nodes[r].left = treapMerge(l, nodes[r].left);
+
+    nodeUpdate(r);
+
+    return r;
+}
+
+//
+// l gets the keys less than key, r gets the rest
+//
+void Accumulator::treapSplit(uint32_t t, uint32_t key, uint32_t *l, uint32_t *r) {
+
+    if (t == NIL) {
+
+        *l = NIL;
+        *r = NIL;
+
+        return;
+    }
+
+    if (nodeLess(t, key)) {
+
+        treapSplit(nodes[t].right, key, &nodes[t].right, r);
+
+        nodeUpdate(t);
 
-        median = static_cast<double>(tmp[(tmp.size() - 1) / 2] + tmp[tmp.size() / 2]) / 2.0;
+        *l = t;
 
     } else {
 
-        median = static_cast<double>(tmp[tmp.size() / 2]);
+        treapSplit(nodes[t].left, key, l, &nodes[t].left);
+
+        nodeUpdate(t);
+
+        *r = t;
     }
+}
 
-    std::vector<int64_t> tmp2;
-    tmp2.reserve(tmp.size());
-    for (int64_t x : tmp) {
-        if (std::abs(static_cast<double>(x) - median) <= sd) {
-            tmp2.push_back(x);
-        }
+uint32_t Accumulator::treapErase(uint32_t t, uint32_t key) {
+
+    ASSERT(t != NIL);
+
+    if (t == key) {
+        return treapMerge(nodes[t].left, nodes[t].right);
     }
 
-    sum = 0.0;
-    for (int64_t x : tmp2) {
-        sum += static_cast<double>(x);
+    if (nodeLess(key, t)) {
+        nodes[t].left = treapErase(nodes[t].left, key);
+    } else {
+        nodes[t].right = treapErase(nodes[t].right, key);
     }
 
-    meanTmp = sum / static_cast<double>(tmp2.size());
+    nodeUpdate(t);
 
-    return meanTmp;
+    return t;
 }
 
+void Accumulator::treapInsert(uint32_t key) {
 
-double Accumulator::computeMean() const {
+    //
+    // xorshift32
+    //
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
 
-    ASSERT(2 <= buf.size());
+    Node &node = nodes[key];
+
+    node.priority = rng;
+    node.left = NIL;
+    node.right = NIL;
+
+    nodeUpdate(key);
+
+    uint32_t l; // NOLINT(*-init-variables)
+    uint32_t r; // NOLINT(*-init-variables)
+    treapSplit(root, key, &l, &r);
+
+    root = treapMerge(treapMerge(l, key), r);
+}
+
+//
+// the k-th smallest sample, from 0
+//
+int64_t Accumulator::treapKth(size_t k) const {
+
+    uint32_t t = root;
+
+    while (true) {
+
+        ASSERT(t != NIL);
+
+        const Node &node = nodes[t];
+
+        size_t leftCount = (node.left != NIL) ? nodes[node.left].count : 0;
+
+        if (k < leftCount) {
 
-    std::vector<int64_t> tmp = buf;
+            t = node.left;
 
+        } else if (k == leftCount) {
+
+            return node.value;
+
+        } else {
+
+            k -= (leftCount + 1);
+
+            t = node.right;
+        }
+    }
+}
+
+//
+// count and sum of the samples x with lo <= x <= hi
+//
+void Accumulator::treapRange(double lo, double hi, size_t *countp, double *sump) const {
+
+    size_t count = 0;
     double sum = 0.0;
-    for (int64_t x : tmp) {
-        sum += static_cast<double>(x);
+
+    //
+    // find the highest node in range, everything in range is under it
+    //
+    uint32_t t = root;
+    while (t != NIL) {
+
+        auto x = static_cast<double>(nodes[t].value);
+
+        if (x < lo) {
+            t = nodes[t].right;
+        } else if (x > hi) {
+            t = nodes[t].left;
+        } else {
+            break;
+        }
     }
 
-    double meanTmp = sum / static_cast<double>(buf.size());
+    if (t != NIL) {
+
+        count = 1;
+        sum = static_cast<double>(nodes[t].value);
+
+        //
+        // the part of the left subtree that is >= lo
+        //
+        uint32_t u = nodes[t].left;
+        while (u != NIL) {
+
+            const Node &node = nodes[u];
+
+            if (static_cast<double>(node.value) >= lo) {
+
+                count += 1;
+                sum += static_cast<double>(node.value);
+
+                if (node.right != NIL) {
+                    count += nodes[node.right].count;
+                    sum += nodes[node.right].sum;
+                }
+
+                u = node.left;
+
+            } else {
+
+                u = node.right;
+            }
+        }
+
+        //
+        // the part of the right subtree that is <= hi
+        //
+        u = nodes[t].right;
+        while (u != NIL) {
+
+            const Node &node = nodes[u];
 
-    return meanTmp;
+            if (static_cast<double>(node.value) <= hi) {
+
+                count += 1;
+                sum += static_cast<double>(node.value);
+
+                if (node.left != NIL) {
+                    count += nodes[node.left].count;
+                    sum += nodes[node.left].sum;
+                }
+
+                u = node.right;
+
+            } else {
+
+                u = node.left;
+            }
+        }
+    }
+
+    *countp = count;
+    *sump = sum;
 }
 
 
@@ -140,8 +515,91 @@ int64_t Accumulator::last() const {
 
 void Accumulator::push(int64_t val) {
 
+    if (mode == AccumulatorMode::LAZY) {
+
+        if (buf.size() == _capacity) {
+            buf[index] = val;
+        } else {
+            buf.push_back(val);
+        }
+
+        index = ((index + 1) % _capacity);
+
+        dirty = true;
+
+        return;
+    }
+
+    pushEager(val);
+
+    updateStatistics();
+}
+
+
+void Accumulator::push(std::span<const int64_t> vals) {
+
+    if (vals.empty()) {
+        return;
+    }
+
+    if (mode == AccumulatorMode::LAZY) {
+
+        //
+        // copy in runs up to the end of the ring
+        //
+        while (!vals.empty()) {
+
+            if (buf.size() < _capacity) {
+
+                size_t take = std::min(vals.size(), _capacity - buf.size());
+
+                //
+                // buf has capacity reserved, so this does not allocate
+                //
+                buf.insert(buf.end(), vals.begin(), vals.begin() + static_cast<ptrdiff_t>(take));
+
+                index = (buf.size() % _capacity);
+
+                vals = vals.subspan(take);
+
+            } else {
+
+                size_t take = std::min(vals.size(), _capacity - index);
+
+                std::memcpy(&buf[index], vals.data(), take * sizeof(int64_t));
+
+                index = ((index + take) % _capacity);
+
+                vals = vals.subspan(take);
+            }
+        }
+
+        dirty = true;
+
+        return;
+    }
+
+    for (int64_t val : vals) {
+        pushEager(val);
+    }
+
+    updateStatistics();
+}
+
+
+//
+// EAGER mode: add val to the ring, the treap, and the running sums
+//
+void Accumulator::pushEager(int64_t val) {
+
+    auto slot = static_cast<uint32_t>(index);
+
     if (buf.size() == _capacity) {
 
+        root = treapErase(root, slot);
+
+        momentsRemove(buf[index]);
+
         buf[index] = val;
 
     } else {
@@ -149,8 +607,26 @@ void Accumulator::push(int64_t val) {
         buf.push_back(val);
     }
 
+    nodes[slot].value = val;
+
+    treapInsert(slot);
+
+    if (buf.size() == 1) {
+        shift = val;
+    }
+
+    momentsAdd(val);
+
     index = ((index + 1) % _capacity);
 
+    if (index == 0) {
+        momentsResync();
+    }
+}
+
+
+void Accumulator::updateStatistics() {
+
     if (buf.size() == 1) {
 
         filteredMean = static_cast<double>(buf[0]);
@@ -173,7 +649,7 @@ size_t Accumulator::size() const {
     return buf.size();
 }
 
-int64_t &Accumulator::operator[](size_t indexIn) {
+int64_t Accumulator::operator[](size_t indexIn) const {
     return buf[indexIn];
 }
 
@@ -0,0 +1,312 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/ConcurrentAccumulator.h"
+
+#undef NDEBUG
+
+#include "common/accumulator_kernels.h"
+#include "common/assert.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+#define TAG "ConcurrentAccumulator"
+
+
+//
+// every live thread that has pushed to any ConcurrentAccumulator has a distinct slot, which picks its shard in every
+// ConcurrentAccumulator
+//
+// slots of exited threads are reused, so there are never more slots than threads alive at once
+//
+static std::mutex threadSlotMutex;
+
+static std::vector<size_t> freeThreadSlots;
+
+static size_t nextThreadSlot = 0;
+
+class ThreadSlotHolder {
+public:
+
+    size_t slot;
+
+    ThreadSlotHolder() :
+        slot() {
+
+        std::lock_guard<std::mutex> lock(threadSlotMutex);
+
+        if (!freeThreadSlots.empty()) {
+
+            //
+            // the lowest free slot, so that slots stay below maxShards when they can
+            //
+            auto it = std::min_element(freeThreadSlots.begin(), freeThreadSlots.end()); // NOLINT(*-use-ranges)
+
+            slot = *it;
+
+            freeThreadSlots.erase(it);
+
+        } else {
+
+            slot = nextThreadSlot++;
+        }
+    }
+
+    //
+    // the mutex also orders the exiting thread's last pushes before the pushes of the next thread with this slot
+    //
+    ~ThreadSlotHolder() {
+
+        std::lock_guard<std::mutex> lock(threadSlotMutex);
+
+        freeThreadSlots.push_back(slot);
+    }
+};
+
+static size_t ThreadSlot() {
+
+    static thread_local ThreadSlotHolder holder;
+
+    return holder.slot;
+}
+
+
+//
+// int64_t per cache line
+//
+constexpr size_t SLOTS_PER_LINE = 64 / sizeof(int64_t);
+
+
+ConcurrentAccumulator::ConcurrentAccumulator(size_t shardCapacity, size_t maxShardsIn) :
+    _shardCapacity(shardCapacity),
+    maxShards(maxShardsIn),
+    shards(new Shard[maxShardsIn + 1]),
+    storage(),
+    overflowMutex() {
+
+    ASSERT(shardCapacity > 0);
+
+    //
+    // a line of padding after each ring, so that the last slots of one shard and the first slots of the next are
+    // never on the same line, however storage is aligned
+    //
+    size_t stride = (((shardCapacity + SLOTS_PER_LINE - 1) / SLOTS_PER_LINE) + 1) * SLOTS_PER_LINE;
+
+    storage.reset(new std::atomic<int64_t>[stride * (maxShards + 1)]());
+
+    for (size_t i = 0; i <= maxShards; i++) {
+
+        Shard &shard = shards[i];
+
+        shard.count.store(0, std::memory_order_relaxed);
+        shard.next = 0;
+        shard.slots = &storage[i * stride];
+    }
+}
+
+
+size_t ConcurrentAccumulator::shardCapacity() const {
+    return _shardCapacity;
+}
+
+
+void ConcurrentAccumulator::pushToShard(Shard &shard, size_t capacity, int64_t val) {
+
+    size_t i = shard.next;
+
+    shard.slots[i].store(val, std::memory_order_relaxed); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+    shard.next = (i + 1 == capacity) ? 0 : (i + 1);
+
+    //
+    // only written by this thread, so a load and a store is enough
+    //
+    shard.count.store(shard.count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+void ConcurrentAccumulator::push(int64_t val) {
+
+    size_t slot = ThreadSlot();
+
+    if (slot < maxShards) {
+
+        pushToShard(shards[slot], _shardCapacity, val);
+
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex);
+
+    pushToShard(shards[maxShards], _shardCapacity, val);
+}
+
+
+size_t ConcurrentAccumulator::size() const {
+
+    size_t n = 0;
+
+    for (size_t i = 0; i <= maxShards; i++) {
+        n += static_cast<size_t>(std::min<uint64_t>(shards[i].count.load(std::memory_order_acquire), _shardCapacity));
+    }
+
+    return n;
+}
+
+
+bool ConcurrentAccumulator::empty() const {
+    return size() == 0;
+}
+
+
+void ConcurrentAccumulator::copySamples(std::vector<int64_t> &dst) const {
+
+    dst.clear();
+
+    for (size_t i = 0; i <= maxShards; i++) {
+
+        const Shard &shard = shards[i];
+
+        //
+        // the first n slots have been written, and acquire makes their values visible
+        //
+        auto n = static_cast<size_t>(std::min<uint64_t>(shard.count.load(std::memory_order_acquire), _shardCapacity));
+
+        for (size_t j = 0; j < n; j++) {
+            dst.push_back(shard.slots[j].load(std::memory_order_relaxed)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        }
+    }
+}
+
+
+double ConcurrentAccumulator::getMean() const {
+
+    std::vector<int64_t> samples;
+    copySamples(samples);
+
+    ASSERT(!samples.empty());
+
+    return GetAccumulatorKernels()->sum(samples) / static_cast<double>(samples.size());
+}
+
+
+double ConcurrentAccumulator::getFilteredMean() const {
+
+    std::vector<int64_t> samples;
+    copySamples(samples);
+
+    ASSERT(!samples.empty());
+
+    size_t n = samples.size();
+
+    if (n == 1) {
+        return static_cast<double>(samples[0]);
+    }
+
+    const AccumulatorKernels *kernels = GetAccumulatorKernels();
+
+    double mean = kernels->sum(samples) / static_cast<double>(n);
+
+    double sd = std::sqrt(kernels->sumOfSquares(samples, mean) / static_cast<double>(n - 1));
+
+    //
+    // sumNear does not care about order, so the median can be found in place
+    //
+    auto mid = samples.begin() + static_cast<ptrdiff_t>(n / 2);
+
+    std::nth_element(samples.begin(), mid, samples.end()); // NOLINT(*-use-ranges)
+
+    double median; // NOLINT(*-init-variables)
+    if (n % 2 == 0) {
+        median = (static_cast<double>(*std::max_element(samples.begin(), mid)) + static_cast<double>(*mid)) / 2.0; // NOLINT(*-use-ranges)
+    } else {
+        median = static_cast<double>(*mid);
+    }
+
+    size_t count = 0;
+    double sum = kernels->sumNear(samples, median, sd, &count);
+
+    return sum / static_cast<double>(count);
+}
+
+
+int64_t ConcurrentAccumulator::getQuantile(double q) const {
+
+    int64_t out = 0;
+
+    getQuantiles(std::span<const double>(&q, 1), std::span<int64_t>(&out, 1));
+
+    return out;
+}
+
+
+void ConcurrentAccumulator::getQuantiles(std::span<const double> qs, std::span<int64_t> out) const {
+
+    ASSERT(qs.size() == out.size());
+
+    std::vector<int64_t> samples;
+    copySamples(samples);
+
+    ASSERT(!samples.empty());
+
+    size_t n = samples.size();
+
+    //
+    // each nth_element only has to look past the previous rank
+    //
+    auto first = samples.begin();
+
+    for (size_t i = 0; i < qs.size(); i++) {
+
+        double q = std::clamp(qs[i], 0.0, 1.0);
+
+        ASSERT(i == 0 || qs[i - 1] <= qs[i]);
+
+        auto rank = static_cast<size_t>(std::ceil(q * static_cast<double>(n)));
+
+        rank = (rank == 0) ? 0 : (rank - 1);
+
+        auto nth = samples.begin() + static_cast<ptrdiff_t>(rank);
+
+        if (nth >= first) {
+
+            std::nth_element(first, nth, samples.end()); // NOLINT(*-use-ranges)
+
+            first = nth;
+        }
+
+        out[i] = *nth;
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
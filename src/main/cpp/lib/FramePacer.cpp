@@ -0,0 +1,116 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/FramePacer.h"
+
+#undef NDEBUG
+
+#include "common/assert.h"
+#include "common/clock.h"
+
+
+#define TAG "FramePacer"
+
+
+FramePacer::FramePacer(int64_t periodMicrosIn, size_t historyCapacity) :
+    periodMicros(periodMicrosIn),
+    nextDeadline(),
+    missed(),
+    overshoot(historyCapacity) {
+
+    ASSERT(periodMicros > 0);
+}
+
+
+int64_t FramePacer::period() const {
+    return periodMicros;
+}
+
+
+void FramePacer::setPeriod(int64_t periodMicrosIn) {
+
+    ASSERT(periodMicrosIn > 0);
+
+    if (nextDeadline != 0) {
+        nextDeadline += (periodMicrosIn - periodMicros);
+    }
+
+    periodMicros = periodMicrosIn;
+}
+
+
+void FramePacer::reset() {
+    nextDeadline = 0;
+}
+
+
+int64_t FramePacer::waitForNextFrame() {
+
+    if (nextDeadline == 0) {
+        nextDeadline = uptimeMicros() + periodMicros;
+    }
+
+    int64_t now = uptimeMicros();
+
+    if (now >= nextDeadline) {
+
+        //
+        // the frame ran past the deadline, so skip to the next deadline that is still ahead
+        //
+        int64_t behind = ((now - nextDeadline) / periodMicros) + 1;
+
+        missed += behind;
+
+        nextDeadline += (behind * periodMicros);
+    }
+
+    int64_t deadline = nextDeadline;
+
+    int64_t woke = sleepUntilMicros(deadline);
+
+    overshoot.push(woke - deadline);
+
+    nextDeadline += periodMicros;
+
+    return deadline;
+}
+
+
+const Accumulator &FramePacer::getOvershoot() const {
+    return overshoot;
+}
+
+
+int64_t FramePacer::missedFrames() const {
+    return missed;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
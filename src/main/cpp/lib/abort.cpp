@@ -18,10 +18,12 @@
 
 #include "common/abort.h"
 
+#include "common/flight_recorder.h"
 #include "common/logging.h"
 #include "common/unusual_message.h"
 
 #include <cstdlib> // for abort
+#include <string_view>
 
 
 #define TAG "abort"
@@ -42,15 +44,24 @@ void ABORT_expanded(const char *tag, const char *fmt, ...) {
 
 void ABORT_expandedV(const char *tag, const char *fmt, va_list args) {
 
-    LOGF_expandedV(tag, fmt, args);
+    //
+    // formatted once, and the same message is captured below
+    //
+    std::string_view message = LogFatalForCaptureV(tag, fmt, args);
+
+    //
+    // make sure that anything still queued by async logging is written before aborting
+    //
+    FlushLogs();
 
     //
-    // fine if truncated
+    // the records leading up to this
     //
-    char buf[1000];
-    std::vsnprintf(buf, sizeof(buf), fmt, args);
+    DumpFlightRecorderOnCrash();
 
-    captureUnusualMessageWhileAborting(buf);
+    if (message.data() != nullptr) {
+        captureUnusualMessageWhileAborting(message);
+    }
 
     std::abort();
 }
@@ -0,0 +1,466 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/accumulator_kernels.h"
+
+#if (__GNUC__ || __clang__) && __x86_64__
+#include <immintrin.h>
+#elif __aarch64__
+#include <arm_neon.h>
+#endif // (__GNUC__ || __clang__) && __x86_64__
+
+#include <cmath> // for abs
+
+
+#define TAG "AccumulatorKernels"
+
+
+//
+// scalar
+//
+
+static double SumScalar(std::span<const int64_t> x) {
+
+    double s = 0.0;
+    for (int64_t v : x) {
+        s += static_cast<double>(v);
+    }
+
+    return s;
+}
+
+static double SumOfSquaresScalar(std::span<const int64_t> x, double mean) {
+
+    double s = 0.0;
+    for (int64_t v : x) {
+        s += (static_cast<double>(v) - mean) * (static_cast<double>(v) - mean);
+    }
+
+    return s;
+}
+
+static double SumNearScalar(std::span<const int64_t> x, double center, double radius, size_t *count) {
+
+    size_t c = 0;
+    double s = 0.0;
+    for (int64_t v : x) {
+        if (std::abs(static_cast<double>(v) - center) <= radius) {
+            c++;
+            s += static_cast<double>(v);
+        }
+    }
+
+    *count = c;
+
+    return s;
+}
+
+static const AccumulatorKernels scalarKernels = {
+    "scalar",
+    SumScalar,
+    SumOfSquaresScalar,
+    SumNearScalar,
+};
+
+
+#if (__GNUC__ || __clang__) && __x86_64__
+
+//
+// SSE2 and AVX2 have no int64 to double conversion, so split each int64 into its top 16 bits and its low 48 bits,
+// put each part into the mantissa of a double with a magic exponent, and subtract the magic numbers
+//
+// exact up to the final add, which rounds the same way as cvtsi2sd, so the result equals static_cast<double>
+//
+// 3 * 2^67
+//
+constexpr double MAGIC_HI = 442721857769029238784.0;
+
+//
+// 3 * 2^67 + 2^52
+//
+constexpr double MAGIC_HI_LO = 442726361368656609280.0;
+
+//
+// 2^52
+//
+constexpr double MAGIC_LO = 4503599627370496.0;
+
+constexpr int64_t LOW_48_BITS = 0x0000FFFFFFFFFFFF;
+
+//
+// SSE2, which every x86-64 CPU has
+//
+
+static __m128d ToDoubleSse2(__m128i x) {
+
+    __m128i hi = _mm_and_si128(_mm_srai_epi32(x, 16), _mm_set_epi32(-1, 0, -1, 0));
+    hi = _mm_add_epi64(hi, _mm_castpd_si128(_mm_set1_pd(MAGIC_HI)));
+
+    __m128i lo = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi64x(LOW_48_BITS)), _mm_castpd_si128(_mm_set1_pd(MAGIC_LO)));
+
+    __m128d f = _mm_sub_pd(_mm_castsi128_pd(hi), _mm_set1_pd(MAGIC_HI_LO));
+
+    return _mm_add_pd(f, _mm_castsi128_pd(lo));
+}
+
+static __m128d LoadSse2(const int64_t *p) {
+    return ToDoubleSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))); // NOLINT(*-reinterpret-cast)
+}
+
+static double HorizontalSumSse2(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+static double SumSse2(std::span<const int64_t> x) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    __m128d s0 = _mm_setzero_pd();
+    __m128d s1 = _mm_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, LoadSse2(p + i)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        s1 = _mm_add_pd(s1, LoadSse2(p + i + 2)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    double s = HorizontalSumSse2(_mm_add_pd(s0, s1));
+
+    return s + SumScalar(x.subspan(i));
+}
+
+static double SumOfSquaresSse2(std::span<const int64_t> x, double mean) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    __m128d m = _mm_set1_pd(mean);
+    __m128d s0 = _mm_setzero_pd();
+    __m128d s1 = _mm_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d d0 = _mm_sub_pd(LoadSse2(p + i), m); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        __m128d d1 = _mm_sub_pd(LoadSse2(p + i + 2), m); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        s0 = _mm_add_pd(s0, _mm_mul_pd(d0, d0));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(d1, d1));
+    }
+
+    double s = HorizontalSumSse2(_mm_add_pd(s0, s1));
+
+    return s + SumOfSquaresScalar(x.subspan(i), mean);
+}
+
+static double SumNearSse2(std::span<const int64_t> x, double center, double radius, size_t *count) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    __m128d c = _mm_set1_pd(center);
+    __m128d r = _mm_set1_pd(radius);
+    __m128d signBit = _mm_set1_pd(-0.0);
+
+    __m128d s = _mm_setzero_pd();
+    __m128i counts = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+
+        __m128d v = LoadSse2(p + i); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        __m128d near = _mm_cmple_pd(_mm_andnot_pd(signBit, _mm_sub_pd(v, c)), r);
+
+        s = _mm_add_pd(s, _mm_and_pd(near, v));
+
+        //
+        // near is all ones, which is -1, in each lane that is kept
+        //
+        counts = _mm_sub_epi64(counts, _mm_castpd_si128(near));
+    }
+
+    size_t tailCount = 0;
+    double sum = HorizontalSumSse2(s) + SumNearScalar(x.subspan(i), center, radius, &tailCount);
+
+    auto c0 = static_cast<size_t>(_mm_cvtsi128_si64(counts));
+    auto c1 = static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(counts, counts)));
+
+    *count = c0 + c1 + tailCount;
+
+    return sum;
+}
+
+static const AccumulatorKernels sse2Kernels = {
+    "SSE2",
+    SumSse2,
+    SumOfSquaresSse2,
+    SumNearSse2,
+};
+
+//
+// AVX2, compiled for AVX2 function by function, so the rest of the library still runs on any x86-64 CPU
+//
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static __m256d ToDoubleAvx2(__m256i x) {
+
+    __m256i hi = _mm256_blend_epi32(_mm256_srai_epi32(x, 16), _mm256_setzero_si256(), 0x55);
+    hi = _mm256_add_epi64(hi, _mm256_castpd_si256(_mm256_set1_pd(MAGIC_HI)));
+
+    __m256i lo = _mm256_or_si256(_mm256_and_si256(x, _mm256_set1_epi64x(LOW_48_BITS)),
+        _mm256_castpd_si256(_mm256_set1_pd(MAGIC_LO)));
+
+    __m256d f = _mm256_sub_pd(_mm256_castsi256_pd(hi), _mm256_set1_pd(MAGIC_HI_LO));
+
+    return _mm256_add_pd(f, _mm256_castsi256_pd(lo));
+}
+
+AVX2_TARGET static __m256d LoadAvx2(const int64_t *p) {
+    return ToDoubleAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))); // NOLINT(*-reinterpret-cast)
+}
+
+AVX2_TARGET static double HorizontalSumAvx2(__m256d v) {
+
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+AVX2_TARGET static double SumAvx2(std::span<const int64_t> x) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, LoadAvx2(p + i)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        s1 = _mm256_add_pd(s1, LoadAvx2(p + i + 4)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    double s = HorizontalSumAvx2(_mm256_add_pd(s0, s1));
+
+    return s + SumScalar(x.subspan(i));
+}
+
+AVX2_TARGET static double SumOfSquaresAvx2(std::span<const int64_t> x, double mean) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    __m256d m = _mm256_set1_pd(mean);
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d d0 = _mm256_sub_pd(LoadAvx2(p + i), m); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        __m256d d1 = _mm256_sub_pd(LoadAvx2(p + i + 4), m); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(d0, d0));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(d1, d1));
+    }
+
+    double s = HorizontalSumAvx2(_mm256_add_pd(s0, s1));
+
+    return s + SumOfSquaresScalar(x.subspan(i), mean);
+}
+
+AVX2_TARGET static double SumNearAvx2(std::span<const int64_t> x, double center, double radius, size_t *count) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    __m256d c = _mm256_set1_pd(center);
+    __m256d r = _mm256_set1_pd(radius);
+    __m256d signBit = _mm256_set1_pd(-0.0);
+
+    __m256d s = _mm256_setzero_pd();
+    __m256i counts = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+
+        __m256d v = LoadAvx2(p + i); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        __m256d near = _mm256_cmp_pd(_mm256_andnot_pd(signBit, _mm256_sub_pd(v, c)), r, _CMP_LE_OQ);
+
+        s = _mm256_add_pd(s, _mm256_and_pd(near, v));
+
+        counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(near));
+    }
+
+    size_t tailCount = 0;
+    double sum = HorizontalSumAvx2(s) + SumNearScalar(x.subspan(i), center, radius, &tailCount);
+
+    __m128i c2 = _mm_add_epi64(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+
+    auto c0 = static_cast<size_t>(_mm_cvtsi128_si64(c2));
+    auto c1 = static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(c2, c2)));
+
+    *count = c0 + c1 + tailCount;
+
+    return sum;
+}
+
+#undef AVX2_TARGET
+
+static const AccumulatorKernels avx2Kernels = {
+    "AVX2",
+    SumAvx2,
+    SumOfSquaresAvx2,
+    SumNearAvx2,
+};
+
+static const AccumulatorKernels *const x86Kernels[] = { &scalarKernels, &sse2Kernels, &avx2Kernels };
+
+std::span<const AccumulatorKernels *const> GetAvailableAccumulatorKernels() {
+
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+
+    return std::span(x86Kernels).first(hasAvx2 ? 3 : 2);
+}
+
+#elif __aarch64__
+
+//
+// NEON, which every ARM64 CPU has
+//
+
+static double SumNeon(std::span<const int64_t> x) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    float64x2_t s0 = vdupq_n_f64(0.0);
+    float64x2_t s1 = vdupq_n_f64(0.0);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = vaddq_f64(s0, vcvtq_f64_s64(vld1q_s64(p + i))); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        s1 = vaddq_f64(s1, vcvtq_f64_s64(vld1q_s64(p + i + 2))); // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    double s = vaddvq_f64(vaddq_f64(s0, s1));
+
+    return s + SumScalar(x.subspan(i));
+}
+
+static double SumOfSquaresNeon(std::span<const int64_t> x, double mean) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    float64x2_t m = vdupq_n_f64(mean);
+    float64x2_t s0 = vdupq_n_f64(0.0);
+    float64x2_t s1 = vdupq_n_f64(0.0);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float64x2_t d0 = vsubq_f64(vcvtq_f64_s64(vld1q_s64(p + i)), m); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        float64x2_t d1 = vsubq_f64(vcvtq_f64_s64(vld1q_s64(p + i + 2)), m); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        s0 = vaddq_f64(s0, vmulq_f64(d0, d0));
+        s1 = vaddq_f64(s1, vmulq_f64(d1, d1));
+    }
+
+    double s = vaddvq_f64(vaddq_f64(s0, s1));
+
+    return s + SumOfSquaresScalar(x.subspan(i), mean);
+}
+
+static double SumNearNeon(std::span<const int64_t> x, double center, double radius, size_t *count) {
+
+    size_t n = x.size();
+    const int64_t *p = x.data();
+
+    float64x2_t c = vdupq_n_f64(center);
+    float64x2_t r = vdupq_n_f64(radius);
+
+    float64x2_t s = vdupq_n_f64(0.0);
+    uint64x2_t counts = vdupq_n_u64(0);
+
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+
+        float64x2_t v = vcvtq_f64_s64(vld1q_s64(p + i)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        uint64x2_t near = vcleq_f64(vabsq_f64(vsubq_f64(v, c)), r);
+
+        s = vaddq_f64(s, vreinterpretq_f64_u64(vandq_u64(near, vreinterpretq_u64_f64(v))));
+
+        counts = vsubq_u64(counts, near);
+    }
+
+    size_t tailCount = 0;
+    double sum = vaddvq_f64(s) + SumNearScalar(x.subspan(i), center, radius, &tailCount);
+
+    *count = static_cast<size_t>(vaddvq_u64(counts)) + tailCount;
+
+    return sum;
+}
+
+static const AccumulatorKernels neonKernels = {
+    "NEON",
+    SumNeon,
+    SumOfSquaresNeon,
+    SumNearNeon,
+};
+
+static const AccumulatorKernels *const armKernels[] = { &scalarKernels, &neonKernels };
+
+std::span<const AccumulatorKernels *const> GetAvailableAccumulatorKernels() {
+    return armKernels;
+}
+
+#else
+
+static const AccumulatorKernels *const onlyScalarKernels[] = { &scalarKernels };
+
+std::span<const AccumulatorKernels *const> GetAvailableAccumulatorKernels() {
+    return onlyScalarKernels;
+}
+
+#endif // (__GNUC__ || __clang__) && __x86_64__
+
+
+const AccumulatorKernels *GetAccumulatorKernels() {
+
+    //
+    // the last one is the fastest
+    //
+    static const AccumulatorKernels *kernels = GetAvailableAccumulatorKernels().back();
+
+    return kernels;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
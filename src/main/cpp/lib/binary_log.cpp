@@ -0,0 +1,498 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#if _MSC_VER
+#define _CRT_SECURE_NO_DEPRECATE // disable warnings about fopen being insecure on MSVC
+#endif // _MSC_VER
+
+#include "common/binary_log.h"
+
+#undef NDEBUG
+
+#include "common/assert.h"
+#include "common/check.h"
+#include "common/clock.h"
+#include "common/error.h"
+#include "common/log_site_info.h"
+#include "common/logging.h"
+#include "common/printf_args.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring> // for memcpy, strerror
+
+
+#define TAG "binary_log"
+
+
+using enum Status;
+
+
+constexpr size_t BINARY_LOG_THREAD_BUFFER_SIZE = 64 * 1024;
+
+//
+// records with more argument bytes than this fall back to text
+//
+constexpr size_t BINARY_LOG_MAX_ARGS_SIZE = 8 * 1024;
+
+//
+// the decoder rejects site strings (tag, file, format) longer than this, so that a corrupt length does not allocate
+// gigabytes
+//
+constexpr size_t BINARY_LOG_MAX_STRING_SIZE = 64 * 1024;
+
+//
+// type + id + timestamp + argument length
+//
+constexpr size_t BINARY_LOG_EVENT_HEADER_SIZE = 1 + 4 + 8 + 4;
+
+
+struct BinaryLogThreadBuffer {
+
+    //
+    // held by the owning thread while appending, and by flushers
+    //
+    std::atomic<bool> busy;
+
+    size_t len;
+    uint8_t data[BINARY_LOG_THREAD_BUFFER_SIZE];
+};
+
+
+//
+// protects binaryLogFile, site records, and threadBuffers
+//
+// lock order: binaryLogMutex, then BinaryLogThreadBuffer::busy
+//
+static std::mutex binaryLogMutex;
+
+static FILE *binaryLogFile = nullptr;
+
+static std::atomic<bool> binaryLogging = false;
+
+//
+// incremented by every StartBinaryLogging
+//
+static std::atomic<uint32_t> binaryLogGeneration = 0;
+
+//
+// indexed by site id, generation of the file that the site record was last written to
+//
+static std::atomic<uint32_t> siteGenerations[LOGSITE_MAX_INFOS];
+
+static std::vector<BinaryLogThreadBuffer *> threadBuffers;
+
+
+static void LockBuffer(BinaryLogThreadBuffer *b) {
+    while (b->busy.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+static void UnlockBuffer(BinaryLogThreadBuffer *b) {
+    b->busy.store(false, std::memory_order_release);
+}
+
+//
+// binaryLogMutex must be held
+//
+static void FlushBufferLocked(BinaryLogThreadBuffer *b) {
+
+    LockBuffer(b);
+
+    if (binaryLogFile != nullptr && b->len != 0) {
+        std::fwrite(b->data, 1, b->len, binaryLogFile);
+    }
+
+    b->len = 0;
+
+    UnlockBuffer(b);
+}
+
+static void FlushBuffer(BinaryLogThreadBuffer *b) {
+
+    std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+    FlushBufferLocked(b);
+}
+
+
+//
+// owns the calling thread's buffer and flushes it when the thread exits
+//
+class BinaryLogThreadBufferHolder {
+public:
+
+    BinaryLogThreadBuffer *buffer;
+
+    BinaryLogThreadBufferHolder() :
+        buffer(new BinaryLogThreadBuffer()) {
+
+        std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+        threadBuffers.push_back(buffer);
+    }
+
+    ~BinaryLogThreadBufferHolder() {
+
+        std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+        FlushBufferLocked(buffer);
+
+        std::erase(threadBuffers, buffer);
+
+        delete buffer;
+    }
+};
+
+static BinaryLogThreadBuffer *GetThreadBuffer() {
+
+    //
+    // allocated on first use so that threads that never log do not pay for the buffer
+    //
+    static thread_local BinaryLogThreadBufferHolder holder;
+
+    return holder.buffer;
+}
+
+
+static void WriteString(FILE *file, const char *str) {
+
+    auto len = static_cast<uint32_t>(std::strlen(str));
+
+    std::fwrite(&len, 4, 1, file);
+    std::fwrite(str, 1, len, file);
+}
+
+static void DefineSite(const LogSite *site, int id, uint32_t generation) {
+
+    std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+    if (siteGenerations[id].load(std::memory_order_relaxed) == generation) {
+        return;
+    }
+
+    if (binaryLogFile != nullptr) {
+
+        uint8_t type = BINARY_LOG_RECORD_SITE;
+        auto id32 = static_cast<uint32_t>(id);
+        auto level32 = static_cast<int32_t>(site->level);
+        auto line32 = static_cast<int32_t>(site->line);
+
+        std::fwrite(&type, 1, 1, binaryLogFile);
+        std::fwrite(&id32, 4, 1, binaryLogFile);
+        std::fwrite(&level32, 4, 1, binaryLogFile);
+        std::fwrite(&line32, 4, 1, binaryLogFile);
+        WriteString(binaryLogFile, site->tag);
+        WriteString(binaryLogFile, site->file);
+        WriteString(binaryLogFile, site->fmt);
+    }
+
+    siteGenerations[id].store(generation, std::memory_order_release);
+}
+
+
+bool BinaryLogWriteV(LogSite *site, va_list args) {
+
+    //
+    // too many arguments or too many sites, LogSite_expanded falls back to text
+    //
+    const LogSiteInfo *info = GetLogSiteInfo(site);
+    if (info == nullptr) {
+        return false;
+    }
+
+    int id = site->id;
+
+    uint32_t generation = binaryLogGeneration.load(std::memory_order_acquire);
+    if (siteGenerations[id].load(std::memory_order_acquire) != generation) {
+        DefineSite(site, id, generation);
+    }
+
+    int64_t now = uptimeMicros();
+
+    BinaryLogThreadBuffer *b = GetThreadBuffer();
+
+    LockBuffer(b);
+
+    if (BINARY_LOG_THREAD_BUFFER_SIZE - b->len < BINARY_LOG_EVENT_HEADER_SIZE + BINARY_LOG_MAX_ARGS_SIZE) {
+        UnlockBuffer(b);
+        FlushBuffer(b);
+        LockBuffer(b);
+    }
+
+    uint8_t *p = b->data + b->len;
+
+    bool overflow; // NOLINT(*-init-variables)
+    size_t argsLen = EncodePrintfArgs(info->specs, info->specCount, args, p + BINARY_LOG_EVENT_HEADER_SIZE, BINARY_LOG_MAX_ARGS_SIZE, &overflow);
+
+    if (overflow) {
+        UnlockBuffer(b);
+        return false;
+    }
+
+    auto id32 = static_cast<uint32_t>(id);
+    auto argsLen32 = static_cast<uint32_t>(argsLen);
+
+    p[0] = BINARY_LOG_RECORD_EVENT;
+    std::memcpy(p + 1, &id32, 4);
+    std::memcpy(p + 5, &now, 8);
+    std::memcpy(p + 13, &argsLen32, 4);
+
+    b->len += BINARY_LOG_EVENT_HEADER_SIZE + argsLen;
+
+    UnlockBuffer(b);
+
+    return true;
+}
+
+
+Status StartBinaryLogging(const char *path) {
+
+    std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+    RETURN_ERR_IF_TRUE(binaryLogFile != nullptr, "binary logging already started");
+
+    binaryLogFile = std::fopen(path, "wb");
+
+    RETURN_ERR_IF_FALSE(binaryLogFile, "cannot open %s: %s (%s)", path, std::strerror(errno), ErrorName(errno));
+
+    int64_t epochMillis = timeSinceEpochMillis();
+    int64_t uptime = uptimeMicros();
+
+    std::fwrite(BINARY_LOG_MAGIC, 1, 8, binaryLogFile);
+    std::fwrite(&epochMillis, 8, 1, binaryLogFile);
+    std::fwrite(&uptime, 8, 1, binaryLogFile);
+
+    //
+    // thread buffers may hold records from a previous file
+    //
+    for (BinaryLogThreadBuffer *b : threadBuffers) {
+        LockBuffer(b);
+        b->len = 0;
+        UnlockBuffer(b);
+    }
+
+    binaryLogGeneration.fetch_add(1, std::memory_order_acq_rel);
+
+    binaryLogging.store(true, std::memory_order_release);
+
+    return OK;
+}
+
+void StopBinaryLogging() {
+
+    binaryLogging.store(false, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+    if (binaryLogFile == nullptr) {
+        return;
+    }
+
+    for (BinaryLogThreadBuffer *b : threadBuffers) {
+        FlushBufferLocked(b);
+    }
+
+    if (std::fclose(binaryLogFile) != 0) {
+        LOGE("fclose failed");
+    }
+
+    binaryLogFile = nullptr;
+}
+
+void FlushBinaryLog() {
+
+    std::lock_guard<std::mutex> lock(binaryLogMutex);
+
+    if (binaryLogFile == nullptr) {
+        return;
+    }
+
+    for (BinaryLogThreadBuffer *b : threadBuffers) {
+        FlushBufferLocked(b);
+    }
+
+    std::fflush(binaryLogFile);
+}
+
+bool IsBinaryLogging() {
+    return binaryLogging.load(std::memory_order_relaxed);
+}
+
+
+//
+// decoding
+//
+
+struct DecodedSite {
+    int level;
+    int line;
+    std::string tag;
+    std::string file;
+    std::string fmt;
+    std::vector<PrintfSpec> specs;
+};
+
+static bool ReadExact(FILE *in, void *buf, size_t len) {
+    return std::fread(buf, 1, len, in) == len;
+}
+
+static bool ReadString(FILE *in, std::string &out) {
+
+    uint32_t len; // NOLINT(*-init-variables)
+    if (!ReadExact(in, &len, 4)) {
+        return false;
+    }
+
+    if (len > BINARY_LOG_MAX_STRING_SIZE) {
+        return false;
+    }
+
+    out.resize(len);
+
+    return ReadExact(in, out.data(), len);
+}
+
+static char LevelLetter(int level) {
+    switch (level) {
+        case LOGLEVEL_FATAL: return 'F';
+        case LOGLEVEL_ERROR: return 'E';
+        case LOGLEVEL_WARN: return 'W';
+        case LOGLEVEL_INFO: return 'I';
+        case LOGLEVEL_DEBUG: return 'D';
+        case LOGLEVEL_TRACE: return 'T';
+        default: return '?';
+    }
+}
+
+Status DecodeBinaryLog(FILE *in, FILE *out, bool timestamps) {
+
+    char magic[8];
+    int64_t epochMillis; // NOLINT(*-init-variables)
+    int64_t uptimeStart; // NOLINT(*-init-variables)
+
+    RETURN_ERR_IF_FALSE(ReadExact(in, magic, 8), "cannot read header");
+    RETURN_ERR_IF_FALSE(std::memcmp(magic, BINARY_LOG_MAGIC, 8) == 0, "not a binary log");
+    RETURN_ERR_IF_FALSE(ReadExact(in, &epochMillis, 8), "cannot read header");
+    RETURN_ERR_IF_FALSE(ReadExact(in, &uptimeStart, 8), "cannot read header");
+
+    std::vector<DecodedSite> sites;
+    std::vector<uint8_t> args;
+    std::vector<char> text(4096);
+
+    for (;;) {
+
+        int type = std::fgetc(in);
+
+        if (type == EOF) {
+            break;
+        }
+
+        if (type == BINARY_LOG_RECORD_SITE) {
+
+            uint32_t id; // NOLINT(*-init-variables)
+            int32_t level; // NOLINT(*-init-variables)
+            int32_t line; // NOLINT(*-init-variables)
+
+            DecodedSite site;
+
+            RETURN_ERR_IF_FALSE(ReadExact(in, &id, 4) && ReadExact(in, &level, 4) && ReadExact(in, &line, 4), "truncated site record");
+            RETURN_ERR_IF_TRUE(id >= LOGSITE_MAX_INFOS, "site id out of range: %u", id);
+            RETURN_ERR_IF_FALSE(ReadString(in, site.tag) && ReadString(in, site.file) && ReadString(in, site.fmt), "truncated or corrupt site record");
+
+            site.level = level;
+            site.line = line;
+
+            size_t specCount = ParsePrintfFormat(site.fmt.c_str(), nullptr, 0);
+            site.specs.resize(specCount);
+            ParsePrintfFormat(site.fmt.c_str(), site.specs.data(), specCount);
+
+            if (sites.size() <= id) {
+                sites.resize(id + 1);
+            }
+            sites[id] = std::move(site);
+
+            continue;
+        }
+
+        RETURN_ERR_IF_FALSE(type == BINARY_LOG_RECORD_EVENT, "unrecognized record type: %d", type);
+
+        uint32_t id; // NOLINT(*-init-variables)
+        int64_t uptime; // NOLINT(*-init-variables)
+        uint32_t argsLen; // NOLINT(*-init-variables)
+
+        RETURN_ERR_IF_FALSE(ReadExact(in, &id, 4) && ReadExact(in, &uptime, 8) && ReadExact(in, &argsLen, 4), "truncated event record");
+        RETURN_ERR_IF_TRUE(argsLen > BINARY_LOG_MAX_ARGS_SIZE, "event arguments too long: %u", argsLen);
+
+        args.resize(argsLen);
+        RETURN_ERR_IF_FALSE(ReadExact(in, args.data(), argsLen), "truncated event record");
+
+        if (sites.size() <= id || sites[id].fmt.empty()) {
+            std::fprintf(out, "<unknown site %u>\n", id);
+            continue;
+        }
+
+        const DecodedSite &site = sites[id];
+
+        size_t len = FormatEncodedPrintfArgs(site.fmt.c_str(), site.specs.data(), site.specs.size(), args.data(), args.size(), text.data(), text.size());
+        if (len >= text.size()) {
+            text.resize(len + 1);
+            FormatEncodedPrintfArgs(site.fmt.c_str(), site.specs.data(), site.specs.size(), args.data(), args.size(), text.data(), text.size());
+        }
+
+        if (timestamps) {
+
+            int64_t millis = epochMillis + ((uptime - uptimeStart) / 1000);
+
+            char timeBuf[FORMATTIME_LEN + 1];
+            formatTime(static_cast<time_t>(millis / 1000), timeBuf, sizeof(timeBuf));
+
+            std::fprintf(out, "%s.%03d %c %s: ", timeBuf, static_cast<int>(millis % 1000), LevelLetter(site.level), site.tag.c_str());
+        }
+
+        std::fwrite(text.data(), 1, len, out);
+
+        if (len == 0 || text[len - 1] != '\n') {
+            std::fputc('\n', out);
+        }
+    }
+
+    return OK;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
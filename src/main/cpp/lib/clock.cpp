@@ -16,10 +16,6 @@
 // WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-#if _MSC_VER
-#define _CRT_SECURE_NO_WARNINGS // disable warnings about localtime being unsafe on MSVC
-#endif // _MSC_VER
-
 #include "common/clock.h"
 
 #undef NDEBUG
@@ -34,21 +30,32 @@
 #include <ctime> // for clock_gettime
 #elif IS_PLATFORM_IOS || IS_PLATFORM_MACOS
 #elif IS_PLATFORM_WINDOWS
-#include <windows.h>
-#include <sysinfoapi.h> // for GetTickCount64
+#include <windows.h> // for YieldProcessor
 #else
 #error Unsupported platform
 #endif // IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
 
+#if (__GNUC__ || __clang__) && __x86_64__
+#include <cpuid.h> // for __get_cpuid
+#include <x86intrin.h> // for __rdtsc
+#endif // (__GNUC__ || __clang__) && __x86_64__
+
+#include <algorithm> // for max, min
+#include <atomic>
+#include <cerrno> // for EINTR
 #include <chrono>
+#include <climits> // for INT64_MAX
+#include <condition_variable>
+#include <cstdlib> // for atexit
 #include <cstring> // for strerror
-#include <locale>
+#include <mutex>
+#include <thread>
 
 
 #define TAG "clock"
 
 
-char nowStrBuf[FORMATTIME_LEN + 1];
+thread_local char nowStrBuf[FORMATTIME_LEN + 1];
 
 
 #if IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
@@ -62,6 +69,16 @@ char nowStrBuf[FORMATTIME_LEN + 1];
 // if (::clock_getres(CLOCK_MONOTONIC, &res) == -1) {
 //
 
+int64_t uptimeNanos(void) {
+
+    timespec now; // NOLINT(*-pro-type-member-init)
+    if (::clock_gettime(CLOCK_MONOTONIC, &now) == -1) {
+        ABORT("clock_gettime: %s (%s)", std::strerror(errno), ErrorName(errno));
+    }
+
+    return (static_cast<int64_t>(now.tv_sec) * 1000000000) + static_cast<int64_t>(now.tv_nsec);
+}
+
 int64_t uptimeMillis(void) {
 
     timespec now; // NOLINT(*-pro-type-member-init)
@@ -102,6 +119,16 @@ int64_t timeSinceEpochMillis(void) {
     return (static_cast<int64_t>(now.tv_sec) * 1000) + (static_cast<int64_t>(now.tv_nsec) / 1000000);
 }
 
+int64_t timeSinceEpochMicros(void) {
+
+    timespec now; // NOLINT(*-pro-type-member-init)
+    if (::clock_gettime(CLOCK_REALTIME, &now) == -1) {
+        ABORT("clock_gettime: %s (%s)", std::strerror(errno), ErrorName(errno));
+    }
+
+    return (static_cast<int64_t>(now.tv_sec) * 1000000) + (static_cast<int64_t>(now.tv_nsec) / 1000);
+}
+
 #elif IS_PLATFORM_IOS || IS_PLATFORM_MACOS
 
 //
@@ -113,6 +140,10 @@ int64_t timeSinceEpochMillis(void) {
 // This API has the potential of being misused to access device signals to try to identify the device or user, also known as fingerprinting.
 //
 
+int64_t uptimeNanos(void) {
+    return static_cast<int64_t>(::clock_gettime_nsec_np(CLOCK_UPTIME_RAW));
+}
+
 int64_t uptimeMillis(void) {
     return static_cast<int64_t>(::clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / 1000 / 1000);
 }
@@ -129,11 +160,29 @@ int64_t timeSinceEpochMillis(void) {
     return static_cast<int64_t>(::clock_gettime_nsec_np(CLOCK_REALTIME) / 1000 / 1000);
 }
 
+int64_t timeSinceEpochMicros(void) {
+    return static_cast<int64_t>(::clock_gettime_nsec_np(CLOCK_REALTIME) / 1000);
+}
+
 #elif IS_PLATFORM_WINDOWS
 
+int64_t uptimeNanos(void) {
+
+    auto now = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+//
+// from the same steady_clock as uptimeNanos, so that uptimeMillis() == uptimeMicros() / 1000
+// GetTickCount64 has a different epoch and only about 15.6 ms resolution
+//
 int64_t uptimeMillis(void) {
+    return uptimeNanos() / 1000000;
+}
 
-    return GetTickCount64();
+int64_t uptimeMicros(void) {
+    return uptimeNanos() / 1000;
 }
 
 int64_t timeSinceEpochSeconds(void) {
@@ -154,11 +203,659 @@ int64_t timeSinceEpochMillis(void) {
     return epoch.count();
 }
 
+int64_t timeSinceEpochMicros(void) {
+
+    auto now = std::chrono::system_clock::now();
+
+    auto epoch = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+
+    return epoch.count();
+}
+
 #else
 #error Unsupported platform
 #endif // IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
 
 
+//
+// fast clock
+//
+// uptimeNanosFast converts a hardware counter to nanoseconds as:
+// baseNanos + (((cycles - baseCycles) * mult) >> 32)
+//
+// the parameters are published with a seqlock, so readers never block
+//
+// each recheck pairs the counter with uptimeNanos again and measures the rate over everything since the first
+// calibration
+// if the fast clock fell behind, it jumps forward, and if it got ahead, it runs slightly slow until caught up, so that
+// it never goes backwards
+//
+
+#if (__GNUC__ || __clang__) && (__x86_64__ || __aarch64__)
+
+__extension__ typedef unsigned __int128 FastClockU128; // NOLINT(*-use-using)
+
+//
+// length of the busy wait of the first calibration
+//
+constexpr int64_t FAST_CLOCK_CALIBRATE_NANOS = 1000000;
+
+//
+// rechecks start soon after the first calibration and back off to once a second
+//
+constexpr int64_t FAST_CLOCK_FIRST_RECHECK_NANOS = 10000000;
+constexpr int64_t FAST_CLOCK_MAX_RECHECK_NANOS = 1000000000;
+
+//
+// when ahead of uptimeNanos, the fast clock runs slow by 1 / FAST_CLOCK_SLEW_DIVISOR (500 ppm) until caught up
+//
+constexpr int64_t FAST_CLOCK_SLEW_DIVISOR = 2000;
+
+struct FastClock {
+
+    //
+    // odd while the parameters are being written
+    //
+    std::atomic<uint32_t> seq;
+
+    std::atomic<uint64_t> baseCycles;
+    std::atomic<int64_t> baseNanos;
+
+    //
+    // nanoseconds per cycle, 32.32 fixed point
+    //
+    std::atomic<uint64_t> mult;
+
+    //
+    // 0 before calibration and when the counter is not used, so that every read goes to the slow path
+    //
+    std::atomic<uint64_t> nextCheck;
+
+    std::atomic<bool> usesCycles;
+
+    std::once_flag calibrateOnce;
+
+    //
+    // protects the rest, and makes sure there is only one writer
+    //
+    std::mutex mutex;
+
+    //
+    // the sample of the first calibration
+    //
+    uint64_t firstCycles;
+    int64_t firstNanos;
+
+    int64_t recheckNanos;
+};
+
+static FastClock fastClock;
+
+static uint64_t ReadCounter() {
+#if __x86_64__
+    return __rdtsc();
+#else
+    uint64_t v; // NOLINT(*-init-variables)
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#endif // __x86_64__
+}
+
+static bool CounterIsUsable() {
+#if __x86_64__
+
+    //
+    // invariant TSC: constant rate in all P-, C-, and T-states
+    //
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+        return false;
+    }
+
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+
+    return (edx & (1u << 8)) != 0;
+#else
+
+    //
+    // the generic timer runs at a fixed frequency by definition
+    //
+    return true;
+#endif // __x86_64__
+}
+
+//
+// read the counter between two uptimeNanos calls, keep the tightest of a few tries, and pair it with the midpoint
+//
+static void FastClockSample(uint64_t *cycles, int64_t *nanos) {
+
+    int64_t best = INT64_MAX;
+
+    for (int i = 0; i < 5; i++) {
+
+        int64_t before = uptimeNanos();
+        uint64_t c = ReadCounter();
+        int64_t after = uptimeNanos();
+
+        if (after - before < best) {
+            best = after - before;
+            *cycles = c;
+            *nanos = before + ((after - before) / 2);
+        }
+    }
+}
+
+//
+// fastClock.mutex must be held
+//
+static void FastClockPublish(uint64_t baseCycles, int64_t baseNanos, uint64_t mult, uint64_t nextCheck) {
+
+    uint32_t seq = fastClock.seq.load(std::memory_order_relaxed);
+
+    fastClock.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    fastClock.baseCycles.store(baseCycles, std::memory_order_relaxed);
+    fastClock.baseNanos.store(baseNanos, std::memory_order_relaxed);
+    fastClock.mult.store(mult, std::memory_order_relaxed);
+    fastClock.nextCheck.store(nextCheck, std::memory_order_relaxed);
+
+    fastClock.seq.store(seq + 2, std::memory_order_release);
+}
+
+static uint64_t FastClockCyclesFor(int64_t nanos, uint64_t mult) {
+    return static_cast<uint64_t>((static_cast<FastClockU128>(nanos) << 32) / mult);
+}
+
+static void FastClockCalibrate() {
+
+    if (!CounterIsUsable()) {
+        return;
+    }
+
+    uint64_t c0 = 0;
+    int64_t n0 = 0;
+    FastClockSample(&c0, &n0);
+
+    while (uptimeNanos() - n0 < FAST_CLOCK_CALIBRATE_NANOS) {
+        // spin
+    }
+
+    uint64_t c1 = 0;
+    int64_t n1 = 0;
+    FastClockSample(&c1, &n1);
+
+    if (c1 <= c0) {
+        return;
+    }
+
+    uint64_t mult = static_cast<uint64_t>((static_cast<FastClockU128>(n1 - n0) << 32) / (c1 - c0));
+
+    //
+    // anything slower than 1 MHz is not worth it, and 0 means the counter did not move at a sensible rate
+    //
+    if (mult == 0 || mult > (static_cast<uint64_t>(1000) << 32)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(fastClock.mutex);
+
+    fastClock.firstCycles = c0;
+    fastClock.firstNanos = n0;
+    fastClock.recheckNanos = FAST_CLOCK_FIRST_RECHECK_NANOS;
+
+    FastClockPublish(c1, n1, mult, c1 + FastClockCyclesFor(fastClock.recheckNanos, mult));
+
+    fastClock.usesCycles.store(true, std::memory_order_release);
+}
+
+//
+// returns false if the slow path should be taken: not calibrated yet, not using the counter, or a recheck is due
+//
+static bool FastClockRead(int64_t *nanos) {
+
+    for (;;) {
+
+        uint32_t seq = fastClock.seq.load(std::memory_order_acquire);
+
+        uint64_t c = ReadCounter();
+
+        uint64_t baseCycles = fastClock.baseCycles.load(std::memory_order_relaxed);
+        int64_t baseNanos = fastClock.baseNanos.load(std::memory_order_relaxed);
+        uint64_t mult = fastClock.mult.load(std::memory_order_relaxed);
+        uint64_t nextCheck = fastClock.nextCheck.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if ((seq & 1) != 0 || fastClock.seq.load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+
+        //
+        // another CPU may be slightly behind the one that published
+        //
+        uint64_t delta = (c > baseCycles) ? c - baseCycles : 0;
+
+        *nanos = baseNanos + static_cast<int64_t>((static_cast<FastClockU128>(delta) * mult) >> 32);
+
+        return c < nextCheck;
+    }
+}
+
+//
+// fastClock.mutex must be held
+//
+static void FastClockRecheck() {
+
+    uint64_t c = 0;
+    int64_t n = 0;
+    FastClockSample(&c, &n);
+
+    uint64_t baseCycles = fastClock.baseCycles.load(std::memory_order_relaxed);
+    int64_t baseNanos = fastClock.baseNanos.load(std::memory_order_relaxed);
+    uint64_t mult = fastClock.mult.load(std::memory_order_relaxed);
+
+    if (c <= baseCycles || c <= fastClock.firstCycles) {
+        return;
+    }
+
+    int64_t current = baseNanos + static_cast<int64_t>((static_cast<FastClockU128>(c - baseCycles) * mult) >> 32);
+
+    //
+    // measured over everything since the first calibration, so it gets more accurate the longer the process runs
+    //
+    auto rate = static_cast<uint64_t>((static_cast<FastClockU128>(n - fastClock.firstNanos) << 32) / (c - fastClock.firstCycles));
+
+    if (rate == 0) {
+        return;
+    }
+
+    fastClock.recheckNanos = std::min(fastClock.recheckNanos * 2, FAST_CLOCK_MAX_RECHECK_NANOS);
+
+    if (n >= current) {
+
+        //
+        // behind: jump forward, which keeps it monotonic
+        //
+        FastClockPublish(c, n, rate, c + FastClockCyclesFor(fastClock.recheckNanos, rate));
+
+        return;
+    }
+
+    //
+    // ahead: run slow until caught up, then check again
+    //
+    // stepping back would break monotonic, and the next read may be much later than the next check, so the slew is
+    // small enough that overshooting only leaves it slightly behind
+    //
+    int64_t catchUpNanos = std::min((current - n) * FAST_CLOCK_SLEW_DIVISOR, fastClock.recheckNanos);
+
+    FastClockPublish(c, current, rate - (rate / FAST_CLOCK_SLEW_DIVISOR), c + FastClockCyclesFor(catchUpNanos, rate));
+}
+
+static int64_t FastClockSlow() {
+
+    if (!fastClock.usesCycles.load(std::memory_order_acquire)) {
+
+        std::call_once(fastClock.calibrateOnce, FastClockCalibrate);
+
+        if (!fastClock.usesCycles.load(std::memory_order_acquire)) {
+            return uptimeNanos();
+        }
+
+    } else {
+
+        //
+        // if another thread is already rechecking, just use the current parameters
+        //
+        std::unique_lock<std::mutex> lock(fastClock.mutex, std::try_to_lock);
+
+        if (lock.owns_lock()) {
+            FastClockRecheck();
+        }
+    }
+
+    int64_t nanos = 0;
+    FastClockRead(&nanos);
+
+    return nanos;
+}
+
+int64_t uptimeNanosFast(void) {
+
+    int64_t nanos = 0;
+
+    if (FastClockRead(&nanos)) {
+        return nanos;
+    }
+
+    return FastClockSlow();
+}
+
+uint64_t readCycles(void) {
+    return ReadCounter();
+}
+
+int fastClockUsesCycles(void) {
+
+    std::call_once(fastClock.calibrateOnce, FastClockCalibrate);
+
+    return fastClock.usesCycles.load(std::memory_order_acquire) ? 1 : 0;
+}
+
+#else
+
+int64_t uptimeNanosFast(void) {
+    return uptimeNanos();
+}
+
+uint64_t readCycles(void) {
+    return static_cast<uint64_t>(uptimeNanos());
+}
+
+int fastClockUsesCycles(void) {
+    return 0;
+}
+
+#endif // (__GNUC__ || __clang__) && (__x86_64__ || __aarch64__)
+
+
+//
+// coarse clock
+//
+
+#if IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
+
+static bool HasKernelCoarseClock() {
+    timespec res; // NOLINT(*-pro-type-member-init)
+    return ::clock_getres(CLOCK_MONOTONIC_COARSE, &res) == 0;
+}
+
+static bool KernelCoarseClockIsMillis() {
+
+    timespec res; // NOLINT(*-pro-type-member-init)
+    if (::clock_getres(CLOCK_MONOTONIC_COARSE, &res) == -1) {
+        return false;
+    }
+
+    return res.tv_sec == 0 && res.tv_nsec <= 1000000;
+}
+
+static int64_t KernelCoarseMillis() {
+
+    timespec now; // NOLINT(*-pro-type-member-init)
+    if (::clock_gettime(CLOCK_MONOTONIC_COARSE, &now) == -1) {
+        ABORT("clock_gettime: %s (%s)", std::strerror(errno), ErrorName(errno));
+    }
+
+    return (static_cast<int64_t>(now.tv_sec) * 1000) + (static_cast<int64_t>(now.tv_nsec) / 1000000);
+}
+
+#else
+
+static bool HasKernelCoarseClock() {
+    return false;
+}
+
+static bool KernelCoarseClockIsMillis() {
+    return false;
+}
+
+static int64_t KernelCoarseMillis() {
+    return uptimeMillis();
+}
+
+#endif // IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
+
+struct CoarseTicker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
+
+//
+// published by the ticker thread, -1 when it is not running
+//
+static std::atomic<int64_t> coarseMillis(-1);
+
+static std::atomic<int> coarseSource(COARSECLOCK_OFF);
+
+//
+// protects coarseTicker, and serializes StartCoarseClock and StopCoarseClock
+//
+static std::mutex coarseMutex;
+
+static CoarseTicker *coarseTicker = nullptr;
+
+static void CoarseTickerLoop(CoarseTicker *t) {
+
+    std::unique_lock<std::mutex> lock(t->mutex);
+
+    while (!t->stopping) {
+
+        coarseMillis.store(uptimeMillis(), std::memory_order_relaxed);
+
+        //
+        // wake just after the next millisecond starts
+        //
+        int64_t nanos = uptimeNanos();
+
+        t->cv.wait_for(lock, std::chrono::nanoseconds(1000000 - (nanos % 1000000)));
+    }
+}
+
+int64_t uptimeMillisCoarse(void) {
+
+    int64_t millis = coarseMillis.load(std::memory_order_relaxed);
+
+    if (millis >= 0) {
+        return millis;
+    }
+
+    if (coarseSource.load(std::memory_order_relaxed) == COARSECLOCK_KERNEL) {
+        return KernelCoarseMillis();
+    }
+
+    return uptimeMillis();
+}
+
+//
+// coarseMutex must be held
+//
+static void StopCoarseClockLocked() {
+
+    coarseSource.store(COARSECLOCK_OFF, std::memory_order_relaxed);
+
+    if (coarseTicker == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(coarseTicker->mutex);
+        coarseTicker->stopping = true;
+        coarseTicker->cv.notify_one();
+    }
+
+    coarseTicker->thread.join();
+
+    delete coarseTicker;
+    coarseTicker = nullptr;
+
+    //
+    // uptimeMillis is never behind what the ticker published
+    //
+    coarseMillis.store(-1, std::memory_order_relaxed);
+}
+
+void StartCoarseClock(int source) {
+
+    std::lock_guard<std::mutex> lock(coarseMutex);
+
+    StopCoarseClockLocked();
+
+    if (source == COARSECLOCK_OFF) {
+        return;
+    }
+
+    if (source == COARSECLOCK_AUTO) {
+        source = KernelCoarseClockIsMillis() ? COARSECLOCK_KERNEL : COARSECLOCK_TICKER;
+    }
+
+    if (source == COARSECLOCK_KERNEL && !HasKernelCoarseClock()) {
+        LOGW("CLOCK_MONOTONIC_COARSE is not available, using a ticker thread");
+        source = COARSECLOCK_TICKER;
+    }
+
+    if (source == COARSECLOCK_TICKER) {
+
+        coarseMillis.store(uptimeMillis(), std::memory_order_relaxed);
+
+        coarseTicker = new CoarseTicker();
+        coarseTicker->thread = std::thread(CoarseTickerLoop, coarseTicker);
+
+        static bool registeredAtExit = false;
+        if (!registeredAtExit) {
+            std::atexit(StopCoarseClock);
+            registeredAtExit = true;
+        }
+    }
+
+    coarseSource.store(source, std::memory_order_relaxed);
+}
+
+void StopCoarseClock(void) {
+
+    std::lock_guard<std::mutex> lock(coarseMutex);
+
+    StopCoarseClockLocked();
+}
+
+int GetCoarseClockSource(void) {
+    return coarseSource.load(std::memory_order_relaxed);
+}
+
+
+//
+// sleepUntilMicros
+//
+
+//
+// always spin at least this long, to cover the jitter in the wakeup latency
+//
+constexpr int64_t SLEEP_MIN_SPIN_MICROS = 50;
+
+//
+// never spin longer than this, however late the wakeups are
+//
+constexpr int64_t SLEEP_MAX_SPIN_MICROS = 2000;
+
+//
+// estimate of how late the scheduler wakes a sleeping thread, in 1/16 us
+//
+// moves half way toward a later wakeup but only 1/16 of the way toward an earlier one, so that a late wakeup is
+// not forgotten after a few good ones
+//
+// updated without synchronization, a lost update only makes the estimate a little stale
+//
+static std::atomic<int64_t> wakeupLatency16(100 * 16);
+
+static void CpuRelax() {
+#if (__GNUC__ || __clang__) && __x86_64__
+    _mm_pause();
+#elif (__GNUC__ || __clang__) && __aarch64__
+    __asm__ __volatile__("yield");
+#elif IS_PLATFORM_WINDOWS
+    YieldProcessor();
+#endif // (__GNUC__ || __clang__) && __x86_64__
+}
+
+#if IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
+
+//
+// uptimeMicros is CLOCK_MONOTONIC, so sleep on an absolute CLOCK_MONOTONIC time, which cannot drift like a relative
+// sleep computed from an earlier clock read
+//
+static void SleepUntil(int64_t targetMicros) {
+
+    timespec ts; // NOLINT(*-pro-type-member-init)
+    ts.tv_sec = static_cast<time_t>(targetMicros / 1000000);
+    ts.tv_nsec = static_cast<long>((targetMicros % 1000000) * 1000);
+
+    int err; // NOLINT(*-init-variables)
+    while ((err = ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) == EINTR) {
+        //
+        // interrupted by a signal, sleep the rest
+        //
+    }
+
+    if (err != 0) {
+        ABORT("clock_nanosleep: %s (%s)", std::strerror(err), ErrorName(err));
+    }
+}
+
+#else
+
+static void SleepUntil(int64_t targetMicros) {
+
+    int64_t now = uptimeMicros();
+
+    if (now < targetMicros) {
+        std::this_thread::sleep_for(std::chrono::microseconds(targetMicros - now));
+    }
+}
+
+#endif // IS_PLATFORM_ANDROID || IS_PLATFORM_LINUX
+
+int64_t sleepSpinMicros(void) {
+
+    int64_t latency = wakeupLatency16.load(std::memory_order_relaxed) / 16;
+
+    return std::clamp((2 * latency) + SLEEP_MIN_SPIN_MICROS, SLEEP_MIN_SPIN_MICROS, SLEEP_MAX_SPIN_MICROS);
+}
+
+int64_t sleepUntilMicros(int64_t deadlineMicros) {
+
+    int64_t now = uptimeMicros();
+
+    int64_t spin = sleepSpinMicros();
+
+    if (deadlineMicros - now > spin) {
+
+        int64_t target = deadlineMicros - spin;
+
+        SleepUntil(target);
+
+        now = uptimeMicros();
+
+        int64_t latency16 = std::max<int64_t>(now - target, 0) * 16;
+
+        int64_t estimate = wakeupLatency16.load(std::memory_order_relaxed);
+
+        if (latency16 > estimate) {
+            estimate += (latency16 - estimate) / 2;
+        } else {
+            estimate += (latency16 - estimate) / 16;
+        }
+
+        wakeupLatency16.store(estimate, std::memory_order_relaxed);
+    }
+
+    while (now < deadlineMicros) {
+        CpuRelax();
+        now = uptimeMicros();
+    }
+
+    return now;
+}
+
+
 //
 // compute the current time and store in nowStrBuf
 //
@@ -173,24 +870,182 @@ void GrabNow(void) {
 }
 
 
+//
+// round toward negative infinity, so that times before 1970 still have a fraction in [0, d)
+//
+static int64_t FloorDiv(int64_t n, int64_t d) {
+    return (n >= 0) ? (n / d) : (((n + 1) / d) - 1);
+}
+
+//
+// days since 1970-01-01 of a proleptic Gregorian date, and back
+//
+// http://howardhinnant.github.io/date_algorithms.html
+//
+static int64_t DaysFromCivil(int64_t y, int64_t m, int64_t d) {
+
+    y -= (m <= 2) ? 1 : 0;
+
+    int64_t era = FloorDiv(y, 400);
+    int64_t yoe = y - (era * 400);
+    int64_t doy = (((153 * ((m > 2) ? (m - 3) : (m + 9))) + 2) / 5) + d - 1;
+    int64_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+
+    return (era * 146097) + doe - 719468;
+}
+
+static void CivilFromDays(int64_t z, int64_t *y, int64_t *m, int64_t *d) {
+
+    z += 719468;
+
+    int64_t era = FloorDiv(z, 146097);
+    int64_t doe = z - (era * 146097);
+    int64_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+    int64_t doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+    int64_t mp = ((5 * doy) + 2) / 153;
+
+    *d = doy - (((153 * mp) + 2) / 5) + 1;
+    *m = (mp < 10) ? (mp + 3) : (mp - 9);
+    *y = yoe + (era * 400) + ((*m <= 2) ? 1 : 0);
+}
+
+//
+// the UTC offset is the same within each 15-minute block
+//
+constexpr int64_t UTC_OFFSET_BLOCK_SECONDS = 15 * 60;
+
+struct UtcOffsetCache {
+    int64_t block = INT64_MIN;
+    int64_t offset = 0;
+};
+
+//
+// seconds to add to t to get local time
+//
+static int64_t UtcOffset(int64_t t) {
+
+    static thread_local UtcOffsetCache cache;
+
+    int64_t block = FloorDiv(t, UTC_OFFSET_BLOCK_SECONDS);
+
+    if (block != cache.block) {
+
+        auto timeV = static_cast<time_t>(t);
+
+        tm local; // NOLINT(*-pro-type-member-init)
+#if IS_PLATFORM_WINDOWS
+        if (localtime_s(&local, &timeV) != 0) {
+            ABORT("localtime_s failed");
+        }
+#else
+        if (localtime_r(&timeV, &local) == nullptr) {
+            ABORT("localtime_r: %s (%s)", std::strerror(errno), ErrorName(errno));
+        }
+#endif // IS_PLATFORM_WINDOWS
+
+        int64_t localSeconds = (DaysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 86400) +
+            (local.tm_hour * 3600) + (local.tm_min * 60) + local.tm_sec;
+
+        cache.offset = localSeconds - t;
+        cache.block = block;
+    }
+
+    return cache.offset;
+}
+
+static char *PutDigits(char *p, int64_t v, int width) {
+
+    for (int i = width - 1; i >= 0; i--) {
+        p[i] = static_cast<char>('0' + (v % 10)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        v /= 10;
+    }
+
+    return p + width; // NOLINT(*-pro-bounds-pointer-arithmetic)
+}
+
+//
+// "2025-12-31 12:59:59" with separator between the date and the time, 19 characters, years 0 to 9999
+//
+static char *PutDateTime(char *p, int64_t localSeconds, char separator) {
+
+    int64_t days = FloorDiv(localSeconds, 86400);
+    int64_t secondOfDay = localSeconds - (days * 86400);
+
+    int64_t y = 0;
+    int64_t m = 0;
+    int64_t d = 0;
+    CivilFromDays(days, &y, &m, &d);
+
+    p = PutDigits(p, y, 4);
+    *p++ = '-'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, m, 2);
+    *p++ = '-'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, d, 2);
+    *p++ = separator; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, secondOfDay / 3600, 2);
+    *p++ = ':'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, (secondOfDay / 60) % 60, 2);
+    *p++ = ':'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, secondOfDay % 60, 2);
+
+    return p;
+}
+
 void formatTime(time_t timeV, char *buf, size_t len) {
 
-    tm *timeinfo; // NOLINT(*-init-variables)
-    if (timeinfo = std::localtime(&timeV); timeinfo == nullptr) {
-        ABORT("localtime: %s (%s)", std::strerror(errno), ErrorName(errno));
+    if (len < FORMATTIME_LEN + 1) {
+        ABORT("formatTime: buffer too small: %zu", len);
     }
 
-    std::locale oldLocale;
-    oldLocale = std::locale::global(std::locale::classic());
+    auto t = static_cast<int64_t>(timeV);
 
-    //
-    // "%F %X" is equivalent to "%Y-%m-%d %H:%M:%S"
-    //
-    if (std::strftime(buf, len, "%F %X", timeinfo) == 0) {
-        ABORT("strftime returned 0");
+    char *p = PutDateTime(buf, t + UtcOffset(t), ' ');
+    *p = '\0';
+}
+
+//
+// fraction has fractionDigits digits
+//
+static void FormatIso8601(int64_t t, int64_t fraction, int fractionDigits, char *buf) {
+
+    int64_t offset = UtcOffset(t);
+
+    char *p = PutDateTime(buf, t + offset, 'T');
+    *p++ = '.'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, fraction, fractionDigits);
+
+    int64_t offsetMinutes = offset / 60;
+
+    *p++ = (offsetMinutes < 0) ? '-' : '+'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    if (offsetMinutes < 0) {
+        offsetMinutes = -offsetMinutes;
     }
+    p = PutDigits(p, offsetMinutes / 60, 2);
+    *p++ = ':'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    p = PutDigits(p, offsetMinutes % 60, 2);
+    *p = '\0';
+}
+
+void formatTimeIso8601Millis(int64_t epochMillis, char *buf, size_t len) {
+
+    if (len < FORMATTIME_ISO8601_MILLIS_LEN + 1) {
+        ABORT("formatTimeIso8601Millis: buffer too small: %zu", len);
+    }
+
+    int64_t t = FloorDiv(epochMillis, 1000);
+
+    FormatIso8601(t, epochMillis - (t * 1000), 3, buf);
+}
+
+void formatTimeIso8601Micros(int64_t epochMicros, char *buf, size_t len) {
+
+    if (len < FORMATTIME_ISO8601_MICROS_LEN + 1) {
+        ABORT("formatTimeIso8601Micros: buffer too small: %zu", len);
+    }
+
+    int64_t t = FloorDiv(epochMicros, 1000000);
 
-    std::locale::global(oldLocale);
+    FormatIso8601(t, epochMicros - (t * 1000000), 6, buf);
 }
 
 
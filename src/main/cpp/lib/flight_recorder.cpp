@@ -0,0 +1,532 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/flight_recorder.h"
+
+#undef NDEBUG
+
+#include "common/check.h"
+#include "common/clock.h"
+#include "common/error.h"
+#include "common/log_site_info.h"
+#include "common/logging.h"
+#include "common/platform.h"
+#include "common/printf_args.h"
+
+#if IS_PLATFORM_WINDOWS
+#include <io.h> // for _write
+#else
+#include <csignal> // for sigaction, sigaltstack
+#include <unistd.h> // for write, STDERR_FILENO
+#endif // IS_PLATFORM_WINDOWS
+
+#include <algorithm>
+#include <atomic>
+#include <charconv> // for to_chars
+#include <memory>
+#include <cerrno>
+#include <cstring> // for memcpy, strerror, strlen
+
+
+#define TAG "flight_recorder"
+
+
+using enum Status;
+
+
+constexpr size_t FLIGHT_RECORDER_SLOT_SIZE = 256;
+
+//
+// argsLen of a record whose arguments did not fit, or whose site could not be parsed
+//
+constexpr uint32_t FLIGHT_RECORDER_NO_ARGS = UINT32_MAX;
+
+constexpr size_t FLIGHT_RECORDER_LINE_SIZE = 1024;
+
+
+//
+// seq is 2 * pos + 1 while the record for pos is being written, and 2 * pos + 2 once it is complete
+//
+// a writer claims the slot by moving seq forward from an even value, so two writers a lap apart never write the same
+// slot at once
+//
+struct FlightRecorderSlot {
+    std::atomic<uint64_t> seq;
+    const LogSite *site;
+    int64_t micros;
+    uint32_t thread;
+    uint32_t argsLen;
+    uint8_t args[FLIGHT_RECORDER_SLOT_SIZE - 32];
+};
+
+static_assert(sizeof(FlightRecorderSlot) == FLIGHT_RECORDER_SLOT_SIZE);
+
+struct FlightRecorder {
+    std::unique_ptr<FlightRecorderSlot[]> slots;
+    uint64_t mask;
+
+    alignas(64) std::atomic<uint64_t> writePos;
+};
+
+
+//
+// never freed, so that writers and crash dumps never see a dangling pointer
+//
+static std::atomic<FlightRecorder *> flightRecorder = nullptr;
+
+static std::atomic<bool> flightRecording = false;
+
+static std::atomic<bool> dumpedOnCrash = false;
+
+#if IS_PLATFORM_WINDOWS
+static std::atomic<int> flightRecorderFd = 2;
+#else
+static std::atomic<int> flightRecorderFd = STDERR_FILENO;
+#endif // IS_PLATFORM_WINDOWS
+
+static void WriteAll(int fd, const char *buf, size_t len) {
+
+    while (len > 0) {
+
+#if IS_PLATFORM_WINDOWS
+        int written = ::_write(fd, buf, static_cast<unsigned int>(len));
+#else
+        ssize_t written = ::write(fd, buf, len);
+#endif // IS_PLATFORM_WINDOWS
+
+        if (written < 0) {
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            //
+            // nowhere to report the error
+            //
+            return;
+        }
+
+        buf += written;
+        len -= static_cast<size_t>(written);
+    }
+}
+
+static char LevelChar(int level) {
+    switch (level) {
+        case LOGLEVEL_FATAL:
+            return 'F';
+        case LOGLEVEL_ERROR:
+            return 'E';
+        case LOGLEVEL_WARN:
+            return 'W';
+        case LOGLEVEL_INFO:
+            return 'I';
+        case LOGLEVEL_DEBUG:
+            return 'D';
+        default:
+            return 'T';
+    }
+}
+
+
+Status StartFlightRecorder(size_t capacity) {
+
+    RETURN_ERR_IF_TRUE(capacity == 0, "capacity must be positive");
+
+    if (flightRecorder.load(std::memory_order_acquire) == nullptr) {
+
+        //
+        // round up to power of 2
+        //
+        size_t actualCapacity = 1;
+        while (actualCapacity < capacity) {
+            actualCapacity <<= 1;
+        }
+
+        auto *r = new FlightRecorder();
+
+        r->slots = std::make_unique<FlightRecorderSlot[]>(actualCapacity);
+        r->mask = actualCapacity - 1;
+
+        FlightRecorder *expected = nullptr;
+        if (!flightRecorder.compare_exchange_strong(expected, r, std::memory_order_acq_rel)) {
+            delete r;
+        }
+    }
+
+    dumpedOnCrash.store(false, std::memory_order_relaxed);
+
+    flightRecording.store(true, std::memory_order_release);
+
+    RecomputeLogSiteStates();
+
+    return OK;
+}
+
+void StopFlightRecorder() {
+
+    flightRecording.store(false, std::memory_order_release);
+
+    RecomputeLogSiteStates();
+}
+
+bool IsFlightRecording() {
+    return flightRecording.load(std::memory_order_acquire);
+}
+
+void SetFlightRecorderFd(int fd) {
+    flightRecorderFd.store(fd, std::memory_order_relaxed);
+}
+
+
+void FlightRecorderWriteV(LogSite *site, va_list args) {
+
+    FlightRecorder *r = flightRecorder.load(std::memory_order_acquire);
+
+    if (r == nullptr) {
+        return;
+    }
+
+    const LogSiteInfo *info = GetLogSiteInfo(site);
+
+    uint64_t pos = r->writePos.fetch_add(1, std::memory_order_relaxed);
+
+    FlightRecorderSlot &slot = r->slots[pos & r->mask];
+
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+
+    do {
+
+        //
+        // a writer from an earlier lap is still writing, or a writer from a later lap already claimed the slot
+        //
+        // this record is dropped rather than waiting, because the writer may be interrupted by a signal handler that
+        // logs
+        //
+        if ((seq % 2) != 0 || seq > (2 * pos)) {
+            return;
+        }
+
+    } while (!slot.seq.compare_exchange_weak(seq, (2 * pos) + 1, std::memory_order_acquire, std::memory_order_acquire));
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.site = site;
+    slot.micros = uptimeMicros();
+    slot.thread = LogThreadNumber();
+
+    if (info == nullptr) {
+
+        slot.argsLen = FLIGHT_RECORDER_NO_ARGS;
+
+    } else {
+
+        bool overflow; // NOLINT(*-init-variables)
+        size_t len = EncodePrintfArgs(info->specs, info->specCount, args, slot.args, sizeof(slot.args), &overflow);
+
+        slot.argsLen = overflow ? FLIGHT_RECORDER_NO_ARGS : static_cast<uint32_t>(len);
+    }
+
+    slot.seq.store((2 * pos) + 2, std::memory_order_release);
+}
+
+
+//
+// append text to line, truncating so that there is always room for the trailing newline
+//
+static size_t Append(char *line, size_t len, const char *text, size_t n) {
+
+    n = std::min(n, FLIGHT_RECORDER_LINE_SIZE - len - 1);
+
+    std::memcpy(line + len, text, n);
+
+    return len + n;
+}
+
+//
+// format one record into line and return its length, including the trailing newline
+//
+// only to_chars, memcpy, and strlen, so that it can be called from a signal handler
+//
+static size_t FormatRecord(const LogSite *site, int64_t micros, uint32_t thread, const uint8_t *args, uint32_t argsLen, char *line) {
+
+    //
+    // seconds.micros T<thread> <level>/<tag>:
+    //
+    char prefix[64];
+    char *p = std::to_chars(prefix, prefix + 24, micros / 1000000).ptr;
+
+    *p++ = '.';
+    int64_t frac = micros % 1000000;
+    for (int64_t div = 100000; div > 0; div /= 10) {
+        *p++ = static_cast<char>('0' + ((frac / div) % 10));
+    }
+
+    *p++ = ' ';
+    *p++ = 'T';
+    p = std::to_chars(p, prefix + sizeof(prefix), thread).ptr;
+
+    *p++ = ' ';
+    *p++ = LevelChar(site->level);
+    *p++ = '/';
+
+    size_t len = Append(line, 0, prefix, static_cast<size_t>(p - prefix));
+    len = Append(line, len, site->tag, std::strlen(site->tag));
+    len = Append(line, len, ": ", 2);
+
+    const LogSiteInfo *info = GetLogSiteInfo(site);
+
+    if (argsLen != FLIGHT_RECORDER_NO_ARGS && info != nullptr) {
+
+        size_t n = FormatEncodedPrintfArgsSignalSafe(site->fmt, info->specs, info->specCount, args, argsLen, line + len, FLIGHT_RECORDER_LINE_SIZE - len);
+        len += std::min(n, FLIGHT_RECORDER_LINE_SIZE - len - 1);
+
+    } else {
+
+        static const char NOT_RECORDED[] = "(arguments not recorded) ";
+
+        len = Append(line, len, NOT_RECORDED, sizeof(NOT_RECORDED) - 1);
+        len = Append(line, len, site->fmt, std::strlen(site->fmt));
+    }
+
+    //
+    // the format may or may not end with a newline, depending on platform
+    //
+    if (line[len - 1] != '\n') {
+        if (len == FLIGHT_RECORDER_LINE_SIZE - 1) {
+            len--;
+        }
+        line[len] = '\n';
+        len++;
+    }
+
+    return len;
+}
+
+void DumpFlightRecorder(int fd) {
+
+    FlightRecorder *r = flightRecorder.load(std::memory_order_acquire);
+
+    if (r == nullptr) {
+        return;
+    }
+
+    static const char BEGIN[] = "--- flight recorder begin ---\n";
+    static const char END[] = "--- flight recorder end ---\n";
+
+    WriteAll(fd, BEGIN, sizeof(BEGIN) - 1);
+
+    uint64_t end = r->writePos.load(std::memory_order_acquire);
+    uint64_t begin = (end > r->mask + 1) ? end - (r->mask + 1) : 0;
+
+    char line[FLIGHT_RECORDER_LINE_SIZE];
+    uint8_t args[sizeof(FlightRecorderSlot::args)];
+
+    for (uint64_t pos = begin; pos < end; pos++) {
+
+        FlightRecorderSlot &slot = r->slots[pos & r->mask];
+
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+
+        if (seq != (2 * pos) + 2) {
+
+            //
+            // still being written, or already overwritten
+            //
+            continue;
+        }
+
+        const LogSite *site = slot.site;
+        int64_t micros = slot.micros;
+        uint32_t thread = slot.thread;
+        uint32_t argsLen = slot.argsLen;
+
+        if (argsLen != FLIGHT_RECORDER_NO_ARGS) {
+            std::memcpy(args, slot.args, argsLen);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (slot.seq.load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+
+        size_t len = FormatRecord(site, micros, thread, args, argsLen, line);
+
+        WriteAll(fd, line, len);
+    }
+
+    WriteAll(fd, END, sizeof(END) - 1);
+}
+
+void DumpFlightRecorderOnCrash() {
+
+    if (flightRecorder.load(std::memory_order_acquire) == nullptr) {
+        return;
+    }
+
+    if (dumpedOnCrash.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    DumpFlightRecorder(flightRecorderFd.load(std::memory_order_relaxed));
+}
+
+
+#if IS_PLATFORM_WINDOWS
+
+void InstallFlightRecorderSignalHandlers() {
+    LOGW("flight recorder signal handlers are not supported on Windows");
+}
+
+#else
+
+constexpr int FLIGHT_RECORDER_SIGNALS[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+constexpr size_t FLIGHT_RECORDER_SIGNAL_COUNT = sizeof(FLIGHT_RECORDER_SIGNALS) / sizeof(FLIGHT_RECORDER_SIGNALS[0]);
+
+//
+// the actions that were installed before ours, in the order of FLIGHT_RECORDER_SIGNALS
+//
+static struct sigaction previousActions[FLIGHT_RECORDER_SIGNAL_COUNT];
+
+//
+// the handler needs a stack of its own to dump after a stack overflow
+//
+// never freed, since a signal may arrive at any time
+//
+static char *alternateStack = nullptr;
+
+static void FlightRecorderSignalHandler(int sig, siginfo_t *info, void *ucontext) {
+
+    DumpFlightRecorderOnCrash();
+
+    size_t i = 0;
+    while (i < FLIGHT_RECORDER_SIGNAL_COUNT && FLIGHT_RECORDER_SIGNALS[i] != sig) {
+        i++;
+    }
+
+    if (i == FLIGHT_RECORDER_SIGNAL_COUNT) {
+        return;
+    }
+
+    const struct sigaction &previous = previousActions[i];
+
+    //
+    // put back whatever was there before, so that a second signal, or the re-raise below, goes to it
+    //
+    sigaction(sig, &previous, nullptr);
+
+    if ((previous.sa_flags & SA_SIGINFO) != 0) {
+
+        previous.sa_sigaction(sig, info, ucontext);
+
+    } else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) { // NOLINT(*-cstyle-cast, *-pro-type-cstyle-cast)
+
+        previous.sa_handler(sig);
+
+    } else {
+
+        //
+        // the signal is blocked while this handler runs, so this is delivered with the previous action on return
+        //
+        std::raise(sig);
+    }
+}
+
+//
+// install an alternate signal stack for the calling thread, unless it already has one
+//
+static void InstallAlternateStack() {
+
+    stack_t current = {};
+
+    if (sigaltstack(nullptr, &current) != 0) {
+        LOGE("cannot get alternate signal stack: %s (%s)", std::strerror(errno), ErrorName(errno));
+        return;
+    }
+
+    if ((current.ss_flags & SS_DISABLE) == 0) {
+        return;
+    }
+
+    //
+    // SIGSTKSZ is not a constant on newer glibc
+    //
+    size_t size = std::max<size_t>(static_cast<size_t>(SIGSTKSZ), 64 * 1024);
+
+    if (alternateStack == nullptr) {
+        alternateStack = new char[size];
+    }
+
+    stack_t stack = {};
+    stack.ss_sp = alternateStack;
+    stack.ss_size = size;
+    stack.ss_flags = 0;
+
+    if (sigaltstack(&stack, nullptr) != 0) {
+        LOGE("cannot install alternate signal stack: %s (%s)", std::strerror(errno), ErrorName(errno));
+    }
+}
+
+void InstallFlightRecorderSignalHandlers() {
+
+    InstallAlternateStack();
+
+    struct sigaction action = {};
+
+    action.sa_sigaction = FlightRecorderSignalHandler;
+    action.sa_flags = static_cast<int>(SA_SIGINFO | SA_ONSTACK);
+    sigemptyset(&action.sa_mask);
+
+    for (size_t i = 0; i < FLIGHT_RECORDER_SIGNAL_COUNT; i++) {
+
+        int sig = FLIGHT_RECORDER_SIGNALS[i];
+
+        struct sigaction previous = {};
+
+        if (sigaction(sig, &action, &previous) != 0) {
+            LOGE("cannot install flight recorder handler for signal %d", sig);
+            continue;
+        }
+
+        //
+        // installing twice must not make the handler chain to itself
+        //
+        if ((previous.sa_flags & SA_SIGINFO) == 0 || previous.sa_sigaction != FlightRecorderSignalHandler) {
+            previousActions[i] = previous;
+        }
+    }
+}
+
+#endif // IS_PLATFORM_WINDOWS
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,417 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/log_file_sink.h"
+
+#undef NDEBUG
+
+#include "common/check.h"
+#include "common/error.h"
+#include "common/file.h"
+#include "common/logging.h"
+#include "common/platform.h"
+
+#if !IS_PLATFORM_ANDROID && !IS_PLATFORM_WINDOWS
+#include <fcntl.h> // for open, fallocate
+#include <sys/mman.h> // for mmap
+#include <unistd.h> // for ftruncate
+#endif // !IS_PLATFORM_ANDROID && !IS_PLATFORM_WINDOWS
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cerrno>
+#include <cinttypes> // for PRIu64
+#include <cstdio> // for fwrite, snprintf
+#include <cstring> // for memcpy, strerror, strncmp
+
+
+#define TAG "log_file_sink"
+
+
+using enum Status;
+
+
+#if IS_PLATFORM_ANDROID || IS_PLATFORM_WINDOWS
+
+Status StartFileLogging(const char *dir, size_t segmentSize, size_t segmentCount) {
+    (void)dir;
+    (void)segmentSize;
+    (void)segmentCount;
+    LOGE("file logging is not supported on " PLATFORM_STRING);
+    return ERR;
+}
+
+void StopFileLogging() {}
+
+#else
+
+struct LogFileSegment {
+    char *base;
+    size_t size;
+    int fd;
+    uint64_t index;
+
+    //
+    // writers reserve [offset, offset + len) with fetch_add, so offset may go past size
+    //
+    std::atomic<size_t> offset;
+
+    //
+    // bytes actually written, once a reservation has gone past size
+    //
+    // set by the one writer whose reservation starts at or before size and ends after it
+    //
+    std::atomic<size_t> end;
+
+    //
+    // number of threads that may be copying into base
+    //
+    std::atomic<int> writers;
+};
+
+
+//
+// serializes StartFileLogging, StopFileLogging, rotation, and flushing
+//
+static std::mutex fileSinkMutex;
+
+//
+// nullptr when not running, or when the next segment could not be created
+//
+static std::atomic<LogFileSegment *> currentSegment = nullptr;
+
+static std::string fileSinkDir;
+static size_t fileSinkSegmentSize;
+static size_t fileSinkSegmentCount;
+static uint64_t fileSinkNextIndex;
+
+//
+// set while a thread is inside FileSinkWrite
+//
+// logging from inside the sink (for example, createDirectory failing during rotation) goes straight to stderr
+//
+static thread_local bool inFileSink = false;
+
+
+static std::string SegmentPath(uint64_t index) {
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "log-%08" PRIu64 ".txt", index);
+
+    return (std::filesystem::path(fileSinkDir) / name).string();
+}
+
+//
+// return 1 + the highest index of segments already in dir, or 0 if none
+//
+static uint64_t FirstUnusedIndex(const char *dir) {
+
+    uint64_t next = 0;
+
+    std::error_code ec;
+
+    for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+
+        std::string name = entry.path().filename().string();
+
+        unsigned long long index; // NOLINT(*-init-variables)
+        char rest[8];
+
+        if (std::sscanf(name.c_str(), "log-%8llu%7s", &index, rest) == 2 && std::strncmp(rest, ".txt", sizeof(rest)) == 0) {
+            if (index + 1 > next) {
+                next = index + 1;
+            }
+        }
+    }
+
+    return next;
+}
+
+//
+// fileSinkMutex must be held
+//
+static LogFileSegment *OpenSegment(uint64_t index) {
+
+    std::string path = SegmentPath(index);
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); // NOLINT(*-vararg)
+
+    if (fd < 0) {
+        LOGE("cannot open %s: %s (%s)", path.c_str(), std::strerror(errno), ErrorName(errno));
+        return nullptr;
+    }
+
+    //
+    // reserve the blocks now so that a full disk shows up here and not as SIGBUS in the middle of a memcpy
+    //
+#if IS_PLATFORM_LINUX
+    int res = ::fallocate(fd, 0, 0, static_cast<off_t>(fileSinkSegmentSize));
+#else
+    int res = ::ftruncate(fd, static_cast<off_t>(fileSinkSegmentSize));
+#endif // IS_PLATFORM_LINUX
+
+    if (res != 0) {
+        LOGE("cannot allocate %s: %s (%s)", path.c_str(), std::strerror(errno), ErrorName(errno));
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *base = ::mmap(nullptr, fileSinkSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (base == MAP_FAILED) { // NOLINT(*-cstyle-cast, *-pro-type-cstyle-cast)
+        LOGE("cannot map %s: %s (%s)", path.c_str(), std::strerror(errno), ErrorName(errno));
+        ::close(fd);
+        return nullptr;
+    }
+
+    auto *seg = new LogFileSegment();
+
+    seg->base = static_cast<char *>(base);
+    seg->size = fileSinkSegmentSize;
+    seg->fd = fd;
+    seg->index = index;
+
+    //
+    // keep at most fileSinkSegmentCount segments, including this one
+    //
+    if (index >= fileSinkSegmentCount) {
+        (void)deleteFileIfPresent(SegmentPath(index - fileSinkSegmentCount).c_str());
+    }
+
+    return seg;
+}
+
+//
+// seg must no longer be currentSegment
+//
+// unmaps and closes seg, but does not free it
+//
+static void CloseSegment(LogFileSegment *seg) {
+
+    //
+    // wait for threads that reserved space before seg was replaced
+    //
+    while (seg->writers.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+
+    size_t used = seg->offset.load(std::memory_order_relaxed);
+    if (used > seg->size) {
+        used = seg->end.load(std::memory_order_relaxed);
+    }
+
+    ::munmap(seg->base, seg->size);
+
+    if (::ftruncate(seg->fd, static_cast<off_t>(used)) != 0) {
+        LOGE("cannot truncate segment %" PRIu64 ": %s (%s)", seg->index, std::strerror(errno), ErrorName(errno));
+    }
+
+    ::close(seg->fd);
+
+    //
+    // seg itself is never freed: a writer may have loaded seg just before it was replaced, and will still
+    // increment and decrement seg->writers before it sees that seg is no longer current
+    // freeing it would make that a use-after-free, and reusing its address would let the writer's check pass
+    // against a different segment
+    //
+    // this leaks one small header per rotation, and its fields are left as they are, because a stale writer may
+    // still read seg->size
+    //
+}
+
+static void RotateSegment(LogFileSegment *full) {
+
+    std::lock_guard<std::mutex> lock(fileSinkMutex);
+
+    if (currentSegment.load() != full) {
+
+        //
+        // another thread already rotated, or logging was stopped
+        //
+        return;
+    }
+
+    LogFileSegment *next = OpenSegment(fileSinkNextIndex);
+    fileSinkNextIndex++;
+
+    currentSegment.store(next);
+
+    CloseSegment(full);
+}
+
+static void FileSinkWrite(void *context, int level, const char *tag, const char *buf, size_t len) {
+
+    (void)context;
+    (void)level;
+    (void)tag;
+
+    if (inFileSink) {
+        std::fwrite(buf, 1, len, stderr);
+        return;
+    }
+
+    inFileSink = true;
+
+    //
+    // errors logged while rotating are formatted into the same thread-local buffer that buf may point into, so buf
+    // is copied before the first rotation
+    //
+    std::string saved;
+
+    for (;;) {
+
+        LogFileSegment *seg = currentSegment.load();
+
+        if (seg == nullptr || len > seg->size) {
+            std::fwrite(buf, 1, len, stderr);
+            break;
+        }
+
+        //
+        // announce the write before checking that seg is still current, so that CloseSegment either sees the
+        // announcement or this thread sees the new segment
+        //
+        seg->writers.fetch_add(1);
+
+        if (currentSegment.load() != seg) {
+            seg->writers.fetch_sub(1, std::memory_order_release);
+            continue;
+        }
+
+        size_t offset = seg->offset.fetch_add(len, std::memory_order_relaxed);
+
+        if (offset + len <= seg->size) {
+            std::memcpy(seg->base + offset, buf, len);
+            seg->writers.fetch_sub(1, std::memory_order_release);
+            break;
+        }
+
+        if (offset <= seg->size) {
+
+            //
+            // the first reservation past size, so everything before it was written
+            //
+            seg->end.store(offset, std::memory_order_relaxed);
+        }
+
+        seg->writers.fetch_sub(1, std::memory_order_release);
+
+        if (saved.empty()) {
+            saved.assign(buf, len);
+            buf = saved.data();
+        }
+
+        RotateSegment(seg);
+    }
+
+    inFileSink = false;
+}
+
+static void FileSinkFlush(void *context) {
+
+    (void)context;
+
+    std::lock_guard<std::mutex> lock(fileSinkMutex);
+
+    LogFileSegment *seg = currentSegment.load();
+
+    if (seg == nullptr) {
+        return;
+    }
+
+    ::msync(seg->base, seg->size, MS_ASYNC);
+}
+
+static const LogSink fileSink = { FileSinkWrite, FileSinkFlush, nullptr };
+
+
+Status StartFileLogging(const char *dir, size_t segmentSize, size_t segmentCount) {
+
+    RETURN_ERR_IF_TRUE(segmentSize == 0, "segmentSize must be positive");
+    RETURN_ERR_IF_TRUE(segmentCount == 0, "segmentCount must be positive");
+
+    {
+        std::lock_guard<std::mutex> lock(fileSinkMutex);
+
+        RETURN_ERR_IF_TRUE(currentSegment.load() != nullptr, "file logging already started");
+
+        RETURN_ERR_IF_FALSE(createDirectory(dir) == OK, "cannot create log directory %s", dir);
+
+        fileSinkDir = dir;
+        fileSinkSegmentSize = segmentSize;
+        fileSinkSegmentCount = segmentCount;
+        fileSinkNextIndex = FirstUnusedIndex(dir);
+
+        LogFileSegment *seg = OpenSegment(fileSinkNextIndex);
+
+        RETURN_ERR_IF_FALSE(seg, "cannot create first log segment in %s", dir);
+
+        fileSinkNextIndex++;
+
+        currentSegment.store(seg);
+    }
+
+    //
+    // everything logged before this point stays where it was going
+    //
+    FlushLogs();
+
+    SetLogSink(&fileSink);
+
+    return OK;
+}
+
+void StopFileLogging() {
+
+    //
+    // messages still in the async ring belong in the file
+    //
+    FlushLogs();
+
+    if (GetLogSink() == &fileSink) {
+        SetLogSink(nullptr);
+    }
+
+    std::lock_guard<std::mutex> lock(fileSinkMutex);
+
+    LogFileSegment *seg = currentSegment.exchange(nullptr);
+
+    if (seg != nullptr) {
+        CloseSegment(seg);
+    }
+}
+
+#endif // IS_PLATFORM_ANDROID || IS_PLATFORM_WINDOWS
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
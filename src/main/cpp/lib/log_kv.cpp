@@ -0,0 +1,147 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/log_kv.h"
+
+#include "common/platform.h"
+
+
+#define TAG "log_kv"
+
+
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+
+char *LogKvBuffer() {
+
+    static thread_local char buf[LOG_KV_BUFFER_SIZE];
+
+    return buf;
+}
+
+
+static const char *LevelName(int level) {
+    switch (level) {
+        case LOGLEVEL_FATAL: return "F";
+        case LOGLEVEL_ERROR: return "E";
+        case LOGLEVEL_WARN: return "W";
+        case LOGLEVEL_INFO: return "I";
+        case LOGLEVEL_DEBUG: return "D";
+        default: return "T";
+    }
+}
+
+
+void LogKvWriter::putString(std::string_view s) {
+
+    put('"');
+
+    //
+    // copy runs of characters that do not need escaping in one go
+    //
+    size_t start = 0;
+
+    for (size_t i = 0; i < s.size(); i++) {
+
+        auto c = static_cast<unsigned char>(s[i]);
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        putRaw(s.data() + start, i - start); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        switch (c) {
+            case '"': putRaw("\\\"", 2); break;
+            case '\\': putRaw("\\\\", 2); break;
+            case '\n': putRaw("\\n", 2); break;
+            case '\r': putRaw("\\r", 2); break;
+            case '\t': putRaw("\\t", 2); break;
+            default: {
+                char u[6] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf] };
+                putRaw(u, sizeof(u));
+                break;
+            }
+        }
+
+        start = i + 1;
+    }
+
+    putRaw(s.data() + start, s.size() - start); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+    put('"');
+}
+
+void LogKvWriter::begin(int level, const char *tag, const char *msg) {
+
+    putRaw("{\"level\":\"", 10);
+    putRaw(LevelName(level), 1);
+    putRaw("\",\"tag\":", 8);
+    putString(tag);
+    putRaw(",\"msg\":", 7);
+    putString(msg);
+
+    if (overflow) {
+
+        //
+        // only possible with a huge tag or msg, so just end the record after the level
+        //
+        pos = buf + 12; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        overflow = false;
+        truncated = true;
+    }
+}
+
+size_t LogKvWriter::finish() {
+
+    //
+    // RESERVE is always left for this
+    //
+    if (truncated) {
+        std::memcpy(pos, ",\"truncated\":true", 17);
+        pos += 17; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    *pos++ = '}'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+#if !IS_PLATFORM_ANDROID
+    //
+    // same as the "\n" that the LOG* macros append to fmt
+    //
+    *pos++ = '\n'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+#endif // !IS_PLATFORM_ANDROID
+
+    *pos = '\0';
+
+    return static_cast<size_t>(pos - buf);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
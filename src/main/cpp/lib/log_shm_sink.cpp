@@ -0,0 +1,536 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/log_shm_sink.h"
+
+#undef NDEBUG
+
+#include "common/check.h"
+#include "common/clock.h"
+#include "common/error.h"
+#include "common/logging.h"
+#include "common/platform.h"
+
+#if !IS_PLATFORM_ANDROID && !IS_PLATFORM_WINDOWS
+#include <fcntl.h> // for O_CREAT
+#include <sys/mman.h> // for shm_open, mmap
+#include <sys/stat.h> // for fstat
+#include <unistd.h> // for ftruncate, getpid
+#endif // !IS_PLATFORM_ANDROID && !IS_PLATFORM_WINDOWS
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cerrno>
+#include <cstdio> // for fwrite
+#include <cstring> // for memcpy, strerror
+
+
+#define TAG "log_shm_sink"
+
+
+using enum Status;
+
+
+#if IS_PLATFORM_ANDROID || IS_PLATFORM_WINDOWS
+
+Status StartSharedMemoryLogging(const char *name, size_t capacity) {
+    (void)name;
+    (void)capacity;
+    LOGE("shared-memory logging is not supported on " PLATFORM_STRING);
+    return ERR;
+}
+
+void StopSharedMemoryLogging() {}
+
+Status RemoveSharedMemoryLog(const char *name) {
+    (void)name;
+    LOGE("shared-memory logging is not supported on " PLATFORM_STRING);
+    return ERR;
+}
+
+SharedMemoryLogReader::SharedMemoryLogReader() :
+    base(nullptr),
+    size(0),
+    nextPos(0),
+    stalledPos(UINT64_MAX),
+    stalledSinceMillis(0) {}
+
+SharedMemoryLogReader::~SharedMemoryLogReader() {}
+
+Status SharedMemoryLogReader::open(const char *name) {
+    (void)name;
+    LOGE("shared-memory logging is not supported on " PLATFORM_STRING);
+    return ERR;
+}
+
+uint64_t SharedMemoryLogReader::poll(const std::function<void(const SharedMemoryLogRecord &)> &f, bool skipIncomplete) {
+    (void)f;
+    (void)skipIncomplete;
+    return 0;
+}
+
+#else
+
+constexpr uint32_t LOG_SHM_MAGIC = 0x474f4c43; // "CLOG"
+constexpr uint32_t LOG_SHM_VERSION = 1;
+
+constexpr size_t LOG_SHM_SLOT_SIZE = 512;
+
+
+//
+// the layout is shared with readers in other processes, so only fixed-size types
+//
+struct LogShmSlot {
+    std::atomic<uint64_t> seq;
+    int64_t uptimeMicros;
+    int32_t level;
+    uint32_t pid;
+    uint32_t thread;
+    uint16_t textLen;
+    uint8_t tagLen;
+    uint8_t truncated;
+    char tag[LOG_SHM_TAG_SIZE];
+    char text[LOG_SHM_TEXT_SIZE];
+    uint8_t reserved[LOG_SHM_SLOT_SIZE - 32 - LOG_SHM_TAG_SIZE - LOG_SHM_TEXT_SIZE];
+};
+
+static_assert(sizeof(LogShmSlot) == LOG_SHM_SLOT_SIZE);
+
+//
+// magic is written last, so that a reader never sees a half-initialized header
+//
+struct LogShmHeader {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint32_t reserved;
+    uint64_t slotCount;
+    int64_t createdEpochMillis;
+    int64_t createdUptimeMicros;
+
+    alignas(64) std::atomic<uint64_t> writePos;
+};
+
+static_assert(sizeof(LogShmHeader) == 128);
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring is shared between processes");
+
+
+static LogShmSlot *SlotsOf(LogShmHeader *h) {
+    return reinterpret_cast<LogShmSlot *>(h + 1); // NOLINT(*-reinterpret-cast, *-pro-bounds-pointer-arithmetic)
+}
+
+static size_t MappingSize(uint64_t slotCount) {
+    return sizeof(LogShmHeader) + (static_cast<size_t>(slotCount) * sizeof(LogShmSlot));
+}
+
+
+//
+// serializes StartSharedMemoryLogging and StopSharedMemoryLogging
+//
+static std::mutex shmSinkMutex;
+
+static std::atomic<LogShmHeader *> shmRing = nullptr;
+
+static size_t shmRingSize;
+
+static uint32_t shmPid;
+
+//
+// number of threads inside ShmSinkWrite
+//
+// incremented before shmRing is loaded, so that StopSharedMemoryLogging either sees the increment or the writer sees
+// nullptr
+//
+static std::atomic<int> shmWriters = 0;
+
+
+static void ShmSinkWrite(void *context, int level, const char *tag, const char *buf, size_t len) {
+
+    (void)context;
+
+    shmWriters.fetch_add(1);
+
+    LogShmHeader *h = shmRing.load();
+
+    if (h == nullptr) {
+        shmWriters.fetch_sub(1, std::memory_order_release);
+        std::fwrite(buf, 1, len, stderr);
+        return;
+    }
+
+    //
+    // the reader adds its own newline
+    //
+    if (len > 0 && buf[len - 1] == '\n') { // NOLINT(*-pro-bounds-pointer-arithmetic)
+        len--;
+    }
+
+    size_t tagLen = strnlen(tag, LOG_SHM_TAG_SIZE);
+
+    uint64_t pos = h->writePos.fetch_add(1, std::memory_order_relaxed);
+
+    LogShmSlot &slot = SlotsOf(h)[pos & (h->slotCount - 1)]; // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+    //
+    // claim the slot by moving seq forward from an even value, as in the flight recorder, so that two writers a lap
+    // apart never write the same slot at once
+    //
+    // a record still being written from more than a lap ago was abandoned by a process that died mid-write, since the
+    // ring outlives its writers, and may be taken over
+    //
+    uint64_t abandoned = (pos >= h->slotCount) ? (2 * (pos - h->slotCount)) + 1 : 0;
+
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+
+    do {
+
+        //
+        // a writer from an earlier lap is still writing, or a writer from a later lap already claimed the slot
+        //
+        // this record is dropped rather than waiting, and the reader counts it as lost
+        //
+        if (((seq % 2) != 0 && seq >= abandoned) || seq > (2 * pos)) {
+            shmWriters.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+
+    } while (!slot.seq.compare_exchange_weak(seq, (2 * pos) + 1, std::memory_order_acquire, std::memory_order_acquire));
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.uptimeMicros = uptimeMicros();
+    slot.level = level;
+    slot.pid = shmPid;
+    slot.thread = LogThreadNumber();
+    slot.textLen = static_cast<uint16_t>(std::min(len, LOG_SHM_TEXT_SIZE));
+    slot.tagLen = static_cast<uint8_t>(tagLen);
+    slot.truncated = (len > LOG_SHM_TEXT_SIZE) ? 1 : 0;
+    std::memcpy(slot.tag, tag, tagLen);
+    std::memcpy(slot.text, buf, slot.textLen);
+
+    //
+    // only publish if the slot was not taken over as abandoned in the meantime, so that seq never goes backwards
+    //
+    uint64_t claimed = (2 * pos) + 1;
+    slot.seq.compare_exchange_strong(claimed, (2 * pos) + 2, std::memory_order_release, std::memory_order_relaxed);
+
+    shmWriters.fetch_sub(1, std::memory_order_release);
+}
+
+static const LogSink shmSink = { ShmSinkWrite, nullptr, nullptr };
+
+
+Status StartSharedMemoryLogging(const char *name, size_t capacity) {
+
+    RETURN_ERR_IF_TRUE(capacity == 0, "capacity must be positive");
+
+    //
+    // round up to power of 2
+    //
+    uint64_t slotCount = 1;
+    while (slotCount < capacity) {
+        slotCount <<= 1;
+    }
+
+    size_t size = MappingSize(slotCount);
+
+    {
+        std::lock_guard<std::mutex> lock(shmSinkMutex);
+
+        RETURN_ERR_IF_TRUE(shmRing.load() != nullptr, "shared-memory logging already started");
+
+        int fd = ::shm_open(name, O_RDWR | O_CREAT, 0600);
+
+        RETURN_ERR_IF_TRUE(fd == -1, "cannot open shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+
+        struct stat st; // NOLINT(*-pro-type-member-init)
+        if (::fstat(fd, &st) == -1) {
+            LOGE("cannot stat shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+            ::close(fd);
+            return ERR;
+        }
+
+        bool sameSize = (static_cast<size_t>(st.st_size) == size);
+
+        if (!sameSize && ::ftruncate(fd, static_cast<off_t>(size)) == -1) {
+            LOGE("cannot size shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+            ::close(fd);
+            return ERR;
+        }
+
+        void *base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        ::close(fd);
+
+        RETURN_ERR_IF_TRUE(base == MAP_FAILED, "cannot map shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+
+        auto *h = static_cast<LogShmHeader *>(base);
+
+        bool reuse = sameSize &&
+            h->magic.load(std::memory_order_acquire) == LOG_SHM_MAGIC &&
+            h->version == LOG_SHM_VERSION &&
+            h->slotSize == LOG_SHM_SLOT_SIZE &&
+            h->slotCount == slotCount;
+
+        if (!reuse) {
+
+            //
+            // a different layout, or garbage, start over
+            //
+            h->magic.store(0, std::memory_order_relaxed);
+
+            std::memset(static_cast<void *>(SlotsOf(h)), 0, size - sizeof(LogShmHeader));
+
+            h->version = LOG_SHM_VERSION;
+            h->slotSize = LOG_SHM_SLOT_SIZE;
+            h->slotCount = slotCount;
+            h->createdEpochMillis = timeSinceEpochMillis();
+            h->createdUptimeMicros = uptimeMicros();
+            h->writePos.store(0, std::memory_order_relaxed);
+
+            h->magic.store(LOG_SHM_MAGIC, std::memory_order_release);
+        }
+
+        shmPid = static_cast<uint32_t>(::getpid());
+        shmRingSize = size;
+
+        shmRing.store(h);
+    }
+
+    //
+    // everything logged before this point stays where it was going
+    //
+    FlushLogs();
+
+    SetLogSink(&shmSink);
+
+    return OK;
+}
+
+void StopSharedMemoryLogging() {
+
+    //
+    // messages still in the async ring belong in shared memory
+    //
+    FlushLogs();
+
+    if (GetLogSink() == &shmSink) {
+        SetLogSink(nullptr);
+    }
+
+    std::lock_guard<std::mutex> lock(shmSinkMutex);
+
+    LogShmHeader *h = shmRing.exchange(nullptr);
+
+    if (h == nullptr) {
+        return;
+    }
+
+    while (shmWriters.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+
+    ::munmap(h, shmRingSize);
+}
+
+Status RemoveSharedMemoryLog(const char *name) {
+
+    RETURN_ERR_IF_TRUE(::shm_unlink(name) == -1, "cannot remove shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+
+    return OK;
+}
+
+
+SharedMemoryLogReader::SharedMemoryLogReader() :
+    base(nullptr),
+    size(0),
+    nextPos(0),
+    stalledPos(UINT64_MAX),
+    stalledSinceMillis(0) {}
+
+SharedMemoryLogReader::~SharedMemoryLogReader() {
+    if (base != nullptr) {
+        ::munmap(base, size);
+    }
+}
+
+Status SharedMemoryLogReader::open(const char *name) {
+
+    RETURN_ERR_IF_TRUE(base != nullptr, "already open");
+
+    int fd = ::shm_open(name, O_RDONLY, 0);
+
+    RETURN_ERR_IF_TRUE(fd == -1, "cannot open shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+
+    struct stat st; // NOLINT(*-pro-type-member-init)
+    if (::fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(LogShmHeader)) {
+        LOGE("shared memory %s is not a log ring", name);
+        ::close(fd);
+        return ERR;
+    }
+
+    auto mapSize = static_cast<size_t>(st.st_size);
+
+    void *mapped = ::mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    RETURN_ERR_IF_TRUE(mapped == MAP_FAILED, "cannot map shared memory %s: %s (%s)", name, std::strerror(errno), ErrorName(errno));
+
+    auto *h = static_cast<LogShmHeader *>(mapped);
+
+    if (h->magic.load(std::memory_order_acquire) != LOG_SHM_MAGIC ||
+            h->version != LOG_SHM_VERSION ||
+            h->slotSize != LOG_SHM_SLOT_SIZE ||
+            h->slotCount == 0 ||
+            (h->slotCount & (h->slotCount - 1)) != 0 ||
+            MappingSize(h->slotCount) != mapSize) {
+        LOGE("shared memory %s is not a log ring", name);
+        ::munmap(mapped, mapSize);
+        return ERR;
+    }
+
+    base = mapped;
+    size = mapSize;
+
+    uint64_t end = h->writePos.load(std::memory_order_acquire);
+    nextPos = (end > h->slotCount) ? end - h->slotCount : 0;
+
+    return OK;
+}
+
+uint64_t SharedMemoryLogReader::poll(const std::function<void(const SharedMemoryLogRecord &)> &f, bool skipIncomplete) {
+
+    if (base == nullptr) {
+        return 0;
+    }
+
+    auto *h = static_cast<LogShmHeader *>(base);
+    LogShmSlot *slots = SlotsOf(h);
+
+    uint64_t lost = 0;
+
+    uint64_t end = h->writePos.load(std::memory_order_acquire);
+
+    if (end > nextPos + h->slotCount) {
+        lost += end - h->slotCount - nextPos;
+        nextPos = end - h->slotCount;
+    }
+
+    char tag[LOG_SHM_TAG_SIZE];
+    char text[LOG_SHM_TEXT_SIZE];
+
+    while (nextPos < end) {
+
+        const LogShmSlot &slot = slots[nextPos & (h->slotCount - 1)]; // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        uint64_t complete = (2 * nextPos) + 2;
+
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+
+        if (seq < complete) {
+
+            //
+            // still being written
+            //
+            if (!skipIncomplete) {
+
+                int64_t now = uptimeMillis();
+
+                if (stalledPos != nextPos) {
+                    stalledPos = nextPos;
+                    stalledSinceMillis = now;
+                    break;
+                }
+
+                if (now - stalledSinceMillis < LOG_SHM_STALL_MILLIS) {
+                    break;
+                }
+            }
+
+            lost++;
+            nextPos++;
+            continue;
+        }
+
+        if (seq > complete) {
+
+            //
+            // already overwritten
+            //
+            lost++;
+            nextPos++;
+            continue;
+        }
+
+        SharedMemoryLogRecord record; // NOLINT(*-pro-type-member-init)
+        record.pos = nextPos;
+        record.uptimeMicros = slot.uptimeMicros;
+        record.level = slot.level;
+        record.pid = slot.pid;
+        record.thread = slot.thread;
+        record.truncated = (slot.truncated != 0);
+
+        size_t tagLen = std::min<size_t>(slot.tagLen, sizeof(tag));
+        size_t textLen = std::min<size_t>(slot.textLen, sizeof(text));
+
+        std::memcpy(tag, slot.tag, tagLen);
+        std::memcpy(text, slot.text, textLen);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (slot.seq.load(std::memory_order_relaxed) != seq) {
+
+            //
+            // overwritten while copying
+            //
+            lost++;
+            nextPos++;
+            continue;
+        }
+
+        record.epochMillis = h->createdEpochMillis + ((record.uptimeMicros - h->createdUptimeMicros) / 1000);
+        record.tag = std::string_view(tag, tagLen);
+        record.text = std::string_view(text, textLen);
+
+        nextPos++;
+
+        f(record);
+    }
+
+    return lost;
+}
+
+#endif // IS_PLATFORM_ANDROID || IS_PLATFORM_WINDOWS
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
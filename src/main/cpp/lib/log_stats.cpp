@@ -0,0 +1,276 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/log_stats.h"
+
+#undef NDEBUG
+
+#include "common/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes> // for PRIu64
+#include <map>
+#include <mutex>
+
+
+#define TAG "log_stats"
+
+
+struct LogStatsEntry {
+
+    //
+    // set once by the owning thread, with release, before any counter is touched
+    //
+    std::atomic<const char *> tag;
+
+    //
+    // only written by the owning thread, so a load and a store is enough
+    //
+    std::atomic<uint64_t> messages[LOG_STATS_LEVEL_COUNT];
+    std::atomic<uint64_t> bytes[LOG_STATS_LEVEL_COUNT];
+    std::atomic<uint64_t> suppressed[LOG_STATS_LEVEL_COUNT];
+};
+
+//
+// open-addressed by TAG pointer, plus one entry at the end for "(other)"
+//
+struct LogStatsShard {
+    LogStatsEntry entries[LOG_STATS_MAX_TAGS_PER_THREAD + 1];
+};
+
+static_assert((LOG_STATS_MAX_TAGS_PER_THREAD & (LOG_STATS_MAX_TAGS_PER_THREAD - 1)) == 0);
+
+
+static std::atomic<bool> statsEnabled = false;
+
+//
+// protects shards and retired
+//
+static std::mutex statsMutex;
+
+static std::vector<LogStatsShard *> shards;
+
+//
+// counts from threads that have exited
+//
+static std::map<std::string, LogTagStats> retired;
+
+
+static void Bump(std::atomic<uint64_t> &counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static void Merge(std::map<std::string, LogTagStats> &merged, const LogStatsShard &shard) {
+
+    for (const LogStatsEntry &e : shard.entries) {
+
+        const char *tag = e.tag.load(std::memory_order_acquire);
+
+        if (tag == nullptr) {
+            continue;
+        }
+
+        LogTagStats &stats = merged[tag];
+        stats.tag = tag;
+
+        for (size_t i = 0; i < LOG_STATS_LEVEL_COUNT; i++) {
+            stats.levels[i].messages += e.messages[i].load(std::memory_order_relaxed);
+            stats.levels[i].bytes += e.bytes[i].load(std::memory_order_relaxed);
+            stats.levels[i].suppressed += e.suppressed[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+//
+// registers the calling thread's shard, and folds it into retired when the thread exits
+//
+class LogStatsShardHolder {
+public:
+
+    LogStatsShard *shard;
+
+    LogStatsShardHolder() :
+        shard(new LogStatsShard()) {
+
+        shard->entries[LOG_STATS_MAX_TAGS_PER_THREAD].tag.store("(other)", std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        shards.push_back(shard);
+    }
+
+    ~LogStatsShardHolder() {
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        Merge(retired, *shard);
+
+        std::erase(shards, shard);
+
+        delete shard;
+    }
+};
+
+static LogStatsEntry &EntryForTag(const char *tag) {
+
+    //
+    // allocated on first use so that threads that never log while counting do not pay for the shard
+    //
+    static thread_local LogStatsShardHolder holder;
+
+    LogStatsEntry *entries = holder.shard->entries;
+
+    //
+    // TAGs are string literals, so the pointer is a good enough key, and the same TAG from different files is
+    // merged by GetLogStats
+    //
+    auto h = static_cast<size_t>((reinterpret_cast<uintptr_t>(tag) >> 3) * 0x9E3779B97F4A7C15ULL); // NOLINT(*-reinterpret-cast)
+
+    for (size_t i = 0; i < LOG_STATS_MAX_TAGS_PER_THREAD; i++) {
+
+        LogStatsEntry &e = entries[(h + i) & (LOG_STATS_MAX_TAGS_PER_THREAD - 1)]; // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        const char *entryTag = e.tag.load(std::memory_order_relaxed);
+
+        if (entryTag == tag) {
+            return e;
+        }
+
+        if (entryTag == nullptr) {
+            e.tag.store(tag, std::memory_order_release);
+            return e;
+        }
+    }
+
+    return entries[LOG_STATS_MAX_TAGS_PER_THREAD]; // NOLINT(*-pro-bounds-pointer-arithmetic)
+}
+
+static size_t LevelIndex(int level) {
+    return static_cast<size_t>(std::clamp(level, LOGLEVEL_FATAL, LOGLEVEL_TRACE) - LOGLEVEL_FATAL);
+}
+
+
+void StartLogStats() {
+
+    statsEnabled.store(true, std::memory_order_release);
+
+    RecomputeLogSiteStates();
+}
+
+void StopLogStats() {
+
+    statsEnabled.store(false, std::memory_order_release);
+
+    RecomputeLogSiteStates();
+}
+
+bool IsLogStatsEnabled() {
+    return statsEnabled.load(std::memory_order_acquire);
+}
+
+
+void LogStatsCountMessage(int level, const char *tag, size_t bytes) {
+
+    if (!statsEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    LogStatsEntry &e = EntryForTag(tag);
+
+    size_t i = LevelIndex(level);
+
+    Bump(e.messages[i], 1); // NOLINT(*-pro-bounds-constant-array-index)
+    Bump(e.bytes[i], bytes); // NOLINT(*-pro-bounds-constant-array-index)
+}
+
+void LogStatsCountSuppressed(int level, const char *tag) {
+
+    if (!statsEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    LogStatsEntry &e = EntryForTag(tag);
+
+    Bump(e.suppressed[LevelIndex(level)], 1); // NOLINT(*-pro-bounds-constant-array-index)
+}
+
+
+std::vector<LogTagStats> GetLogStats() {
+
+    std::map<std::string, LogTagStats> merged;
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        merged = retired;
+
+        for (const LogStatsShard *shard : shards) {
+            Merge(merged, *shard);
+        }
+    }
+
+    std::vector<LogTagStats> stats;
+    stats.reserve(merged.size());
+
+    for (auto &[tag, s] : merged) {
+        stats.push_back(std::move(s));
+    }
+
+    return stats;
+}
+
+void LogStatsSummary() {
+
+    static constexpr char LEVEL_CHARS[] = "FEWIDT";
+
+    //
+    // snapshot first, so that these lines are not counted in what they report
+    //
+    std::vector<LogTagStats> stats = GetLogStats();
+
+    for (const LogTagStats &s : stats) {
+        for (size_t i = 0; i < LOG_STATS_LEVEL_COUNT; i++) {
+
+            const LogLevelCounts &c = s.levels[i]; // NOLINT(*-pro-bounds-constant-array-index)
+
+            if (c.messages == 0 && c.suppressed == 0) {
+                continue;
+            }
+
+            LOGI("%s %c: %" PRIu64 " messages, %" PRIu64 " bytes, %" PRIu64 " suppressed",
+                s.tag.c_str(), LEVEL_CHARS[i], c.messages, c.bytes, c.suppressed); // NOLINT(*-pro-bounds-constant-array-index)
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
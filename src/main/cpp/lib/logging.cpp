@@ -22,20 +22,87 @@
 
 #include "common/abort.h"
 #include "common/assert.h"
+#include "common/binary_log.h"
+#include "common/clock.h"
+#include "common/flight_recorder.h"
+#include "common/log_site_info.h"
+#include "common/log_stats.h"
 #include "common/platform.h"
+#include "common/trace.h"
 #include "common/unusual_message.h"
 
 #if IS_PLATFORM_ANDROID
 #include <android/log.h>
 #endif // IS_PLATFORM_ANDROID
 
+#if !IS_PLATFORM_ANDROID && !IS_PLATFORM_WINDOWS
+#include <sys/uio.h> // for writev
+#include <unistd.h> // for STDERR_FILENO
+#endif // !IS_PLATFORM_ANDROID && !IS_PLATFORM_WINDOWS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cerrno>
 #include <cstdio> // for fprintf, stderr
 #include <cstdarg> // for va_list, va_start, va_arg, va_end
+#include <cstdlib> // for atexit
+#include <cstring> // for memcpy, strnlen
+#include <ctime> // for localtime_r
 
 
 #define TAG "logging"
 
 
+//
+// size of the thread-local buffer that messages are formatted into
+//
+// longer messages fall back to a heap allocation
+//
+constexpr size_t LOG_BUFFER_SIZE = 4096;
+
+//
+// longest prefix written by FormatLogPrefix
+//
+constexpr size_t LOG_PREFIX_MAX = 160;
+
+//
+// longer TAGs are cut off in the prefix
+//
+constexpr size_t LOG_PREFIX_MAX_TAG = 64;
+
+//
+// messages longer than this are written synchronously
+//
+constexpr size_t ASYNC_LOG_SLOT_SIZE = 512 - (2 * sizeof(size_t));
+
+//
+// max number of messages written by one writev call
+//
+constexpr size_t ASYNC_LOG_MAX_BATCH = 64;
+
+//
+// how long the drainer sleeps when there is nothing to do
+//
+constexpr int ASYNC_LOG_IDLE_WAIT_MILLIS = 5;
+
+
+//
+// current level set by SetLogLevel
+//
+// written with logSitesMutex held, read without
+//
+static std::atomic<int> logLevel(LOGLEVEL_TRACE);
+
+
 static void LogFatalV(const char *tag, const char *fmt, va_list args);
 static void LogErrorV(const char *tag, const char *fmt, va_list args);
 static void LogErrorAndCaptureUnusualV(const char *tag, const char *fmt, va_list args);
@@ -44,7 +111,28 @@ static void LogWarnAndCaptureUnusualV(const char *tag, const char *fmt, va_list
 static void LogInfoV(const char *tag, const char *fmt, va_list args);
 static void LogDebugV(const char *tag, const char *fmt, va_list args);
 static void LogTraceV(const char *tag, const char *fmt, va_list args);
-static void LogNullV(const char *tag, const char *fmt, va_list args);
+
+//
+// log the message of an enabled site, at its level, without checking any levels
+//
+static void LogSiteFormatV(const LogSite *site, const char *fmt, va_list args);
+
+
+//
+// the LOG*_expanded pointers point at the functions below, so direct callers are checked against the global level
+//
+// LogSite_expanded has already checked its site and calls LogWarnV et al directly
+//
+static bool LevelEnabled(int level, const char *tag) {
+
+    if (level <= logLevel.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    LogStatsCountSuppressed(level, tag);
+
+    return false;
+}
 
 
 static void LogFatal(const char *tag, const char *fmt, ...) {
@@ -69,6 +157,11 @@ static void LogErrorAndCaptureUnusual(const char *tag, const char *fmt, ...) {
 }
 
 static void LogWarn(const char *tag, const char *fmt, ...) {
+
+    if (!LevelEnabled(LOGLEVEL_WARN, tag)) {
+        return;
+    }
+
     va_list args; // NOLINT(*-init-variables)
     va_start(args, fmt);
     LogWarnV(tag, fmt, args);
@@ -76,6 +169,11 @@ static void LogWarn(const char *tag, const char *fmt, ...) {
 }
 
 static void LogWarnAndCaptureUnusual(const char *tag, const char *fmt, ...) {
+
+    if (!LevelEnabled(LOGLEVEL_WARN, tag)) {
+        return;
+    }
+
     va_list args; // NOLINT(*-init-variables)
     va_start(args, fmt);
     LogWarnAndCaptureUnusualV(tag, fmt, args);
@@ -83,6 +181,11 @@ static void LogWarnAndCaptureUnusual(const char *tag, const char *fmt, ...) {
 }
 
 static void LogInfo(const char *tag, const char *fmt, ...) {
+
+    if (!LevelEnabled(LOGLEVEL_INFO, tag)) {
+        return;
+    }
+
     va_list args; // NOLINT(*-init-variables)
     va_start(args, fmt);
     LogInfoV(tag, fmt, args);
@@ -90,6 +193,11 @@ static void LogInfo(const char *tag, const char *fmt, ...) {
 }
 
 static void LogDebug(const char *tag, const char *fmt, ...) {
+
+    if (!LevelEnabled(LOGLEVEL_DEBUG, tag)) {
+        return;
+    }
+
     va_list args; // NOLINT(*-init-variables)
     va_start(args, fmt);
     LogDebugV(tag, fmt, args);
@@ -97,15 +205,77 @@ static void LogDebug(const char *tag, const char *fmt, ...) {
 }
 
 static void LogTrace(const char *tag, const char *fmt, ...) {
+
+    if (!LevelEnabled(LOGLEVEL_TRACE, tag)) {
+        return;
+    }
+
     va_list args; // NOLINT(*-init-variables)
     va_start(args, fmt);
     LogTraceV(tag, fmt, args);
     va_end(args);
 }
 
-static void LogNull(const char *tag, const char *fmt, ...) {
-    (void)tag;
-    (void)fmt;
+static void LogWarnGatedV(const char *tag, const char *fmt, va_list args) {
+    if (LevelEnabled(LOGLEVEL_WARN, tag)) {
+        LogWarnV(tag, fmt, args);
+    }
+}
+
+static void LogWarnAndCaptureUnusualGatedV(const char *tag, const char *fmt, va_list args) {
+    if (LevelEnabled(LOGLEVEL_WARN, tag)) {
+        LogWarnAndCaptureUnusualV(tag, fmt, args);
+    }
+}
+
+static void LogInfoGatedV(const char *tag, const char *fmt, va_list args) {
+    if (LevelEnabled(LOGLEVEL_INFO, tag)) {
+        LogInfoV(tag, fmt, args);
+    }
+}
+
+static void LogDebugGatedV(const char *tag, const char *fmt, va_list args) {
+    if (LevelEnabled(LOGLEVEL_DEBUG, tag)) {
+        LogDebugV(tag, fmt, args);
+    }
+}
+
+static void LogTraceGatedV(const char *tag, const char *fmt, va_list args) {
+    if (LevelEnabled(LOGLEVEL_TRACE, tag)) {
+        LogTraceV(tag, fmt, args);
+    }
+}
+
+//
+// for messages about a site that has already been checked, such as LOG_ENTRY_EXIT and suppressed summaries
+//
+// logged at the level and TAG of site, but never captured as unusual
+//
+static void LogForSite(const LogSite *site, const char *fmt, ...) {
+
+    va_list args; // NOLINT(*-init-variables)
+    va_start(args, fmt);
+
+    switch (site->level) {
+        case LOGLEVEL_FATAL:
+        case LOGLEVEL_ERROR:
+            LogErrorV(site->tag, fmt, args);
+            break;
+        case LOGLEVEL_WARN:
+            LogWarnV(site->tag, fmt, args);
+            break;
+        case LOGLEVEL_INFO:
+            LogInfoV(site->tag, fmt, args);
+            break;
+        case LOGLEVEL_DEBUG:
+            LogDebugV(site->tag, fmt, args);
+            break;
+        default:
+            LogTraceV(site->tag, fmt, args);
+            break;
+    }
+
+    va_end(args);
 }
 
 
@@ -115,298 +285,1552 @@ static void LogNull(const char *tag, const char *fmt, ...) {
 
 #if IS_PLATFORM_ANDROID
 
+static void AndroidLogV(int prio, int level, const char *tag, const char *fmt, va_list args) {
+
+    int n = __android_log_vprint(prio, tag, fmt, args);
+
+    LogStatsCountMessage(level, tag, (n > 0) ? static_cast<size_t>(n) : 0);
+}
+
 void LogFatalV(const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_FATAL, tag, fmt, args);
+    AndroidLogV(ANDROID_LOG_FATAL, LOGLEVEL_FATAL, tag, fmt, args);
 }
 
 void LogErrorV(const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_ERROR, tag, fmt, args);
+    AndroidLogV(ANDROID_LOG_ERROR, LOGLEVEL_ERROR, tag, fmt, args);
 }
 
-void LogErrorAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
+//
+// unusual messages are formatted once into their own thread-local buffer, written with __android_log_write, and
+// then handed to the capturer
+//
+// fine if truncated, logd truncates long messages anyway
+//
+static std::string_view LogUnusualV(int prio, int level, const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_ERROR, tag, fmt, args);
+    static thread_local char unusualBuf[LOG_BUFFER_SIZE];
 
-    //
-    // fine if truncated
-    //
-    char buf[1000];
-    std::vsnprintf(buf, sizeof(buf), fmt, args);
+    int n = std::vsnprintf(unusualBuf, sizeof(unusualBuf), fmt, args);
+
+    if (n < 0) {
+        return {};
+    }
+
+    __android_log_write(prio, tag, unusualBuf);
+
+    size_t len = std::min(static_cast<size_t>(n), sizeof(unusualBuf) - 1);
+
+    LogStatsCountMessage(level, tag, len);
 
-    captureUnusualMessage(buf);
+    return { unusualBuf, len };
 }
 
-void LogWarnV(const char *tag, const char *fmt, va_list args) {
+void LogErrorAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
 
-    ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
+    std::string_view message = LogUnusualV(ANDROID_LOG_ERROR, LOGLEVEL_ERROR, tag, fmt, args);
 
-    __android_log_vprint(ANDROID_LOG_WARN, tag, fmt, args);
+    if (message.data() != nullptr) {
+        captureUnusualMessage(message);
+    }
 }
 
-void LogWarnAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
+void LogWarnV(const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_WARN, tag, fmt, args);
+    AndroidLogV(ANDROID_LOG_WARN, LOGLEVEL_WARN, tag, fmt, args);
+}
 
-    //
-    // fine if truncated
-    //
-    char buf[1000];
-    std::vsnprintf(buf, sizeof(buf), fmt, args);
+void LogWarnAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
 
-    captureUnusualMessage(buf);
+    std::string_view message = LogUnusualV(ANDROID_LOG_WARN, LOGLEVEL_WARN, tag, fmt, args);
+
+    if (message.data() != nullptr) {
+        captureUnusualMessage(message);
+    }
 }
 
 void LogInfoV(const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_INFO, tag, fmt, args);
+    AndroidLogV(ANDROID_LOG_INFO, LOGLEVEL_INFO, tag, fmt, args);
 }
 
 void LogDebugV(const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_DEBUG, tag, fmt, args);
+    AndroidLogV(ANDROID_LOG_DEBUG, LOGLEVEL_DEBUG, tag, fmt, args);
 }
 
 void LogTraceV(const char *tag, const char *fmt, va_list args) {
 
     ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
 
-    __android_log_vprint(ANDROID_LOG_VERBOSE, tag, fmt, args);
+    AndroidLogV(ANDROID_LOG_VERBOSE, LOGLEVEL_TRACE, tag, fmt, args);
 }
 
-void LogNullV(const char *tag, const char *fmt, va_list args) {
-
-    ASSERT(std::strlen(tag) <= 23); // Android logging tags can be at most 23 characters
-
-    (void)fmt;
-    (void)args;
-}
-
-#else
-
-void LogFatalV(const char *tag, const char *fmt, va_list args) {
-    (void)tag;
-    std::vfprintf(stderr, fmt, args);
-    std::fflush(stderr);
+std::string_view LogFatalForCaptureV(const char *tag, const char *fmt, va_list args) {
+    return LogUnusualV(ANDROID_LOG_FATAL, LOGLEVEL_FATAL, tag, fmt, args);
 }
 
-void LogErrorV(const char *tag, const char *fmt, va_list args) {
-    (void)tag;
-    std::vfprintf(stderr, fmt, args);
-    std::fflush(stderr);
+//
+// Android formats the message itself, so the compile-time format of the site is not used
+//
+void LogSiteFormatV(const LogSite *site, const char *fmt, va_list args) {
+    switch (site->level) {
+        case LOGLEVEL_FATAL:
+            LogFatalV(site->tag, fmt, args);
+            break;
+        case LOGLEVEL_ERROR:
+            if ((site->flags & LOGSITE_FLAG_CAPTURE_UNUSUAL) != 0) {
+                LogErrorAndCaptureUnusualV(site->tag, fmt, args);
+            } else {
+                LogErrorV(site->tag, fmt, args);
+            }
+            break;
+        case LOGLEVEL_WARN:
+            if ((site->flags & LOGSITE_FLAG_CAPTURE_UNUSUAL) != 0) {
+                LogWarnAndCaptureUnusualV(site->tag, fmt, args);
+            } else {
+                LogWarnV(site->tag, fmt, args);
+            }
+            break;
+        case LOGLEVEL_INFO:
+            LogInfoV(site->tag, fmt, args);
+            break;
+        case LOGLEVEL_DEBUG:
+            LogDebugV(site->tag, fmt, args);
+            break;
+        case LOGLEVEL_TRACE:
+            LogTraceV(site->tag, fmt, args);
+            break;
+        default:
+            ABORT("invalid log level: %d", site->level);
+    }
 }
 
-void LogErrorAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
+void LogSiteWrite(const LogSite *site, const char *buf, size_t len) {
 
-    (void)tag;
+    LogStatsCountMessage(site->level, site->tag, len);
 
-    std::vfprintf(stderr, fmt, args);
+    ASSERT(std::strlen(site->tag) <= 23); // Android logging tags can be at most 23 characters
 
-    //
-    // fine if truncated
-    //
-    char buf[1000];
-    std::vsnprintf(buf, sizeof(buf), fmt, args);
+    int prio;
+    switch (site->level) {
+        case LOGLEVEL_FATAL: prio = ANDROID_LOG_FATAL; break;
+        case LOGLEVEL_ERROR: prio = ANDROID_LOG_ERROR; break;
+        case LOGLEVEL_WARN: prio = ANDROID_LOG_WARN; break;
+        case LOGLEVEL_INFO: prio = ANDROID_LOG_INFO; break;
+        case LOGLEVEL_DEBUG: prio = ANDROID_LOG_DEBUG; break;
+        default: prio = ANDROID_LOG_VERBOSE; break;
+    }
 
-    captureUnusualMessage(buf);
+    __android_log_write(prio, site->tag, buf);
 }
 
-void LogWarnV(const char *tag, const char *fmt, va_list args) {
-    (void)tag;
-    std::vfprintf(stderr, fmt, args);
-    std::fflush(stderr);
-}
 
-void LogWarnAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
+//
+// logd already buffers, so async logging is not supported on Android
+//
 
-    (void)tag;
+void StartAsyncLogging(size_t capacity, int overflowPolicy) {
+    (void)capacity;
+    (void)overflowPolicy;
+    LOGW("async logging is not supported on Android");
+}
 
-    std::vfprintf(stderr, fmt, args);
+void StopAsyncLogging(void) {}
 
-    //
-    // fine if truncated
-    //
-    char buf[1000];
-    std::vsnprintf(buf, sizeof(buf), fmt, args);
+void FlushLogs(void) {
 
-    captureUnusualMessage(buf);
+    if (IsBinaryLogging()) {
+        FlushBinaryLog();
+    }
 }
 
-void LogInfoV(const char *tag, const char *fmt, va_list args) {
-    (void)tag;
-    std::vfprintf(stderr, fmt, args);
-    std::fflush(stderr);
+size_t AsyncLogDroppedCount(void) {
+    return 0;
 }
 
-void LogDebugV(const char *tag, const char *fmt, va_list args) {
-    (void)tag;
-    std::vfprintf(stderr, fmt, args);
-    std::fflush(stderr);
+void SetLogSink(const LogSink *sink) {
+    (void)sink;
+    LOGW("log sinks are not supported on Android");
 }
 
-void LogTraceV(const char *tag, const char *fmt, va_list args) {
-    (void)tag;
-    std::vfprintf(stderr, fmt, args);
-    std::fflush(stderr);
+const LogSink *GetLogSink(void) {
+    return nullptr;
 }
 
-void LogNullV(const char *tag, const char *fmt, va_list args) { // NOLINT(readability-non-const-parameter)
-    (void)tag;
-    (void)fmt;
-    (void)args;
+void SetLogPrefix(int flags) {
+    (void)flags;
+    LOGW("log prefixes are not supported on Android");
 }
 
-#endif // IS_PLATFORM_ANDROID
+int GetLogPrefix(void) {
+    return LOGPREFIX_NONE;
+}
 
+#else
 
 //
-// default log level is TRACE
-LOG_decl LOGF_expanded = LogFatal;
-LOG_decl LOGE_expanded = LogError;
-LOG_decl LOGE_andCaptureUnusual_expanded = LogErrorAndCaptureUnusual;
-LOG_decl LOGW_expanded = LogWarn;
-LOG_decl LOGW_andCaptureUnusual_expanded = LogWarnAndCaptureUnusual;
-LOG_decl LOGI_expanded = LogInfo;
-LOG_decl LOGD_expanded = LogDebug;
-LOG_decl LOGT_expanded = LogTrace;
+// all non-Android output goes through LogWriteV
+//
+// the message is formatted once into a thread-local buffer and then either written to stderr (or the sink set by
+// SetLogSink) on the calling thread or handed off to the async drainer thread
+//
 
-LOG_declV LOGF_expandedV = LogFatalV;
-LOG_declV LOGE_expandedV = LogErrorV;
-LOG_declV LOGW_expandedV = LogWarnV;
-LOG_declV LOGI_expandedV = LogInfoV;
-LOG_declV LOGD_expandedV = LogDebugV;
-LOG_declV LOGT_expandedV = LogTraceV;
+static void LogWrite(int level, const char *tag, const char *buf, size_t len);
 
+//
+// set by SetLogSink, nullptr means stderr
+//
+static std::atomic<const LogSink *> logSink = nullptr;
 
-LogTracer::LogTracer(const char *tag, const char *function) :
-    tag(tag),
-    function(function) {
-    //
-    // passing in tag, so cannot use LOGT macro
-    //
-#if IS_PLATFORM_ANDROID
-    LOGT_expanded(tag, "enter %s", function);
-#else
-    LOGT_expanded(tag, "enter %s\n", function);
-#endif // IS_PLATFORM_ANDROID
-}
+//
+// set by SetLogPrefix
+//
+static std::atomic<int> logPrefix = LOGPREFIX_NONE;
 
-LogTracer::~LogTracer() {
-#if IS_PLATFORM_ANDROID
-    LOGT_expanded(tag, "exit %s", function);
-#else
-    LOGT_expanded(tag, "exit %s\n", function);
-#endif // IS_PLATFORM_ANDROID
+//
+// write v as exactly width digits, most significant first
+//
+static char *PutDigits(char *p, uint64_t v, int width) {
+
+    for (int i = width - 1; i >= 0; i--) {
+        p[i] = static_cast<char>('0' + (v % 10)); // NOLINT(*-pro-bounds-pointer-arithmetic)
+        v /= 10;
+    }
+
+    return p + width; // NOLINT(*-pro-bounds-pointer-arithmetic)
 }
 
-DebugLogTracer::DebugLogTracer(const char *tag, const char *function, const char *file, int line) :
-        tag(tag),
-        function(function),
-        file(file),
-        line(line) {
-    //
-    // passing in tag, so cannot use LOGT macro
-    //
-#if IS_PLATFORM_ANDROID
-    LOGT_expanded(tag, "enter %s %s:%d", function, file, line);
-#else
-    LOGT_expanded(tag, "enter %s %s:%d\n", function, file, line);
-#endif // IS_PLATFORM_ANDROID
+static char *PutUnsigned(char *p, uint64_t v) {
+
+    int width = 1;
+    for (uint64_t x = v; x >= 10; x /= 10) {
+        width++;
+    }
+
+    return PutDigits(p, v, width);
 }
 
-DebugLogTracer::~DebugLogTracer() {
-#if IS_PLATFORM_ANDROID
-    LOGT_expanded(tag, "exit %s %s:%d", function, file, line);
-#else
-    LOGT_expanded(tag, "exit %s %s:%d\n", function, file, line);
-#endif // IS_PLATFORM_ANDROID
+//
+// calendar part of the wall time, only formatted again when the second changes
+//
+struct LogPrefixCache {
+    int64_t second = INT64_MIN;
+    char date[FORMATTIME_LEN + 1]; // "2025-12-31 12:59:59"
+};
+
+//
+// write the prefix selected by flags into buf, which has room for LOG_PREFIX_MAX bytes
+//
+// 2025-12-31 12:59:59.123 4567.890123 T3 I/tag: message
+//
+static size_t FormatLogPrefix(int flags, int level, const char *tag, char *buf) {
+
+    char *p = buf;
+
+    if ((flags & LOGPREFIX_WALLTIME) != 0) {
+
+        static thread_local LogPrefixCache cache;
+
+        int64_t millis = timeSinceEpochMillis();
+        int64_t second = millis / 1000;
+
+        if (second != cache.second) {
+            formatTime(static_cast<time_t>(second), cache.date, sizeof(cache.date));
+            cache.second = second;
+        }
+
+        std::memcpy(p, cache.date, FORMATTIME_LEN);
+        p += FORMATTIME_LEN; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        *p++ = '.'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        p = PutDigits(p, static_cast<uint64_t>(millis % 1000), 3);
+        *p++ = ' '; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    if ((flags & LOGPREFIX_UPTIME) != 0) {
+
+        auto micros = static_cast<uint64_t>(uptimeMicros());
+
+        p = PutUnsigned(p, micros / 1000000);
+        *p++ = '.'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        p = PutDigits(p, micros % 1000000, 6);
+        *p++ = ' '; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    if ((flags & LOGPREFIX_THREAD) != 0) {
+
+        *p++ = 'T'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        p = PutUnsigned(p, LogThreadNumber());
+        *p++ = ' '; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    if ((flags & LOGPREFIX_LEVEL) != 0) {
+
+        static constexpr char LEVEL_CHARS[] = "FEWIDT";
+
+        *p++ = LEVEL_CHARS[std::clamp(level, LOGLEVEL_FATAL, LOGLEVEL_TRACE) - LOGLEVEL_FATAL]; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        *p++ = ((flags & LOGPREFIX_TAG) != 0) ? '/' : ':'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        if ((flags & LOGPREFIX_TAG) == 0) {
+            *p++ = ' '; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        }
+    }
+
+    if ((flags & LOGPREFIX_TAG) != 0) {
+
+        size_t tagLen = strnlen(tag, LOG_PREFIX_MAX_TAG);
+
+        std::memcpy(p, tag, tagLen);
+        p += tagLen; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        *p++ = ':'; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        *p++ = ' '; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    return static_cast<size_t>(p - buf);
 }
 
+//
+// a thread-local buffer that lines are formatted into
+//
+// big is only used when a line does not fit in buf, and keeps its capacity for the next long line
+//
+struct LogLineBuffer {
+    char buf[LOG_BUFFER_SIZE];
+    std::string big;
+};
 
-void SetLogLevel(int level) {
+//
+// format the prefix and the message once into b
+//
+// returns the whole line, or an empty view with a null data() if formatting failed
+//
+// messageOffset is set to where the message starts, after the prefix
+//
+// format is the compile-time parse of fmt, or nullptr
+//
+static std::string_view LogFormatV(LogLineBuffer &b, int level, const char *tag, const char *fmt, const PrintfFormat *format, va_list args, size_t &messageOffset) {
+
+    size_t prefixLen = 0;
+
+    if (int flags = logPrefix.load(std::memory_order_relaxed); flags != LOGPREFIX_NONE) {
+        prefixLen = FormatLogPrefix(flags, level, tag, b.buf);
+    }
+
+    messageOffset = prefixLen;
+
+    va_list args2; // NOLINT(*-init-variables)
+    va_copy(args2, args);
+
+    int n = FormatPrintfV(b.buf + prefixLen, sizeof(b.buf) - prefixLen, fmt, format, args); // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+    if (n < 0) {
+        va_end(args2);
+        return {};
+    }
+
+    size_t len = prefixLen + static_cast<size_t>(n);
+
+    if (len < sizeof(b.buf)) {
+        va_end(args2);
+        return { b.buf, len };
+    }
 
     //
-    // LOGF_expanded and LOGE_expanded never change, so no need to set
+    // rare: line does not fit in buf
     //
+    b.big.resize(len + 1);
+    std::memcpy(b.big.data(), b.buf, prefixLen);
+    FormatPrintfV(b.big.data() + prefixLen, b.big.size() - prefixLen, fmt, format, args2); // NOLINT(*-pro-bounds-pointer-arithmetic)
 
-    switch (level) {
-        case LOGLEVEL_FATAL:
-        case LOGLEVEL_ERROR: {
-            LOGW_expanded = LogNull;
-            LOGI_expanded = LogNull;
-            LOGD_expanded = LogNull;
-            LOGT_expanded = LogNull;
-
-            LOGW_expandedV = LogNullV;
-            LOGI_expandedV = LogNullV;
-            LOGD_expandedV = LogNullV;
-            LOGT_expandedV = LogNullV;
-            break;
-        }
-        case LOGLEVEL_WARN: {
-            LOGW_expanded = LogWarn;
-            LOGI_expanded = LogNull;
-            LOGD_expanded = LogNull;
-            LOGT_expanded = LogNull;
-
-            LOGW_expandedV = LogWarnV;
-            LOGI_expandedV = LogNullV;
-            LOGD_expandedV = LogNullV;
-            LOGT_expandedV = LogNullV;
-            break;
+    va_end(args2);
+
+    return { b.big.data(), len };
+}
+
+static void LogWriteV(int level, const char *tag, const char *fmt, const PrintfFormat *format, va_list args) {
+
+    static thread_local LogLineBuffer logBuf;
+
+    size_t messageOffset; // NOLINT(*-init-variables)
+    std::string_view line = LogFormatV(logBuf, level, tag, fmt, format, args, messageOffset);
+
+    if (line.data() == nullptr) {
+        return;
+    }
+
+    LogWrite(level, tag, line.data(), line.size());
+}
+
+//
+// unusual messages are formatted once into their own thread-local buffer, so that a capturer that logs does not
+// overwrite the message it was given, and the same bytes are written and then handed to the capturer
+//
+// the message handed to the capturer does not include the prefix or the trailing newline
+//
+static std::string_view LogUnusualV(int level, const char *tag, const char *fmt, const PrintfFormat *format, va_list args) {
+
+    static thread_local LogLineBuffer unusualBuf;
+
+    size_t messageOffset; // NOLINT(*-init-variables)
+    std::string_view line = LogFormatV(unusualBuf, level, tag, fmt, format, args, messageOffset);
+
+    if (line.data() == nullptr) {
+        return {};
+    }
+
+    LogWrite(level, tag, line.data(), line.size());
+
+    std::string_view message = line.substr(messageOffset);
+
+    if (!message.empty() && message.back() == '\n') {
+        message.remove_suffix(1);
+    }
+
+    return message;
+}
+
+void LogFatalV(const char *tag, const char *fmt, va_list args) {
+    LogWriteV(LOGLEVEL_FATAL, tag, fmt, nullptr, args);
+}
+
+void LogErrorV(const char *tag, const char *fmt, va_list args) {
+    LogWriteV(LOGLEVEL_ERROR, tag, fmt, nullptr, args);
+}
+
+void LogErrorAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
+
+    std::string_view message = LogUnusualV(LOGLEVEL_ERROR, tag, fmt, nullptr, args);
+
+    if (message.data() != nullptr) {
+        captureUnusualMessage(message);
+    }
+}
+
+void LogWarnV(const char *tag, const char *fmt, va_list args) {
+    LogWriteV(LOGLEVEL_WARN, tag, fmt, nullptr, args);
+}
+
+void LogWarnAndCaptureUnusualV(const char *tag, const char *fmt, va_list args) {
+
+    std::string_view message = LogUnusualV(LOGLEVEL_WARN, tag, fmt, nullptr, args);
+
+    if (message.data() != nullptr) {
+        captureUnusualMessage(message);
+    }
+}
+
+void LogInfoV(const char *tag, const char *fmt, va_list args) {
+    LogWriteV(LOGLEVEL_INFO, tag, fmt, nullptr, args);
+}
+
+void LogDebugV(const char *tag, const char *fmt, va_list args) {
+    LogWriteV(LOGLEVEL_DEBUG, tag, fmt, nullptr, args);
+}
+
+void LogTraceV(const char *tag, const char *fmt, va_list args) {
+    LogWriteV(LOGLEVEL_TRACE, tag, fmt, nullptr, args);
+}
+
+void LogSiteWrite(const LogSite *site, const char *buf, size_t len) {
+    LogWrite(site->level, site->tag, buf, len);
+}
+
+std::string_view LogFatalForCaptureV(const char *tag, const char *fmt, va_list args) {
+    return LogUnusualV(LOGLEVEL_FATAL, tag, fmt, nullptr, args);
+}
+
+void LogSiteFormatV(const LogSite *site, const char *fmt, va_list args) {
+
+    if ((site->flags & LOGSITE_FLAG_CAPTURE_UNUSUAL) != 0) {
+
+        std::string_view message = LogUnusualV(site->level, site->tag, fmt, site->format, args);
+
+        if (message.data() != nullptr) {
+            captureUnusualMessage(message);
+        }
+
+        return;
+    }
+
+    LogWriteV(site->level, site->tag, fmt, site->format, args);
+}
+
+
+//
+// async logging
+//
+// producers reserve a slot in a bounded MPSC ring (Vyukov-style, each slot carries a sequence number) and copy the
+// formatted message into it
+//
+// a single drainer thread collects runs of published slots and writes them to stderr with one writev call, or
+// passes them one at a time to the sink
+//
+
+#if IS_PLATFORM_WINDOWS
+
+//
+// no writev on Windows
+//
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+#endif // IS_PLATFORM_WINDOWS
+
+struct AsyncLogSlot {
+    std::atomic<size_t> seq;
+    size_t len;
+    int level;
+    const char *tag;
+    char data[ASYNC_LOG_SLOT_SIZE];
+};
+
+struct AsyncLogger {
+    std::unique_ptr<AsyncLogSlot[]> slots;
+    size_t mask;
+    int overflowPolicy;
+
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+    alignas(64) std::atomic<size_t> droppedCount;
+
+    std::atomic<bool> stopping;
+    std::atomic<bool> drainerIdle;
+
+    //
+    // producers between checking stopping and finishing their push
+    //
+    // the drainer does not exit while this is non-zero, so a message pushed after StopAsyncLogging started is still
+    // written
+    //
+    std::atomic<size_t> producers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread drainer;
+};
+
+
+static std::atomic<AsyncLogger *> asyncLogger = nullptr;
+
+//
+// serializes StartAsyncLogging and StopAsyncLogging
+//
+static std::mutex asyncLoggerMutex;
+
+//
+// set on the drainer thread
+//
+// sinks run on the drainer, so a sink that logs would otherwise push to the ring that only the drainer empties, and
+// wait for itself when the ring is full or the message needs FlushLogs
+// messages logged on the drainer are written directly instead
+//
+static thread_local bool inAsyncDrainer = false;
+
+
+static bool AsyncLogTryPush(AsyncLogger *a, int level, const char *tag, const char *buf, size_t len) {
+
+    AsyncLogSlot *slot; // NOLINT(*-init-variables)
+
+    size_t pos = a->enqueuePos.load(std::memory_order_relaxed);
+
+    for (;;) {
+
+        slot = &a->slots[pos & a->mask];
+
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+
+        auto diff = static_cast<ptrdiff_t>(seq - pos);
+
+        if (diff == 0) {
+
+            if (a->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+
+        } else if (diff < 0) {
+
+            //
+            // full
+            //
+            return false;
+
+        } else {
+
+            pos = a->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::memcpy(slot->data, buf, len);
+    slot->len = len;
+    slot->level = level;
+    slot->tag = tag;
+
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+static void AsyncLogWake(AsyncLogger *a) {
+
+    if (a->drainerIdle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(a->mutex);
+        a->cv.notify_one();
+    }
+}
+
+//
+// return true if message was handed off to the drainer
+//
+static bool AsyncLogPush(AsyncLogger *a, int level, const char *tag, const char *buf, size_t len) {
+
+    if (len > ASYNC_LOG_SLOT_SIZE) {
+
+        //
+        // rare: message does not fit in a slot
+        //
+        // drain everything before it so that ordering is kept, then let the caller write synchronously
+        //
+        FlushLogs();
+
+        return false;
+    }
+
+    //
+    // pairs with the drainer checking producers after seeing stopping: either this sees stopping, or the drainer sees
+    // this producer and keeps draining until it is done
+    //
+    a->producers.fetch_add(1, std::memory_order_seq_cst);
+
+    for (;;) {
+
+        //
+        // StopAsyncLogging was called, possibly while waiting for room
+        //
+        // the drainer may already be past its final batch, so let the caller write synchronously
+        //
+        if (a->stopping.load(std::memory_order_seq_cst) || asyncLogger.load(std::memory_order_acquire) != a) {
+            a->producers.fetch_sub(1, std::memory_order_seq_cst);
+            return false;
+        }
+
+        if (AsyncLogTryPush(a, level, tag, buf, len)) {
+            break;
+        }
+
+        if (a->overflowPolicy == LOGASYNC_OVERFLOW_DROP) {
+            a->droppedCount.fetch_add(1, std::memory_order_relaxed);
+            a->producers.fetch_sub(1, std::memory_order_seq_cst);
+            return true;
+        }
+
+        AsyncLogWake(a);
+
+        std::this_thread::yield();
+    }
+
+    a->producers.fetch_sub(1, std::memory_order_seq_cst);
+
+    AsyncLogWake(a);
+
+    return true;
+}
+
+static void WriteAllToStderr(struct iovec *iov, int count) { // NOLINT(readability-non-const-parameter)
+
+#if IS_PLATFORM_WINDOWS
+
+    for (int i = 0; i < count; i++) {
+        std::fwrite(iov[i].iov_base, 1, iov[i].iov_len, stderr);
+    }
+    std::fflush(stderr);
+
+#else
+
+    while (count > 0) {
+
+        ssize_t written = ::writev(STDERR_FILENO, iov, count);
+
+        if (written < 0) {
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            //
+            // nowhere to report the error
+            //
+            return;
+        }
+
+        auto remaining = static_cast<size_t>(written);
+
+        while (count > 0 && iov[0].iov_len <= remaining) {
+            remaining -= iov[0].iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0) {
+            iov[0].iov_base = static_cast<char *>(iov[0].iov_base) + remaining;
+            iov[0].iov_len -= remaining;
+        }
+    }
+
+#endif // IS_PLATFORM_WINDOWS
+}
+
+//
+// return number of messages written
+//
+static size_t AsyncLogDrainBatch(AsyncLogger *a) {
+
+    struct iovec iov[ASYNC_LOG_MAX_BATCH];
+
+    size_t pos = a->dequeuePos.load(std::memory_order_relaxed);
+
+    const LogSink *sink = logSink.load(std::memory_order_acquire);
+
+    size_t count = 0;
+    while (count < ASYNC_LOG_MAX_BATCH) {
+
+        AsyncLogSlot &slot = a->slots[(pos + count) & a->mask];
+
+        if (slot.seq.load(std::memory_order_acquire) != pos + count + 1) {
+            break;
+        }
+
+        if (sink != nullptr) {
+            sink->write(sink->context, slot.level, slot.tag, slot.data, slot.len);
+        } else {
+            iov[count].iov_base = slot.data;
+            iov[count].iov_len = slot.len;
+        }
+
+        count++;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (sink == nullptr) {
+
+        //
+        // stderr is only touched by the drainer while async logging is running, except for fatal messages
+        //
+        // flush anything already sitting in the stdio buffer first
+        //
+        std::fflush(stderr);
+
+        WriteAllToStderr(iov, static_cast<int>(count));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        a->slots[(pos + i) & a->mask].seq.store(pos + i + a->mask + 1, std::memory_order_release);
+    }
+
+    a->dequeuePos.store(pos + count, std::memory_order_release);
+
+    return count;
+}
+
+static void AsyncLogDrainerLoop(AsyncLogger *a) {
+
+    inAsyncDrainer = true;
+
+    size_t reportedDropped = 0;
+
+    for (;;) {
+
+        size_t drained = AsyncLogDrainBatch(a);
+
+        size_t dropped = a->droppedCount.load(std::memory_order_relaxed);
+        if (dropped != reportedDropped) {
+
+            char buf[100];
+            int n = std::snprintf(buf, sizeof(buf), "logging: dropped %zu messages" COMMON_LOGGING_C, dropped - reportedDropped);
+
+            const LogSink *sink = logSink.load(std::memory_order_acquire);
+
+            if (sink != nullptr) {
+
+                sink->write(sink->context, LOGLEVEL_WARN, TAG, buf, static_cast<size_t>(n));
+
+            } else {
+
+                struct iovec iov[1];
+                iov[0].iov_base = buf;
+                iov[0].iov_len = static_cast<size_t>(n);
+
+                WriteAllToStderr(iov, 1);
+            }
+
+            reportedDropped = dropped;
+        }
+
+        if (drained != 0) {
+            continue;
+        }
+
+        if (a->stopping.load(std::memory_order_seq_cst)) {
+
+            //
+            // producers may have published after the last batch, or still be pushing
+            //
+            // producers is checked before the final batch, so everything a finished producer published is in it
+            //
+            bool inFlight = (a->producers.load(std::memory_order_seq_cst) != 0);
+
+            if (AsyncLogDrainBatch(a) == 0) {
+
+                if (!inFlight) {
+                    return;
+                }
+
+                std::this_thread::yield();
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(a->mutex);
+
+        a->drainerIdle.store(true, std::memory_order_relaxed);
+
+        //
+        // a producer may miss the idle flag, so do not sleep for long
+        //
+        a->cv.wait_for(lock, std::chrono::milliseconds(ASYNC_LOG_IDLE_WAIT_MILLIS));
+
+        a->drainerIdle.store(false, std::memory_order_relaxed);
+    }
+}
+
+static void LogWrite(int level, const char *tag, const char *buf, size_t len) {
+
+    LogStatsCountMessage(level, tag, len);
+
+    AsyncLogger *a = inAsyncDrainer ? nullptr : asyncLogger.load(std::memory_order_acquire);
+
+    if (a != nullptr) {
+
+        if (level == LOGLEVEL_FATAL) {
+
+            //
+            // the caller is about to abort, so get everything out and then write synchronously
+            //
+            FlushLogs();
+
+        } else if (AsyncLogPush(a, level, tag, buf, len)) {
+
+            return;
+        }
+    }
+
+    const LogSink *sink = logSink.load(std::memory_order_acquire);
+
+    if (sink != nullptr) {
+
+        sink->write(sink->context, level, tag, buf, len);
+
+        if (level == LOGLEVEL_FATAL && sink->flush != nullptr) {
+            sink->flush(sink->context);
+        }
+
+        return;
+    }
+
+    std::fwrite(buf, 1, len, stderr);
+    std::fflush(stderr);
+}
+
+void StartAsyncLogging(size_t capacity, int overflowPolicy) {
+
+    ASSERT(overflowPolicy == LOGASYNC_OVERFLOW_DROP || overflowPolicy == LOGASYNC_OVERFLOW_BLOCK);
+    ASSERT(capacity != 0);
+
+    std::lock_guard<std::mutex> lock(asyncLoggerMutex);
+
+    if (asyncLogger.load(std::memory_order_acquire) != nullptr) {
+        LOGW("async logging already started");
+        return;
+    }
+
+    //
+    // round up to power of 2
+    //
+    size_t actualCapacity = 1;
+    while (actualCapacity < capacity) {
+        actualCapacity <<= 1;
+    }
+
+    auto *a = new AsyncLogger();
+
+    a->slots = std::make_unique<AsyncLogSlot[]>(actualCapacity);
+    for (size_t i = 0; i < actualCapacity; i++) {
+        a->slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    a->mask = actualCapacity - 1;
+    a->overflowPolicy = overflowPolicy;
+
+    a->drainer = std::thread(AsyncLogDrainerLoop, a);
+
+    asyncLogger.store(a, std::memory_order_release);
+
+    static bool registeredAtExit = false;
+    if (!registeredAtExit) {
+        std::atexit(StopAsyncLogging);
+        registeredAtExit = true;
+    }
+}
+
+void StopAsyncLogging(void) {
+
+    std::lock_guard<std::mutex> lock(asyncLoggerMutex);
+
+    AsyncLogger *a = asyncLogger.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (a == nullptr) {
+        return;
+    }
+
+    a->stopping.store(true, std::memory_order_seq_cst);
+
+    {
+        std::lock_guard<std::mutex> lock2(a->mutex);
+        a->cv.notify_one();
+    }
+
+    a->drainer.join();
+
+    //
+    // intentionally leak a
+    //
+    // other threads may have loaded the pointer just before the exchange above and may still be pushing
+    //
+}
+
+void FlushLogs(void) {
+
+    //
+    // the drainer cannot wait for itself
+    //
+    AsyncLogger *a = inAsyncDrainer ? nullptr : asyncLogger.load(std::memory_order_acquire);
+
+    if (a != nullptr) {
+
+        size_t target = a->enqueuePos.load(std::memory_order_acquire);
+
+        while (a->dequeuePos.load(std::memory_order_acquire) < target) {
+
+            {
+                std::lock_guard<std::mutex> lock(a->mutex);
+                a->cv.notify_one();
+            }
+
+            std::this_thread::yield();
+
+            if (a->stopping.load(std::memory_order_acquire)) {
+                break;
+            }
+        }
+    }
+
+    std::fflush(stderr);
+
+    const LogSink *sink = logSink.load(std::memory_order_acquire);
+
+    if (sink != nullptr && sink->flush != nullptr) {
+        sink->flush(sink->context);
+    }
+
+    if (IsBinaryLogging()) {
+        FlushBinaryLog();
+    }
+}
+
+size_t AsyncLogDroppedCount(void) {
+
+    AsyncLogger *a = asyncLogger.load(std::memory_order_acquire);
+
+    if (a == nullptr) {
+        return 0;
+    }
+
+    return a->droppedCount.load(std::memory_order_relaxed);
+}
+
+void SetLogSink(const LogSink *sink) {
+    logSink.store(sink, std::memory_order_release);
+}
+
+const LogSink *GetLogSink(void) {
+    return logSink.load(std::memory_order_acquire);
+}
+
+void SetLogPrefix(int flags) {
+    logPrefix.store(flags, std::memory_order_relaxed);
+}
+
+int GetLogPrefix(void) {
+    return logPrefix.load(std::memory_order_relaxed);
+}
+
+#endif // IS_PLATFORM_ANDROID
+
+
+//
+// never changed by SetLogLevel
+//
+LOG_decl LOGF_expanded = LogFatal;
+LOG_decl LOGE_expanded = LogError;
+LOG_decl LOGE_andCaptureUnusual_expanded = LogErrorAndCaptureUnusual;
+LOG_decl LOGW_expanded = LogWarn;
+LOG_decl LOGW_andCaptureUnusual_expanded = LogWarnAndCaptureUnusual;
+LOG_decl LOGI_expanded = LogInfo;
+LOG_decl LOGD_expanded = LogDebug;
+LOG_decl LOGT_expanded = LogTrace;
+
+LOG_declV LOGF_expandedV = LogFatalV;
+LOG_declV LOGE_expandedV = LogErrorV;
+LOG_declV LOGE_andCaptureUnusual_expandedV = LogErrorAndCaptureUnusualV;
+LOG_declV LOGW_expandedV = LogWarnGatedV;
+LOG_declV LOGW_andCaptureUnusual_expandedV = LogWarnAndCaptureUnusualGatedV;
+LOG_declV LOGI_expandedV = LogInfoGatedV;
+LOG_declV LOGD_expandedV = LogDebugGatedV;
+LOG_declV LOGT_expandedV = LogTraceGatedV;
+
+
+//
+// protects logLevel, tagLevels, siteRules, and logSites
+//
+static std::mutex logSitesMutex;
+
+//
+// overrides set by SetLogLevelForTag
+//
+static std::map<std::string, int, std::less<>> tagLevels;
+
+//
+// rules added by EnableLogSites and DisableLogSites, later rules win
+//
+struct LogSiteRule {
+    std::string pattern;
+    bool enabled;
+};
+
+static std::vector<LogSiteRule> siteRules;
+
+//
+// every site that has been reached at least once, site->id is 1 + index
+//
+static std::vector<LogSite *> logSites;
+
+//
+// indexed by site->id, filled in by GetLogSiteInfo
+//
+static std::atomic<LogSiteInfo *> logSiteInfos[LOGSITE_MAX_INFOS];
+
+
+//
+// glob with * and ?
+//
+static bool GlobMatch(std::string_view pattern, std::string_view text) {
+
+    size_t p = 0;
+    size_t t = 0;
+
+    //
+    // where to resume after the last *
+    //
+    size_t starP = std::string_view::npos;
+    size_t starT = 0;
+
+    while (t < text.size()) {
+
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            p++;
+            t++;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starT = t;
+        } else if (starP != std::string_view::npos) {
+            p = starP + 1;
+            t = ++starT;
+        } else {
+            return false;
         }
-        case LOGLEVEL_INFO: {
-            LOGW_expanded = LogWarn;
-            LOGI_expanded = LogInfo;
-            LOGD_expanded = LogNull;
-            LOGT_expanded = LogNull;
-
-            LOGW_expandedV = LogWarnV;
-            LOGI_expandedV = LogInfoV;
-            LOGD_expandedV = LogNullV;
-            LOGT_expandedV = LogNullV;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+
+    return p == pattern.size();
+}
+
+static std::string_view FileName(const char *path) {
+
+    std::string_view file = path;
+
+    if (size_t slash = file.find_last_of("/\\"); slash != std::string_view::npos) {
+        file.remove_prefix(slash + 1);
+    }
+
+    return file;
+}
+
+//
+// pattern is matched against the TAG, the file name, and file:line
+//
+static bool SiteMatches(const LogSite *site, std::string_view pattern) {
+
+    if (GlobMatch(pattern, site->tag)) {
+        return true;
+    }
+
+    std::string_view file = FileName(site->file);
+
+    if (GlobMatch(pattern, file)) {
+        return true;
+    }
+
+    char fileLine[256];
+    int n = std::snprintf(fileLine, sizeof(fileLine), "%.*s:%d", static_cast<int>(file.size()), file.data(), site->line);
+
+    return n > 0 && GlobMatch(pattern, std::string_view(fileLine, std::min(static_cast<size_t>(n), sizeof(fileLine) - 1)));
+}
+
+//
+// logSitesMutex must be held
+//
+static int ComputeSiteState(const LogSite *site) {
+
+    int level = logLevel.load(std::memory_order_relaxed);
+
+    if (auto it = tagLevels.find(site->tag); it != tagLevels.end()) {
+        level = it->second;
+    }
+
+    bool output = (site->level <= level);
+
+    for (auto it = siteRules.rbegin(); it != siteRules.rend(); it++) {
+        if (SiteMatches(site, it->pattern)) {
+            output = it->enabled;
             break;
         }
-        case LOGLEVEL_DEBUG: {
-            LOGW_expanded = LogWarn;
-            LOGI_expanded = LogInfo;
-            LOGD_expanded = LogDebug;
-            LOGT_expanded = LogNull;
-
-            LOGW_expandedV = LogWarnV;
-            LOGI_expandedV = LogInfoV;
-            LOGD_expandedV = LogDebugV;
-            LOGT_expandedV = LogNullV;
-            break;
+    }
+
+    //
+    // LOGF and LOGE are never turned off, not even by a rule
+    //
+    if (site->level <= LOGLEVEL_ERROR) {
+        output = true;
+    }
+
+    int state = output ? LOGSITE_STATE_OUTPUT : 0;
+
+    //
+    // the flight recorder keeps printf arguments, and KV sites do not have any
+    //
+    if ((site->flags & LOGSITE_FLAG_KV) == 0 && IsFlightRecording()) {
+        state |= LOGSITE_STATE_RECORD;
+    }
+
+    if ((site->flags & LOGSITE_FLAG_ENTRY_EXIT) != 0 && IsTracing()) {
+        state |= LOGSITE_STATE_SPAN;
+    }
+
+    if (IsLogStatsEnabled()) {
+        state |= LOGSITE_STATE_STATS;
+    }
+
+    return state;
+}
+
+static void StoreSiteState(LogSite *site, int state) {
+    std::atomic_ref<int>(site->state).store(state, std::memory_order_relaxed);
+}
+
+static int LoadSiteState(LogSite *site) {
+    return std::atomic_ref<int>(site->state).load(std::memory_order_relaxed);
+}
+
+//
+// logSitesMutex must be held
+//
+static void RecomputeSiteStates(const char *tag) {
+    for (LogSite *site : logSites) {
+        if (tag == nullptr || std::strcmp(site->tag, tag) == 0) {
+            StoreSiteState(site, ComputeSiteState(site));
         }
-        case LOGLEVEL_TRACE: {
-            LOGW_expanded = LogWarn;
-            LOGI_expanded = LogInfo;
-            LOGD_expanded = LogDebug;
-            LOGT_expanded = LogTrace;
-
-            LOGW_expandedV = LogWarnV;
-            LOGI_expandedV = LogInfoV;
-            LOGD_expandedV = LogDebugV;
-            LOGT_expandedV = LogTraceV;
-            break;
+    }
+}
+
+static int ResolveSite(LogSite *site) {
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    if ((LoadSiteState(site) & LOGSITE_STATE_UNRESOLVED) != 0) {
+        logSites.push_back(site);
+        std::atomic_ref<int>(site->id).store(static_cast<int>(logSites.size()), std::memory_order_release);
+        StoreSiteState(site, ComputeSiteState(site));
+    }
+
+    return LoadSiteState(site);
+}
+
+static int ResolvedSiteState(LogSite *site) {
+
+    int state = LoadSiteState(site);
+
+    if ((state & LOGSITE_STATE_UNRESOLVED) != 0) {
+        state = ResolveSite(site);
+    }
+
+    return state;
+}
+
+int LogSiteEnabled(LogSite *site) {
+
+    int state = ResolvedSiteState(site);
+
+    //
+    // LOGSITE_STATE_STATS only sends the site here so that it can be counted
+    //
+    if ((state & LOGSITE_STATE_STATS) != 0) {
+
+        if ((state & LOGSITE_STATE_OUTPUT) == 0) {
+            LogStatsCountSuppressed(site->level, site->tag);
         }
-        default:
+
+        state &= ~LOGSITE_STATE_STATS;
+    }
+
+    return state != 0;
+}
+
+unsigned int LogThreadNumber(void) {
+
+    static std::atomic<unsigned int> nextThreadNumber = 1;
+
+    static thread_local unsigned int threadNumber = 0;
+
+    if (threadNumber == 0) {
+        threadNumber = nextThreadNumber.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return threadNumber;
+}
+
+void RecomputeLogSiteStates(void) {
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    RecomputeSiteStates(nullptr);
+}
+
+const LogSiteInfo *GetLogSiteInfo(const LogSite *site) {
+
+    int id = std::atomic_ref<const int>(site->id).load(std::memory_order_acquire);
+
+    if (id <= 0 || static_cast<size_t>(id) >= LOGSITE_MAX_INFOS) {
+        return nullptr;
+    }
+
+    LogSiteInfo *info = logSiteInfos[id].load(std::memory_order_acquire);
+
+    if (info == nullptr) {
+
+        auto *fresh = new LogSiteInfo();
+
+        fresh->specCount = ParsePrintfFormat(site->fmt, fresh->specs, LOGSITE_MAX_SPECS);
+
+        //
+        // another thread may have parsed the same site at the same time
+        //
+        if (logSiteInfos[id].compare_exchange_strong(info, fresh, std::memory_order_acq_rel)) {
+            info = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+
+    return (info->specCount <= LOGSITE_MAX_SPECS) ? info : nullptr;
+}
+
+
+static void LogSite_expandedV(LogSite *site, const char *fmt, va_list args) {
+
+    int state = LoadSiteState(site);
+
+    if ((state & LOGSITE_STATE_RECORD) != 0) {
+
+        va_list args2; // NOLINT(*-init-variables)
+        va_copy(args2, args);
+
+        FlightRecorderWriteV(site, args2);
+
+        va_end(args2);
+    }
+
+    if ((state & LOGSITE_STATE_OUTPUT) == 0) {
+        return;
+    }
+
+    if (site->flags == 0 && site->level != LOGLEVEL_FATAL && IsBinaryLogging()) {
+
+        va_list args2; // NOLINT(*-init-variables)
+        va_copy(args2, args);
+
+        bool recorded = BinaryLogWriteV(site, args2);
+
+        va_end(args2);
+
+        if (recorded) {
+            LogStatsCountMessage(site->level, site->tag, 0);
+            return;
+        }
+
+        //
+        // fall back to text
+        //
+    }
+
+    //
+    // the site state already took the global and TAG levels into account, so do not go through LOG*_expandedV,
+    // which only know the global level
+    //
+    LogSiteFormatV(site, fmt, args);
+}
+
+void LogSite_expanded(LogSite *site, const char *fmt, ...) {
+    va_list args; // NOLINT(*-init-variables)
+    va_start(args, fmt);
+    LogSite_expandedV(site, fmt, args);
+    va_end(args);
+}
+
+
+void LogSiteSuppressed(LogSite *site, int64_t count) {
+
+    if (count <= 0 || (LoadSiteState(site) & LOGSITE_STATE_OUTPUT) == 0) {
+        return;
+    }
+
+    auto n = static_cast<long long>(count);
+
+#if IS_PLATFORM_ANDROID
+    const char *fmt = "suppressed %lld messages from %s:%d";
+#else
+    const char *fmt = "suppressed %lld messages from %s:%d\n";
+#endif // IS_PLATFORM_ANDROID
+
+    LogForSite(site, fmt, n, site->file, site->line);
+}
+
+int LogSiteEveryMillis(LogSite *site, LogRateLimit *limit, int64_t ms) {
+
+    std::atomic_ref<int64_t> lastMillis(limit->lastMillis);
+    std::atomic_ref<int64_t> suppressed(limit->suppressed);
+
+    int64_t now = uptimeMillisCoarse();
+    int64_t last = lastMillis.load(std::memory_order_relaxed);
+
+    //
+    // only one thread wins the exchange, and everyone else counts as suppressed
+    //
+    if ((last < 0 || now - last >= ms) && lastMillis.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+
+        LogSiteSuppressed(site, suppressed.exchange(0, std::memory_order_relaxed));
+
+        return 1;
+    }
+
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+
+    return 0;
+}
+
+
+LogTracer::LogTracer(LogSite *site, const char *function) :
+    site(site),
+    function(function),
+    state(ResolvedSiteState(site)),
+    beginMicros(0) {
+
+    if ((state & LOGSITE_STATE_OUTPUT) != 0) {
+
+        //
+        // passing in tag, so cannot use LOGT macro
+        //
+#if IS_PLATFORM_ANDROID
+        LogForSite(site, "enter %s", function);
+#else
+        LogForSite(site, "enter %s\n", function);
+#endif // IS_PLATFORM_ANDROID
+    }
+
+    //
+    // after logging, so that the span does not include the cost of logging
+    //
+    if ((state & LOGSITE_STATE_SPAN) != 0) {
+        beginMicros = uptimeMicros();
+    }
+}
+
+LogTracer::~LogTracer() {
+
+    if ((state & LOGSITE_STATE_SPAN) != 0) {
+        TraceSpan(site, function, beginMicros, uptimeMicros());
+    }
+
+    if ((state & LOGSITE_STATE_OUTPUT) == 0) {
+        return;
+    }
+
+#if IS_PLATFORM_ANDROID
+    LogForSite(site, "exit %s", function);
+#else
+    LogForSite(site, "exit %s\n", function);
+#endif // IS_PLATFORM_ANDROID
+}
+
+DebugLogTracer::DebugLogTracer(LogSite *site, const char *function) :
+        site(site),
+        function(function),
+        state(ResolvedSiteState(site)),
+        beginMicros(0) {
+
+    if ((state & LOGSITE_STATE_OUTPUT) != 0) {
+
+        //
+        // passing in tag, so cannot use LOGT macro
+        //
+#if IS_PLATFORM_ANDROID
+        LogForSite(site, "enter %s %s:%d", function, site->file, site->line);
+#else
+        LogForSite(site, "enter %s %s:%d\n", function, site->file, site->line);
+#endif // IS_PLATFORM_ANDROID
+    }
+
+    if ((state & LOGSITE_STATE_SPAN) != 0) {
+        beginMicros = uptimeMicros();
+    }
+}
+
+DebugLogTracer::~DebugLogTracer() {
+
+    if ((state & LOGSITE_STATE_SPAN) != 0) {
+        TraceSpan(site, function, beginMicros, uptimeMicros());
+    }
+
+    if ((state & LOGSITE_STATE_OUTPUT) == 0) {
+        return;
+    }
+
+#if IS_PLATFORM_ANDROID
+    LogForSite(site, "exit %s %s:%d", function, site->file, site->line);
+#else
+    LogForSite(site, "exit %s %s:%d\n", function, site->file, site->line);
+#endif // IS_PLATFORM_ANDROID
+}
+
+
+void SetLogLevel(int level) {
+
+    if (level < LOGLEVEL_FATAL || LOGLEVEL_TRACE < level) {
+        ABORT("invalid log level: %d", level);
+    }
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    logLevel.store(level, std::memory_order_relaxed);
+
+    RecomputeSiteStates(nullptr);
+}
+
+
+void SetLogLevelForTag(const char *tag, int level) {
+
+    if (level < LOGLEVEL_FATAL || LOGLEVEL_TRACE < level) {
         ABORT("invalid log level: %d", level);
     }
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    tagLevels[tag] = level;
+
+    RecomputeSiteStates(tag);
+}
+
+void ClearLogLevelForTag(const char *tag) {
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    if (auto it = tagLevels.find(tag); it != tagLevels.end()) {
+        tagLevels.erase(it);
+    }
+
+    RecomputeSiteStates(tag);
+}
+
+
+static void AddSiteRule(const char *pattern, bool enabled) {
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    siteRules.push_back({ pattern, enabled });
+
+    RecomputeSiteStates(nullptr);
+}
+
+void EnableLogSites(const char *pattern) {
+    AddSiteRule(pattern, true);
+}
+
+void DisableLogSites(const char *pattern) {
+    AddSiteRule(pattern, false);
+}
+
+void ClearLogSiteRules(void) {
+
+    std::lock_guard<std::mutex> lock(logSitesMutex);
+
+    siteRules.clear();
+
+    RecomputeSiteStates(nullptr);
+}
+
+void ForEachLogSite(void (*f)(void *context, const LogSite *site, int enabled), void *context) {
+
+    //
+    // copied so that f can log, which may need to register a new site
+    //
+    std::vector<LogSite *> sites;
+
+    {
+        std::lock_guard<std::mutex> lock(logSitesMutex);
+
+        sites = logSites;
+    }
+
+    for (LogSite *site : sites) {
+        f(context, site, (LoadSiteState(site) & LOGSITE_STATE_OUTPUT) != 0);
+    }
 }
 
 
@@ -0,0 +1,845 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/printf_args.h"
+
+#include <charconv> // for to_chars
+#include <climits> // for INT_MAX
+#include <cstdio> // for snprintf
+#include <cstring> // for memcpy, strlen
+#include <clocale> // for localeconv
+#include <cwchar> // for wint_t
+#include <type_traits> // for make_signed_t, make_unsigned_t
+
+
+#define TAG "printf_args"
+
+
+static bool Put8(uint8_t *dst, size_t dstLen, size_t *pos, const void *val) {
+
+    if (dstLen - *pos < 8) {
+        return false;
+    }
+
+    std::memcpy(dst + *pos, val, 8);
+    *pos += 8;
+
+    return true;
+}
+
+static bool PutInt(uint8_t *dst, size_t dstLen, size_t *pos, int64_t val) {
+    return Put8(dst, dstLen, pos, &val);
+}
+
+static bool PutString(uint8_t *dst, size_t dstLen, size_t *pos, const char *str, size_t len) {
+
+    if (len > PRINTF_ARGS_MAX_STRING) {
+        len = PRINTF_ARGS_MAX_STRING;
+    }
+
+    if (dstLen - *pos < 4 + len) {
+        return false;
+    }
+
+    auto len32 = static_cast<uint32_t>(len);
+    std::memcpy(dst + *pos, &len32, 4);
+    std::memcpy(dst + *pos + 4, str, len);
+    *pos += 4 + len;
+
+    return true;
+}
+
+
+size_t EncodePrintfArgs(const PrintfSpec *specs, size_t count, va_list args, uint8_t *dst, size_t dstLen, bool *overflow) {
+
+    size_t pos = 0;
+
+    *overflow = false;
+
+    for (size_t i = 0; i < count; i++) {
+
+        const PrintfSpec &spec = specs[i];
+
+        for (uint8_t s = 0; s < spec.starCount; s++) {
+            if (!PutInt(dst, dstLen, &pos, va_arg(args, int))) {
+                *overflow = true;
+                return 0;
+            }
+        }
+
+        bool ok = true;
+
+        switch (spec.kind) {
+            case PrintfArgKind::NONE: {
+                break;
+            }
+            case PrintfArgKind::INT: {
+                ok = PutInt(dst, dstLen, &pos, va_arg(args, int));
+                break;
+            }
+            case PrintfArgKind::LONG: {
+                ok = PutInt(dst, dstLen, &pos, va_arg(args, long)); // NOLINT(google-runtime-int)
+                break;
+            }
+            case PrintfArgKind::LONG_LONG: {
+                ok = PutInt(dst, dstLen, &pos, va_arg(args, long long)); // NOLINT(google-runtime-int)
+                break;
+            }
+            case PrintfArgKind::INTMAX: {
+                ok = PutInt(dst, dstLen, &pos, va_arg(args, intmax_t));
+                break;
+            }
+            case PrintfArgKind::SIZE: {
+                ok = PutInt(dst, dstLen, &pos, static_cast<int64_t>(va_arg(args, size_t)));
+                break;
+            }
+            case PrintfArgKind::PTRDIFF: {
+                ok = PutInt(dst, dstLen, &pos, va_arg(args, ptrdiff_t));
+                break;
+            }
+            case PrintfArgKind::DOUBLE: {
+                double d = va_arg(args, double);
+                ok = Put8(dst, dstLen, &pos, &d);
+                break;
+            }
+            case PrintfArgKind::LONG_DOUBLE: {
+
+                //
+                // precision beyond double is lost
+                //
+                auto d = static_cast<double>(va_arg(args, long double));
+                ok = Put8(dst, dstLen, &pos, &d);
+                break;
+            }
+            case PrintfArgKind::STRING: {
+                const char *str = va_arg(args, const char *);
+                if (str == nullptr) {
+                    str = "(null)";
+                }
+                ok = PutString(dst, dstLen, &pos, str, std::strlen(str));
+                break;
+            }
+            case PrintfArgKind::POINTER:
+            case PrintfArgKind::WRITEBACK: {
+                auto p = reinterpret_cast<uintptr_t>(va_arg(args, void *));
+                ok = PutInt(dst, dstLen, &pos, static_cast<int64_t>(p));
+                break;
+            }
+            case PrintfArgKind::WINT: {
+                ok = PutInt(dst, dstLen, &pos, static_cast<int64_t>(va_arg(args, wint_t)));
+                break;
+            }
+            case PrintfArgKind::WSTRING: {
+
+                //
+                // keep ASCII, replace everything else
+                //
+                const wchar_t *wstr = va_arg(args, const wchar_t *);
+                char narrow[PRINTF_ARGS_MAX_STRING];
+                size_t len = 0;
+                if (wstr == nullptr) {
+                    len = static_cast<size_t>(std::snprintf(narrow, sizeof(narrow), "(null)"));
+                } else {
+                    while (wstr[len] != L'\0' && len < sizeof(narrow)) {
+                        narrow[len] = (0 <= wstr[len] && wstr[len] < 128) ? static_cast<char>(wstr[len]) : '?';
+                        len++;
+                    }
+                }
+                ok = PutString(dst, dstLen, &pos, narrow, len);
+                break;
+            }
+        }
+
+        if (!ok) {
+            *overflow = true;
+            return 0;
+        }
+    }
+
+    return pos;
+}
+
+
+static bool Get8(const uint8_t *src, size_t srcLen, size_t *pos, void *val) {
+
+    if (srcLen - *pos < 8) {
+        return false;
+    }
+
+    std::memcpy(val, src + *pos, 8);
+    *pos += 8;
+
+    return true;
+}
+
+template <typename U>
+static char *IntegerChars(char *first, char *last, char conversion, U u);
+
+static char *FloatChars(char *first, char *last, char conversion, int precision, double d);
+
+template <typename T>
+static int FormatOne(char *out, size_t outLen, const char *spec, uint8_t starCount, const int *stars, T value) {
+    switch (starCount) {
+        case 0:
+            return std::snprintf(out, outLen, spec, value);
+        case 1:
+            return std::snprintf(out, outLen, spec, stars[0], value);
+        default:
+            return std::snprintf(out, outLen, spec, stars[0], stars[1], value);
+    }
+}
+
+//
+// copy [first, last) to out the way snprintf would write it
+//
+static int CopyOne(char *out, size_t outLen, const char *first, const char *last) {
+
+    auto n = static_cast<size_t>(last - first);
+
+    if (outLen != 0) {
+        size_t copied = (n < outLen - 1) ? n : outLen - 1;
+        std::memcpy(out, first, copied);
+        out[copied] = '\0';
+    }
+
+    return static_cast<int>(n);
+}
+
+//
+// the signal-safe counterparts of FormatOne
+//
+// flags and width are ignored
+//
+// buf must hold at least 24 bytes, and the end of the text in buf is returned
+//
+static char *SignalSafeInteger(char *buf, const PrintfSpec &spec, int64_t v) {
+
+    char *last = buf + 24; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    char *end = nullptr;
+
+    switch (spec.kind) {
+        case PrintfArgKind::INT: {
+            if (spec.conversion == 'c') {
+                buf[0] = static_cast<char>(v);
+                return buf + 1; // NOLINT(*-pro-bounds-pointer-arithmetic)
+            }
+            end = IntegerChars(buf, last, spec.conversion, static_cast<unsigned int>(v));
+            break;
+        }
+        case PrintfArgKind::LONG: {
+            end = IntegerChars(buf, last, spec.conversion, static_cast<unsigned long>(v)); // NOLINT(google-runtime-int)
+            break;
+        }
+        case PrintfArgKind::LONG_LONG: {
+            end = IntegerChars(buf, last, spec.conversion, static_cast<unsigned long long>(v)); // NOLINT(google-runtime-int)
+            break;
+        }
+        case PrintfArgKind::INTMAX: {
+            end = IntegerChars(buf, last, spec.conversion, static_cast<uintmax_t>(v));
+            break;
+        }
+        case PrintfArgKind::SIZE: {
+            end = IntegerChars(buf, last, spec.conversion, static_cast<size_t>(v));
+            break;
+        }
+        case PrintfArgKind::PTRDIFF: {
+            end = IntegerChars(buf, last, spec.conversion, static_cast<std::make_unsigned_t<ptrdiff_t>>(v));
+            break;
+        }
+        case PrintfArgKind::POINTER: {
+            buf[0] = '0';
+            buf[1] = 'x';
+            end = std::to_chars(buf + 2, last, static_cast<uint64_t>(v), 16).ptr; // NOLINT(*-pro-bounds-pointer-arithmetic)
+            break;
+        }
+        case PrintfArgKind::WINT: {
+            buf[0] = (0 <= v && v < 128) ? static_cast<char>(v) : '?';
+            return buf + 1; // NOLINT(*-pro-bounds-pointer-arithmetic)
+        }
+        default: {
+
+            //
+            // WRITEBACK: nothing is printed for %n
+            //
+            break;
+        }
+    }
+
+    return (end != nullptr) ? end : buf;
+}
+
+//
+// buf must hold at least 128 bytes
+//
+// a value too long for buf is written with %e instead, and anything else that needs snprintf, such as %a, is written
+// as ?
+//
+static char *SignalSafeFloat(char *buf, const PrintfSpec &spec, double d) {
+
+    char *last = buf + 128; // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+    char *end = FloatChars(buf, last, spec.conversion, spec.precision, d);
+
+    if (end == nullptr) {
+        end = FloatChars(buf, last, 'e', spec.precision, d);
+    }
+
+    if (end == nullptr) {
+        buf[0] = '?';
+        end = buf + 1; // NOLINT(*-pro-bounds-pointer-arithmetic)
+    }
+
+    return end;
+}
+
+static size_t FormatEncoded(const char *fmt, const PrintfSpec *specs, size_t count, const uint8_t *src, size_t srcLen, char *out, size_t outLen, bool signalSafe) {
+
+    size_t outPos = 0;
+
+    auto append = [&](const char *s, size_t n) {
+        if (outPos < outLen) {
+            size_t room = outLen - outPos - 1;
+            std::memcpy(out + outPos, s, (n < room) ? n : room);
+        }
+        outPos += n;
+    };
+
+    size_t srcPos = 0;
+    size_t fmtPos = 0;
+
+    for (size_t i = 0; i < count; i++) {
+
+        const PrintfSpec &spec = specs[i];
+
+        append(fmt + fmtPos, spec.begin - fmtPos);
+        fmtPos = spec.end;
+
+        if (spec.kind == PrintfArgKind::NONE) {
+            if (spec.end - spec.begin == 2 && fmt[spec.begin + 1] == '%') {
+                append("%", 1);
+            }
+            continue;
+        }
+
+        int stars[2] = { 0, 0 };
+        bool ok = true;
+        for (uint8_t s = 0; s < spec.starCount && s < 2; s++) {
+            int64_t star = 0;
+            ok = ok && Get8(src, srcLen, &srcPos, &star);
+            stars[s] = static_cast<int>(star);
+        }
+
+        //
+        // copy of the spec so that it can be NUL-terminated
+        //
+        char specBuf[64];
+        size_t specLen = spec.end - spec.begin;
+        if (specLen >= sizeof(specBuf)) {
+            break;
+        }
+        std::memcpy(specBuf, fmt + spec.begin, specLen);
+        specBuf[specLen] = '\0';
+
+        char *dst = (outPos < outLen) ? out + outPos : nullptr;
+        size_t room = (outPos < outLen) ? outLen - outPos : 0;
+
+        int n = 0;
+
+        switch (spec.kind) {
+            case PrintfArgKind::NONE: {
+                break;
+            }
+            case PrintfArgKind::INT:
+            case PrintfArgKind::LONG:
+            case PrintfArgKind::LONG_LONG:
+            case PrintfArgKind::INTMAX:
+            case PrintfArgKind::SIZE:
+            case PrintfArgKind::PTRDIFF:
+            case PrintfArgKind::POINTER:
+            case PrintfArgKind::WINT:
+            case PrintfArgKind::WRITEBACK: {
+
+                int64_t v; // NOLINT(*-init-variables)
+                ok = ok && Get8(src, srcLen, &srcPos, &v);
+                if (!ok) {
+                    break;
+                }
+
+                if (signalSafe) {
+                    char num[24];
+                    n = CopyOne(dst, room, num, SignalSafeInteger(num, spec, v));
+                    break;
+                }
+
+                switch (spec.kind) {
+                    case PrintfArgKind::INT:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<int>(v));
+                        break;
+                    case PrintfArgKind::LONG:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<long>(v)); // NOLINT(google-runtime-int)
+                        break;
+                    case PrintfArgKind::LONG_LONG:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<long long>(v)); // NOLINT(google-runtime-int)
+                        break;
+                    case PrintfArgKind::INTMAX:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<intmax_t>(v));
+                        break;
+                    case PrintfArgKind::SIZE:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<size_t>(v));
+                        break;
+                    case PrintfArgKind::PTRDIFF:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<ptrdiff_t>(v));
+                        break;
+                    case PrintfArgKind::POINTER:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, reinterpret_cast<void *>(static_cast<uintptr_t>(v))); // NOLINT(performance-no-int-to-ptr)
+                        break;
+                    case PrintfArgKind::WINT:
+                        n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<wint_t>(v));
+                        break;
+                    default:
+
+                        //
+                        // WRITEBACK: nothing is printed for %n
+                        //
+                        break;
+                }
+                break;
+            }
+            case PrintfArgKind::DOUBLE:
+            case PrintfArgKind::LONG_DOUBLE: {
+
+                double d; // NOLINT(*-init-variables)
+                ok = ok && Get8(src, srcLen, &srcPos, &d);
+                if (!ok) {
+                    break;
+                }
+
+                if (signalSafe) {
+                    char num[128];
+                    n = CopyOne(dst, room, num, SignalSafeFloat(num, spec, d));
+                    break;
+                }
+
+                if (spec.kind == PrintfArgKind::DOUBLE) {
+                    n = FormatOne(dst, room, specBuf, spec.starCount, stars, d);
+                } else {
+                    n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<long double>(d));
+                }
+                break;
+            }
+            case PrintfArgKind::STRING:
+            case PrintfArgKind::WSTRING: {
+
+                uint32_t len; // NOLINT(*-init-variables)
+                if (!ok || srcLen - srcPos < 4) {
+                    ok = false;
+                    break;
+                }
+                std::memcpy(&len, src + srcPos, 4);
+                srcPos += 4;
+                if (srcLen - srcPos < len || len > PRINTF_ARGS_MAX_STRING) {
+                    ok = false;
+                    break;
+                }
+
+                char str[PRINTF_ARGS_MAX_STRING + 1];
+                std::memcpy(str, src + srcPos, len);
+                str[len] = '\0';
+                srcPos += len;
+
+                if (signalSafe) {
+                    size_t shown = (0 <= spec.precision && static_cast<size_t>(spec.precision) < len) ? static_cast<size_t>(spec.precision) : len;
+                    n = CopyOne(dst, room, str, str + shown);
+                    break;
+                }
+
+                if (spec.kind == PrintfArgKind::WSTRING) {
+
+                    //
+                    // stored narrow, so drop the l from %ls
+                    //
+                    specBuf[specLen - 2] = 's';
+                    specBuf[specLen - 1] = '\0';
+                }
+
+                n = FormatOne(dst, room, specBuf, spec.starCount, stars, static_cast<const char *>(str));
+                break;
+            }
+        }
+
+        if (!ok) {
+            break;
+        }
+
+        if (n > 0) {
+            outPos += static_cast<size_t>(n);
+        }
+    }
+
+    if (fmt[fmtPos] != '\0' && (count == 0 || fmtPos == specs[count - 1].end)) {
+        append(fmt + fmtPos, std::strlen(fmt + fmtPos));
+    }
+
+    if (outLen != 0) {
+        out[(outPos < outLen) ? outPos : outLen - 1] = '\0';
+    }
+
+    return outPos;
+}
+
+size_t FormatEncodedPrintfArgs(const char *fmt, const PrintfSpec *specs, size_t count, const uint8_t *src, size_t srcLen, char *out, size_t outLen) {
+    return FormatEncoded(fmt, specs, count, src, srcLen, out, outLen, false);
+}
+
+size_t FormatEncodedPrintfArgsSignalSafe(const char *fmt, const PrintfSpec *specs, size_t count, const uint8_t *src, size_t srcLen, char *out, size_t outLen) {
+    return FormatEncoded(fmt, specs, count, src, srcLen, out, outLen, true);
+}
+
+
+static void ToUpper(char *first, char *last) {
+    for (char *p = first; p < last; p++) { // NOLINT(*-pro-bounds-pointer-arithmetic)
+        if ('a' <= *p && *p <= 'z') {
+            *p = static_cast<char>(*p - 'a' + 'A');
+        }
+    }
+}
+
+//
+// %d %i %u %o %x %X
+//
+// returns nullptr for anything else
+//
+template <typename U>
+static char *IntegerChars(char *first, char *last, char conversion, U u) {
+
+    std::to_chars_result r{};
+
+    switch (conversion) {
+        case 'd':
+        case 'i':
+            r = std::to_chars(first, last, static_cast<std::make_signed_t<U>>(u));
+            break;
+        case 'u':
+            r = std::to_chars(first, last, u);
+            break;
+        case 'o':
+            r = std::to_chars(first, last, u, 8);
+            break;
+        case 'x':
+        case 'X':
+            r = std::to_chars(first, last, u, 16);
+            break;
+        default:
+            return nullptr;
+    }
+
+    if (r.ec != std::errc()) {
+        return nullptr;
+    }
+
+    if (conversion == 'X') {
+        ToUpper(first, r.ptr);
+    }
+
+    return r.ptr;
+}
+
+//
+// std::to_chars always writes '.', but printf uses the decimal point of the current locale
+//
+static bool DecimalPointIsDot() {
+
+    const char *point = std::localeconv()->decimal_point;
+
+    return point[0] == '.' && point[1] == '\0';
+}
+
+//
+// %f %F %e %E %g %G
+//
+// returns nullptr for anything else, or if last - first is too small, or if floating point std::to_chars is not
+// available (such as libc++ before macOS 13.3)
+//
+static char *FloatChars(char *first, char *last, char conversion, int precision, double d) {
+
+#if defined(__cpp_lib_to_chars)
+
+    std::chars_format format; // NOLINT(*-init-variables)
+
+    switch (conversion) {
+        case 'f':
+        case 'F':
+            format = std::chars_format::fixed;
+            break;
+        case 'e':
+        case 'E':
+            format = std::chars_format::scientific;
+            break;
+        case 'g':
+        case 'G':
+            format = std::chars_format::general;
+            break;
+        default:
+            return nullptr;
+    }
+
+    std::to_chars_result r = std::to_chars(first, last, d, format, (precision < 0) ? 6 : precision);
+
+    if (r.ec != std::errc()) {
+        return nullptr;
+    }
+
+    if ('A' <= conversion && conversion <= 'Z') {
+        ToUpper(first, r.ptr);
+    }
+
+    return r.ptr;
+
+#else
+
+    (void)first;
+    (void)last;
+    (void)conversion;
+    (void)precision;
+    (void)d;
+
+    return nullptr;
+
+#endif // defined(__cpp_lib_to_chars)
+}
+
+int FormatPrintfV(char *out, size_t outLen, const char *fmt, const PrintfFormat *format, va_list args) {
+
+    if (format == nullptr || !format->direct) {
+        return std::vsnprintf(out, outLen, fmt, args);
+    }
+
+    size_t outPos = 0;
+    bool failed = false;
+
+    //
+    // -1 until the first float
+    //
+    int decimalPointIsDot = -1;
+
+    auto append = [&](const char *s, size_t n) {
+        if (outPos < outLen) {
+            size_t room = outLen - outPos - 1;
+            std::memcpy(out + outPos, s, (n < room) ? n : room);
+        }
+        outPos += n;
+    };
+
+    size_t fmtPos = 0;
+
+    for (size_t i = 0; i < format->count; i++) {
+
+        const PrintfSpec &spec = format->specs[i];
+
+        append(fmt + fmtPos, spec.begin - fmtPos);
+        fmtPos = spec.end;
+
+        if (spec.kind == PrintfArgKind::NONE) {
+
+            //
+            // direct formats have no unknown conversions, so this is %%
+            //
+            append("%", 1);
+            continue;
+        }
+
+        int stars[2] = { 0, 0 };
+        for (uint8_t s = 0; s < spec.starCount && s < 2; s++) {
+            stars[s] = va_arg(args, int);
+        }
+
+        //
+        // hand this one conversion to snprintf
+        //
+        auto slow = [&](auto value) {
+
+            char specBuf[PRINTF_ARGS_MAX_SPEC + 1];
+            size_t specLen = spec.end - spec.begin;
+            std::memcpy(specBuf, fmt + spec.begin, specLen);
+            specBuf[specLen] = '\0';
+
+            char *dst = (outPos < outLen) ? out + outPos : nullptr;
+            size_t room = (outPos < outLen) ? outLen - outPos : 0;
+
+            int n = FormatOne(dst, room, specBuf, spec.starCount, stars, value);
+
+            if (n < 0) {
+                failed = true;
+                return;
+            }
+
+            outPos += static_cast<size_t>(n);
+        };
+
+        char num[128];
+        char *numEnd = nullptr;
+
+        auto integer = [&](auto u) {
+
+            if (spec.plain && spec.precision < 0) {
+                if (spec.conversion == 'c') {
+                    num[0] = static_cast<char>(u);
+                    numEnd = num + 1;
+                } else {
+                    numEnd = IntegerChars(num, num + sizeof(num), spec.conversion, u);
+                }
+            }
+
+            if (numEnd == nullptr) {
+                slow(u);
+            }
+        };
+
+        switch (spec.kind) {
+            case PrintfArgKind::NONE: {
+                break;
+            }
+            case PrintfArgKind::INT: {
+                integer(va_arg(args, unsigned int));
+                break;
+            }
+            case PrintfArgKind::LONG: {
+                integer(va_arg(args, unsigned long)); // NOLINT(google-runtime-int)
+                break;
+            }
+            case PrintfArgKind::LONG_LONG: {
+                integer(va_arg(args, unsigned long long)); // NOLINT(google-runtime-int)
+                break;
+            }
+            case PrintfArgKind::INTMAX: {
+                integer(va_arg(args, uintmax_t));
+                break;
+            }
+            case PrintfArgKind::SIZE: {
+                integer(va_arg(args, size_t));
+                break;
+            }
+            case PrintfArgKind::PTRDIFF: {
+                integer(va_arg(args, std::make_unsigned_t<ptrdiff_t>));
+                break;
+            }
+            case PrintfArgKind::DOUBLE: {
+
+                double d = va_arg(args, double);
+
+                //
+                // the locale is looked up once per call, and only if there is a float
+                //
+                if (decimalPointIsDot < 0) {
+                    decimalPointIsDot = DecimalPointIsDot() ? 1 : 0;
+                }
+
+                if (spec.plain && decimalPointIsDot == 1) {
+                    numEnd = FloatChars(num, num + sizeof(num), spec.conversion, spec.precision, d);
+                }
+
+                if (numEnd == nullptr) {
+                    slow(d);
+                }
+                break;
+            }
+            case PrintfArgKind::LONG_DOUBLE: {
+                slow(va_arg(args, long double));
+                break;
+            }
+            case PrintfArgKind::STRING: {
+
+                const char *str = va_arg(args, const char *);
+
+                //
+                // printf decides what a null string looks like
+                //
+                if (!spec.plain || str == nullptr) {
+                    slow(str);
+                    break;
+                }
+
+                size_t len = 0;
+                if (spec.precision < 0) {
+                    len = std::strlen(str);
+                } else {
+
+                    //
+                    // str does not have to be NUL-terminated within precision
+                    //
+                    while (len < static_cast<size_t>(spec.precision) && str[len] != '\0') {
+                        len++;
+                    }
+                }
+
+                append(str, len);
+                break;
+            }
+            case PrintfArgKind::POINTER: {
+                slow(va_arg(args, void *));
+                break;
+            }
+            case PrintfArgKind::WINT: {
+                slow(static_cast<wint_t>(va_arg(args, wint_t)));
+                break;
+            }
+            case PrintfArgKind::WSTRING: {
+                slow(va_arg(args, const wchar_t *));
+                break;
+            }
+            case PrintfArgKind::WRITEBACK: {
+
+                //
+                // not direct
+                //
+                break;
+            }
+        }
+
+        if (numEnd != nullptr) {
+            append(num, static_cast<size_t>(numEnd - num));
+        }
+    }
+
+    append(fmt + fmtPos, std::strlen(fmt + fmtPos));
+
+    if (outLen != 0) {
+        out[(outPos < outLen) ? outPos : outLen - 1] = '\0';
+    }
+
+    if (failed || outPos > INT_MAX) {
+        return -1;
+    }
+
+    return static_cast<int>(outPos);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
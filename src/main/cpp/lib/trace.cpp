@@ -0,0 +1,362 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#if _MSC_VER
+#define _CRT_SECURE_NO_DEPRECATE // disable warnings about fopen being insecure on MSVC
+#endif // _MSC_VER
+
+#include "common/trace.h"
+
+#undef NDEBUG
+
+#include "common/check.h"
+#include "common/error.h"
+#include "common/logging.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cerrno>
+#include <cinttypes> // for PRId64
+#include <cstdio> // for fopen, fprintf
+#include <cstring> // for strerror
+
+
+#define TAG "trace"
+
+
+using enum Status;
+
+
+constexpr size_t TRACE_CHUNK_SPANS = 4096;
+
+
+struct TraceSpanRecord {
+    const char *name;
+    const char *tag;
+    int64_t beginMicros;
+    int64_t durationMicros;
+};
+
+//
+// appended to only by the owning thread, count is published with release so that WriteChromeTrace can read
+// while the thread keeps appending
+//
+struct TraceChunk {
+    TraceSpanRecord spans[TRACE_CHUNK_SPANS];
+    std::atomic<size_t> count;
+    std::atomic<TraceChunk *> next;
+};
+
+struct TraceThreadBuffer {
+    unsigned int thread;
+
+    //
+    // generation of the spans in the chunks, changed with traceMutex held
+    //
+    uint32_t generation;
+
+    //
+    // changed with traceMutex held
+    //
+    TraceChunk *head;
+
+    //
+    // only used by the owning thread
+    //
+    TraceChunk *tail;
+    size_t total;
+
+    //
+    // set with traceMutex held when the owning thread exits
+    //
+    bool exited;
+};
+
+
+//
+// protects traceBuffers, and resetting or starting a buffer
+//
+static std::mutex traceMutex;
+
+static std::vector<TraceThreadBuffer *> traceBuffers;
+
+static std::atomic<bool> tracing = false;
+
+//
+// incremented by every StartTracing
+//
+static std::atomic<uint32_t> traceGeneration = 0;
+
+static std::atomic<size_t> traceDropped = 0;
+
+
+static void FreeChunks(TraceThreadBuffer *b) {
+
+    TraceChunk *c = b->head;
+
+    while (c != nullptr) {
+        TraceChunk *next = c->next.load(std::memory_order_relaxed);
+        delete c;
+        c = next;
+    }
+
+    b->head = nullptr;
+    b->tail = nullptr;
+    b->total = 0;
+}
+
+
+//
+// registers the calling thread's buffer
+//
+// the buffer outlives the thread so that its spans can still be written, and is freed by the next StartTracing
+//
+class TraceThreadBufferHolder {
+public:
+
+    TraceThreadBuffer *buffer;
+
+    TraceThreadBufferHolder() :
+        buffer(new TraceThreadBuffer()) {
+
+        buffer->thread = LogThreadNumber();
+
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        traceBuffers.push_back(buffer);
+    }
+
+    ~TraceThreadBufferHolder() {
+
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        buffer->exited = true;
+    }
+};
+
+static TraceThreadBuffer *GetThreadBuffer() {
+
+    //
+    // allocated on first use so that threads that are never traced do not pay for the buffer
+    //
+    static thread_local TraceThreadBufferHolder holder;
+
+    return holder.buffer;
+}
+
+
+Status StartTracing() {
+
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        traceGeneration.fetch_add(1, std::memory_order_acq_rel);
+
+        std::erase_if(traceBuffers, [](TraceThreadBuffer *b) {
+
+            if (!b->exited) {
+
+                //
+                // the owning thread resets its own buffer when it sees the new generation
+                //
+                return false;
+            }
+
+            FreeChunks(b);
+            delete b;
+
+            return true;
+        });
+
+        traceDropped.store(0, std::memory_order_relaxed);
+
+        tracing.store(true, std::memory_order_release);
+    }
+
+    RecomputeLogSiteStates();
+
+    return OK;
+}
+
+void StopTracing() {
+
+    tracing.store(false, std::memory_order_release);
+
+    RecomputeLogSiteStates();
+}
+
+bool IsTracing() {
+    return tracing.load(std::memory_order_acquire);
+}
+
+size_t TraceDroppedCount() {
+    return traceDropped.load(std::memory_order_relaxed);
+}
+
+
+void TraceSpan(const LogSite *site, const char *name, int64_t beginMicros, int64_t endMicros) {
+
+    //
+    // the site state may be a little behind StopTracing
+    //
+    if (!tracing.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    TraceThreadBuffer *b = GetThreadBuffer();
+
+    uint32_t generation = traceGeneration.load(std::memory_order_acquire);
+
+    if (b->generation != generation) {
+
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        FreeChunks(b);
+        b->generation = generation;
+    }
+
+    if (b->total >= TRACE_MAX_SPANS_PER_THREAD) {
+        traceDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (b->tail == nullptr || b->tail->count.load(std::memory_order_relaxed) == TRACE_CHUNK_SPANS) {
+
+        auto *c = new TraceChunk();
+
+        if (b->tail == nullptr) {
+
+            std::lock_guard<std::mutex> lock(traceMutex);
+
+            b->head = c;
+
+        } else {
+
+            b->tail->next.store(c, std::memory_order_release);
+        }
+
+        b->tail = c;
+    }
+
+    TraceChunk *c = b->tail;
+
+    size_t n = c->count.load(std::memory_order_relaxed);
+
+    c->spans[n] = { name, site->tag, beginMicros, endMicros - beginMicros };
+
+    c->count.store(n + 1, std::memory_order_release);
+
+    b->total++;
+}
+
+
+//
+// function names and tags do not normally need escaping, but be safe
+//
+static void WriteJsonString(FILE *file, const char *str) {
+
+    std::fputc('"', file);
+
+    for (const char *p = str; *p != '\0'; p++) { // NOLINT(*-pro-bounds-pointer-arithmetic)
+
+        auto c = static_cast<unsigned char>(*p);
+
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+            std::fputc(c, file);
+        } else if (c < 0x20) {
+            std::fprintf(file, "\\u%04x", c);
+        } else {
+            std::fputc(c, file);
+        }
+    }
+
+    std::fputc('"', file);
+}
+
+Status WriteChromeTrace(const char *path) {
+
+    FILE *file = std::fopen(path, "w");
+
+    RETURN_ERR_IF_FALSE(file, "cannot open %s: %s (%s)", path, std::strerror(errno), ErrorName(errno));
+
+    std::fprintf(file, "{\"traceEvents\":[\n");
+
+    bool first = true;
+
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        uint32_t generation = traceGeneration.load(std::memory_order_acquire);
+
+        for (const TraceThreadBuffer *b : traceBuffers) {
+
+            if (b->generation != generation) {
+                continue;
+            }
+
+            for (TraceChunk *c = b->head; c != nullptr; c = c->next.load(std::memory_order_acquire)) {
+
+                size_t count = c->count.load(std::memory_order_acquire);
+
+                for (size_t i = 0; i < count; i++) {
+
+                    const TraceSpanRecord &span = c->spans[i];
+
+                    if (!first) {
+                        std::fprintf(file, ",\n");
+                    }
+                    first = false;
+
+                    std::fprintf(file, "{\"name\":");
+                    WriteJsonString(file, span.name);
+                    std::fprintf(file, ",\"cat\":");
+                    WriteJsonString(file, span.tag);
+                    std::fprintf(file, ",\"ph\":\"X\",\"ts\":%" PRId64 ",\"dur\":%" PRId64 ",\"pid\":1,\"tid\":%u}",
+                        span.beginMicros, span.durationMicros, b->thread);
+                }
+            }
+        }
+    }
+
+    std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    bool failed = (std::ferror(file) != 0);
+
+    std::fclose(file);
+
+    RETURN_ERR_IF_TRUE(failed, "error writing %s", path);
+
+    return OK;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -25,7 +25,7 @@
 #endif // IS_PLATFORM_ANDROID
 #include "common/logging.h"
 
-#include <string>
+#include <string_view>
 
 
 #define TAG "unusual_message"
@@ -44,7 +44,7 @@ void SetUnusualMessageCapturerWhileAborting(unusualMessageCapturer_decl capturer
 }
 
 
-void captureUnusualMessage(const std::string &message) {
+void captureUnusualMessage(std::string_view message) {
 
     if (unusualMessageCapturer == nullptr) {
         LOGE("cannot capture unusual message: unusualMessageCapturer is NULL");
@@ -55,7 +55,7 @@ void captureUnusualMessage(const std::string &message) {
 }
 
 
-void captureUnusualMessageWhileAborting(const std::string &message) {
+void captureUnusualMessageWhileAborting(std::string_view message) {
 
     if (unusualMessageCapturerWhileAborting == nullptr) {
         LOGE("cannot capture unusual message while aborting: unusualMessageCapturerWhileAborting is NULL");
@@ -0,0 +1,208 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//
+// common-logcat: read the shared-memory log ring written by StartSharedMemoryLogging
+//
+// usage: common-logcat [-f] [-l level] [-t tag] [-o output] name
+//
+// -f: keep reading new records until interrupted
+// -l: only records at level or more severe, one of F E W I D T
+// -t: only records with this TAG
+// -o: append to output instead of writing to stdout, to keep the records after the ring wraps
+//
+
+#if _MSC_VER
+#define _CRT_SECURE_NO_DEPRECATE // disable warnings about fopen being insecure on MSVC
+#endif // _MSC_VER
+
+#include "common/clock.h"
+#include "common/file.h"
+#include "common/log_shm_sink.h"
+#include "common/logging.h"
+#include "common/status.h"
+
+#include <chrono>
+#include <optional>
+#include <cinttypes> // for PRId64, PRIu64
+#include <span>
+#include <thread>
+#include <cstdio>
+#include <cstring> // for strcmp, strchr
+
+
+#define TAG "logcat"
+
+
+using enum Status;
+
+
+constexpr auto FOLLOW_POLL_INTERVAL = std::chrono::milliseconds(10);
+
+
+static const char LEVEL_CHARS[] = "FEWIDT";
+
+
+static void usage() {
+    std::fprintf(stderr, "usage: common-logcat [-f] [-l level] [-t tag] [-o output] name\n");
+}
+
+static char LevelChar(int level) {
+    if (level < LOGLEVEL_FATAL || level > LOGLEVEL_TRACE) {
+        return '?';
+    }
+    return LEVEL_CHARS[level - LOGLEVEL_FATAL]; // NOLINT(*-pro-bounds-constant-array-index)
+}
+
+static void Print(FILE *out, const SharedMemoryLogRecord &r) {
+
+    char date[FORMATTIME_LEN + 1];
+    formatTime(static_cast<time_t>(r.epochMillis / 1000), date, sizeof(date));
+
+    std::fprintf(out, "%s.%03" PRId64 " %" PRId64 ".%06" PRId64 " %u T%u %c/%.*s: %.*s%s\n",
+        date, r.epochMillis % 1000,
+        r.uptimeMicros / 1000000, r.uptimeMicros % 1000000,
+        r.pid, r.thread, LevelChar(r.level),
+        static_cast<int>(r.tag.size()), r.tag.data(),
+        static_cast<int>(r.text.size()), r.text.data(),
+        r.truncated ? " (truncated)" : "");
+}
+
+
+int main(int argc, char *argv[]) {
+
+    auto args = std::span(argv, static_cast<size_t>(argc)).subspan(1);
+
+    bool follow = false;
+    int maxLevel = LOGLEVEL_TRACE;
+    const char *tag = nullptr;
+    const char *output = nullptr;
+
+    while (!args.empty() && args[0][0] == '-') {
+
+        if (std::strcmp(args[0], "-f") == 0) {
+
+            follow = true;
+            args = args.subspan(1);
+
+        } else if (std::strcmp(args[0], "-l") == 0 && args.size() > 1) {
+
+            const char *c = (args[1][0] != '\0' && args[1][1] == '\0') ? std::strchr(LEVEL_CHARS, args[1][0]) : nullptr;
+            if (c == nullptr) {
+                usage();
+                return 2;
+            }
+            maxLevel = LOGLEVEL_FATAL + static_cast<int>(c - LEVEL_CHARS);
+            args = args.subspan(2);
+
+        } else if (std::strcmp(args[0], "-t") == 0 && args.size() > 1) {
+
+            tag = args[1];
+            args = args.subspan(2);
+
+        } else if (std::strcmp(args[0], "-o") == 0 && args.size() > 1) {
+
+            output = args[1];
+            args = args.subspan(2);
+
+        } else {
+
+            usage();
+            return 2;
+        }
+    }
+
+    if (args.size() != 1) {
+        usage();
+        return 2;
+    }
+
+    SharedMemoryLogReader reader;
+    if (reader.open(args[0]) != OK) {
+        return 1;
+    }
+
+    std::optional<ScopedFile> outFile;
+
+    FILE *out = stdout;
+
+    if (output != nullptr) {
+
+        outFile.emplace(output, "a");
+
+        out = outFile->get();
+        if (out == nullptr) {
+            return 1;
+        }
+    }
+
+    auto print = [out, maxLevel, tag](const SharedMemoryLogRecord &r) {
+
+        if (r.level > maxLevel) {
+            return;
+        }
+
+        if (tag != nullptr && r.tag != tag) {
+            return;
+        }
+
+        Print(out, r);
+    };
+
+    uint64_t lost = 0;
+
+    if (!follow) {
+
+        //
+        // a one-shot dump does not wait for records that are still being written
+        //
+        lost += reader.poll(print, true);
+
+    } else {
+
+        for (;;) {
+
+            lost += reader.poll(print, false);
+
+            std::fflush(out);
+
+            std::this_thread::sleep_for(FOLLOW_POLL_INTERVAL);
+        }
+    }
+
+    if (lost != 0) {
+        std::fprintf(stderr, "%" PRIu64 " records were overwritten before they could be read\n", lost);
+    }
+
+    return 0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
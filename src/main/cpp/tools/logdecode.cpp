@@ -0,0 +1,92 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//
+// common-logdecode: turn a binary log written by StartBinaryLogging back into text
+//
+// usage: common-logdecode [-t] input [output]
+//
+// -t: prefix each line with wall-clock time, level, and tag
+//
+
+#if _MSC_VER
+#define _CRT_SECURE_NO_DEPRECATE // disable warnings about fopen being insecure on MSVC
+#endif // _MSC_VER
+
+#include "common/binary_log.h"
+#include "common/file.h"
+#include "common/logging.h"
+#include "common/status.h"
+
+#include <span>
+#include <cstdio>
+#include <cstring> // for strcmp
+
+
+#define TAG "logdecode"
+
+
+using enum Status;
+
+
+int main(int argc, char *argv[]) {
+
+    auto args = std::span(argv, static_cast<size_t>(argc)).subspan(1);
+
+    bool timestamps = false;
+    if (!args.empty() && std::strcmp(args[0], "-t") == 0) {
+        timestamps = true;
+        args = args.subspan(1);
+    }
+
+    if (args.empty() || args.size() > 2) {
+        std::fprintf(stderr, "usage: common-logdecode [-t] input [output]\n");
+        return 2;
+    }
+
+    ScopedFile in{ args[0], "rb" };
+    if (in.get() == nullptr) {
+        return 1;
+    }
+
+    if (args.size() == 1) {
+        return (DecodeBinaryLog(in.get(), stdout, timestamps) == OK) ? 0 : 1;
+    }
+
+    ScopedFile out{ args[1], "w" };
+    if (out.get() == nullptr) {
+        return 1;
+    }
+
+    return (DecodeBinaryLog(in.get(), out.get(), timestamps) == OK) ? 0 : 1;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,574 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/Accumulator.h"
+#include "common/accumulator_kernels.h"
+#include "common/ConcurrentAccumulator.h"
+#include "common/logging.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <latch>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+#define TAG "AccumulatorTest"
+
+
+class AccumulatorTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+
+//        SetLogLevel(LOGLEVEL_TRACE);
+        SetLogLevel(LOGLEVEL_INFO);
+//        SetLogLevel(LOGLEVEL_ERROR);
+    }
+
+    static void TearDownTestSuite() {
+
+    }
+
+    void SetUp() override {
+
+    }
+
+    void TearDown() override {
+
+    }
+};
+
+
+//
+// the original copy-and-sort computation
+//
+static double ReferenceFilteredMean(std::vector<int64_t> tmp) {
+
+    double sum = 0.0;
+    for (int64_t x : tmp) {
+        sum += static_cast<double>(x);
+    }
+
+    double mean = sum / static_cast<double>(tmp.size());
+
+    sum = 0.0;
+    for (int64_t x : tmp) {
+        sum += (static_cast<double>(x) - mean) * (static_cast<double>(x) - mean);
+    }
+
+    double sd = std::sqrt(sum / static_cast<double>(tmp.size() - 1));
+
+    std::sort(tmp.begin(), tmp.end());
+
+    double median; // NOLINT(*-init-variables)
+    if (tmp.size() % 2 == 0) {
+        median = static_cast<double>(tmp[(tmp.size() - 1) / 2] + tmp[tmp.size() / 2]) / 2.0;
+    } else {
+        median = static_cast<double>(tmp[tmp.size() / 2]);
+    }
+
+    sum = 0.0;
+    size_t count = 0;
+    for (int64_t x : tmp) {
+        if (std::abs(static_cast<double>(x) - median) <= sd) {
+            sum += static_cast<double>(x);
+            count++;
+        }
+    }
+
+    return sum / static_cast<double>(count);
+}
+
+static double ReferenceMean(const std::vector<int64_t> &tmp) {
+
+    double sum = 0.0;
+    for (int64_t x : tmp) {
+        sum += static_cast<double>(x);
+    }
+
+    return sum / static_cast<double>(tmp.size());
+}
+
+
+static void CheckMatchesReference(AccumulatorMode mode) {
+
+    std::mt19937_64 gen(12345);
+
+    for (size_t capacity : { 1u, 2u, 3u, 10u, 64u, 1000u }) {
+
+        //
+        // a narrow range gives many duplicate samples, a wide one many outliers
+        //
+        for (int64_t range : { 5LL, 1000LL, 1000000000LL }) {
+
+            Accumulator acc(capacity, mode);
+
+            std::uniform_int_distribution<int64_t> dist(0, range);
+
+            for (int i = 0; i < 3000; i++) {
+
+                int64_t val = dist(gen);
+
+                //
+                // occasional spikes
+                //
+                if (i % 97 == 0) {
+                    val *= 50;
+                }
+
+                acc.push(val);
+
+                ASSERT_EQ(acc.last(), val);
+
+                std::vector<int64_t> window(acc.size());
+                size_t count = 0;
+                acc.copyContiguous(window, &count);
+
+                ASSERT_EQ(count, std::min(capacity, static_cast<size_t>(i + 1)));
+
+                double expectedMean = (count == 1) ? static_cast<double>(val) : ReferenceMean(window);
+                double expectedFiltered = (count == 1) ? static_cast<double>(val) : ReferenceFilteredMean(window);
+
+                double tolerance = 1e-9 * std::max(1.0, std::abs(expectedMean));
+
+                ASSERT_NEAR(acc.getMean(), expectedMean, tolerance) << capacity << " " << range << " " << i;
+                ASSERT_NEAR(acc.getFilteredMean(), expectedFiltered, tolerance) << capacity << " " << range << " " << i;
+            }
+        }
+    }
+}
+
+TEST_F(AccumulatorTest, matchesReference) {
+    CheckMatchesReference(AccumulatorMode::EAGER);
+}
+
+TEST_F(AccumulatorTest, lazyMatchesReference) {
+    CheckMatchesReference(AccumulatorMode::LAZY);
+}
+
+TEST_F(AccumulatorTest, lazyReadsAfterManyPushes) {
+
+    Accumulator eager(100);
+    Accumulator lazy(100, AccumulatorMode::LAZY);
+
+    for (int64_t i = 0; i < 10000; i++) {
+
+        int64_t val = (i * 7919) % 1000;
+
+        eager.push(val);
+        lazy.push(val);
+
+        if (i % 1000 == 999) {
+            EXPECT_NEAR(lazy.getFilteredMean(), eager.getFilteredMean(), 1e-9);
+            EXPECT_NEAR(lazy.getMean(), eager.getMean(), 1e-9);
+        }
+    }
+}
+
+
+static void CheckSamplesOneSdFromMedianAreKept(AccumulatorMode mode) {
+
+    //
+    // median 2, sd 2, so 0 and 4 are exactly on the edge
+    //
+    Accumulator acc(3, mode);
+
+    acc.push(2);
+    acc.push(4);
+    acc.push(0);
+
+    EXPECT_EQ(acc.getFilteredMean(), 2.0);
+
+    //
+    // and again after the window has moved
+    //
+    acc.push(12);
+    acc.push(14);
+    acc.push(10);
+
+    EXPECT_EQ(acc.getFilteredMean(), 12.0);
+    EXPECT_EQ(acc.getMean(), 12.0);
+}
+
+TEST_F(AccumulatorTest, samplesOneSdFromMedianAreKept) {
+    CheckSamplesOneSdFromMedianAreKept(AccumulatorMode::EAGER);
+    CheckSamplesOneSdFromMedianAreKept(AccumulatorMode::LAZY);
+}
+
+//
+// common::Accumulator<T, N>
+//
+
+static_assert(sizeof(common::Accumulator<float, 16>) == (16 * sizeof(float)) + (2 * sizeof(size_t)));
+static_assert(common::Accumulator<int64_t, 60>::capacity() == 60);
+
+template <size_t N>
+static void CheckFixedMatchesLazy() {
+
+    common::Accumulator<int64_t, N> fixed;
+    Accumulator lazy(N, AccumulatorMode::LAZY);
+
+    EXPECT_TRUE(fixed.empty());
+
+    std::mt19937_64 gen(N);
+    std::uniform_int_distribution<int64_t> dist(0, 1000);
+
+    for (int i = 0; i < 500; i++) {
+
+        int64_t val = dist(gen);
+
+        if (i % 31 == 0) {
+            val *= 20;
+        }
+
+        fixed.push(val);
+        lazy.push(val);
+
+        ASSERT_EQ(fixed.size(), lazy.size());
+        ASSERT_EQ(fixed.last(), val);
+        ASSERT_EQ(fixed.getMean(), lazy.getMean()) << N << " " << i;
+        ASSERT_EQ(fixed.getFilteredMean(), lazy.getFilteredMean()) << N << " " << i;
+
+        std::vector<int64_t> fixedWindow(N);
+        std::vector<int64_t> lazyWindow(N);
+        size_t fixedCount = 0;
+        size_t lazyCount = 0;
+        fixed.copyContiguous(fixedWindow, &fixedCount);
+        lazy.copyContiguous(lazyWindow, &lazyCount);
+
+        ASSERT_EQ(fixedCount, lazyCount);
+        ASSERT_EQ(fixedWindow, lazyWindow);
+    }
+}
+
+TEST_F(AccumulatorTest, fixedMatchesLazy) {
+
+    //
+    // powers of two use the mask
+    //
+    CheckFixedMatchesLazy<1>();
+    CheckFixedMatchesLazy<2>();
+    CheckFixedMatchesLazy<3>();
+    CheckFixedMatchesLazy<16>();
+    CheckFixedMatchesLazy<60>();
+    CheckFixedMatchesLazy<64>();
+}
+
+TEST_F(AccumulatorTest, fixedFloatingPoint) {
+
+    common::Accumulator<double, 4> d;
+    common::Accumulator<float, 3> f;
+
+    for (double x : { 1.5, 100.0, 2.5, 2.0, 3.0 }) {
+        d.push(x);
+        f.push(static_cast<float>(x));
+    }
+
+    //
+    // d holds 100, 2.5, 2, 3: median 2.75, sd about 48.7, so 100 is out
+    //
+    EXPECT_DOUBLE_EQ(d.getMean(), 107.5 / 4);
+    EXPECT_DOUBLE_EQ(d.getFilteredMean(), 2.5);
+    EXPECT_EQ(d.last(), 3.0);
+
+    //
+    // f holds 2.5, 2, 3: median 2.5, sd 0.5, so all are kept
+    //
+    EXPECT_DOUBLE_EQ(f.getMean(), 2.5);
+    EXPECT_DOUBLE_EQ(f.getFilteredMean(), 2.5);
+
+    f.push(40.0f);
+    f.push(2.0f);
+
+    //
+    // f holds 3, 40, 2: median 3, sd about 21.7, so 40 is out
+    //
+    EXPECT_DOUBLE_EQ(f.getFilteredMean(), 2.5);
+}
+
+//
+// SIMD kernels
+//
+
+TEST_F(AccumulatorTest, kernelsMatchScalar) {
+
+    auto available = GetAvailableAccumulatorKernels();
+
+    ASSERT_FALSE(available.empty());
+
+    const AccumulatorKernels *scalar = available[0];
+
+    EXPECT_STREQ(scalar->name, "scalar");
+    EXPECT_EQ(GetAccumulatorKernels(), available.back());
+
+    LOGI("kernels: %s", GetAccumulatorKernels()->name);
+
+    std::mt19937_64 gen(777);
+
+    //
+    // small values, where every sum is exact, and values over the whole int64 range, where the conversion to double
+    // rounds
+    //
+    std::uniform_int_distribution<int64_t> small(-1000, 1000);
+    std::uniform_int_distribution<int64_t> full(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+
+    for (bool exact : { true, false }) {
+
+        //
+        // lengths that leave every possible tail
+        //
+        for (size_t n = 0; n < 70; n++) {
+
+            std::vector<int64_t> x(n);
+            double absSum = 0.0;
+            for (int64_t &v : x) {
+                v = exact ? small(gen) : full(gen);
+                absSum += std::abs(static_cast<double>(v));
+            }
+
+            if (!exact && n >= 3) {
+                x[0] = std::numeric_limits<int64_t>::min();
+                x[1] = std::numeric_limits<int64_t>::max();
+                x[2] = -1;
+            }
+
+            std::span<const int64_t> xs(x);
+
+            double mean = (n == 0) ? 0.0 : (scalar->sum(xs) / static_cast<double>(n));
+
+            size_t expectedCount = 0;
+            double expectedNear = scalar->sumNear(xs, mean, absSum / static_cast<double>(std::max<size_t>(n, 1)), &expectedCount);
+
+            double expectedSquares = scalar->sumOfSquares(xs, mean);
+
+            for (const AccumulatorKernels *kernels : available) {
+
+                //
+                // sums of small integers are exact in any order, but the squares of x - mean are not
+                //
+                if (exact) {
+                    EXPECT_EQ(kernels->sum(xs), scalar->sum(xs)) << kernels->name << " " << n;
+                } else {
+                    EXPECT_NEAR(kernels->sum(xs), scalar->sum(xs), 1e-12 * absSum) << kernels->name << " " << n;
+                }
+
+                EXPECT_NEAR(kernels->sumOfSquares(xs, mean), expectedSquares, 1e-12 * expectedSquares) << kernels->name << " " << n;
+
+                size_t count = 0;
+                double near = kernels->sumNear(xs, mean, absSum / static_cast<double>(std::max<size_t>(n, 1)), &count);
+
+                EXPECT_EQ(count, expectedCount) << kernels->name << " " << n;
+                EXPECT_NEAR(near, expectedNear, 1e-12 * absSum) << kernels->name << " " << n;
+            }
+        }
+    }
+
+    //
+    // the conversion to double rounds exactly like static_cast<double>, adding zeros does not change the sum
+    //
+    for (int i = 0; i < 1000; i++) {
+
+        int64_t v = full(gen) >> (i % 64);
+
+        std::vector<int64_t> one = { v, 0, 0, 0, 0, 0, 0, 0 };
+
+        for (const AccumulatorKernels *kernels : available) {
+            ASSERT_EQ(kernels->sum(one), static_cast<double>(v)) << kernels->name << " " << v;
+        }
+    }
+
+    //
+    // the edge of the range is kept, as in the scalar code
+    //
+    std::vector<int64_t> edge = { 0, 2, 4, 6, 8, 10, -1, 11 };
+
+    for (const AccumulatorKernels *kernels : available) {
+
+        size_t count = 0;
+        EXPECT_EQ(kernels->sumNear(edge, 5.0, 5.0, &count), 30.0) << kernels->name;
+        EXPECT_EQ(count, 6u) << kernels->name;
+    }
+}
+
+TEST_F(AccumulatorTest, bulkPushMatchesSinglePushes) {
+
+    std::mt19937_64 gen(99);
+    std::uniform_int_distribution<int64_t> dist(0, 100000);
+
+    for (AccumulatorMode mode : { AccumulatorMode::EAGER, AccumulatorMode::LAZY }) {
+
+        Accumulator single(50, mode);
+        Accumulator bulk(50, mode);
+
+        //
+        // batches shorter than, equal to, and longer than the capacity
+        //
+        for (size_t batch : { 1u, 7u, 50u, 3u, 120u, 49u, 0u, 51u }) {
+
+            std::vector<int64_t> vals(batch);
+            for (int64_t &v : vals) {
+                v = dist(gen);
+                single.push(v);
+            }
+
+            bulk.push(std::span<const int64_t>(vals));
+
+            ASSERT_EQ(bulk.size(), single.size());
+
+            if (single.empty()) {
+                continue;
+            }
+
+            EXPECT_EQ(bulk.last(), single.last());
+            EXPECT_EQ(bulk.getMean(), single.getMean()) << batch;
+            EXPECT_EQ(bulk.getFilteredMean(), single.getFilteredMean()) << batch;
+
+            std::vector<int64_t> a(50);
+            std::vector<int64_t> b(50);
+            size_t ac = 0;
+            size_t bc = 0;
+            single.copyContiguous(a, &ac);
+            bulk.copyContiguous(b, &bc);
+
+            EXPECT_EQ(ac, bc);
+            EXPECT_EQ(a, b);
+        }
+    }
+}
+
+//
+// ConcurrentAccumulator
+//
+
+TEST_F(AccumulatorTest, concurrentSingleThread) {
+
+    ConcurrentAccumulator acc(1000);
+    Accumulator lazy(1000, AccumulatorMode::LAZY);
+
+    EXPECT_TRUE(acc.empty());
+
+    for (int64_t i = 1; i <= 100; i++) {
+        acc.push(i * i);
+        lazy.push(i * i);
+    }
+
+    EXPECT_EQ(acc.size(), 100u);
+    EXPECT_EQ(acc.getMean(), lazy.getMean());
+    EXPECT_EQ(acc.getFilteredMean(), lazy.getFilteredMean());
+
+    EXPECT_EQ(acc.getQuantile(0.0), 1);
+    EXPECT_EQ(acc.getQuantile(0.5), 50 * 50);
+    EXPECT_EQ(acc.getQuantile(0.9), 90 * 90);
+    EXPECT_EQ(acc.getQuantile(0.901), 91 * 91);
+    EXPECT_EQ(acc.getQuantile(1.0), 100 * 100);
+
+    double qs[] = { 0.1, 0.5, 0.5, 0.99 };
+    int64_t out[4];
+    acc.getQuantiles(qs, out);
+
+    EXPECT_EQ(out[0], 10 * 10);
+    EXPECT_EQ(out[1], 50 * 50);
+    EXPECT_EQ(out[2], 50 * 50);
+    EXPECT_EQ(out[3], 99 * 99);
+}
+
+TEST_F(AccumulatorTest, concurrentManyThreads) {
+
+    //
+    // each thread has its own shard, and each shard ends up holding 0 to 999 once
+    //
+    // the threads stay alive until all have pushed, because a thread that exits hands its shard to the next one
+    //
+    ConcurrentAccumulator acc(1000);
+
+    std::latch done(8);
+
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&acc, &done, t]() {
+            for (int64_t i = 0; i < 10000; i++) {
+                acc.push((i + (t * 1000)) % 1000);
+            }
+            done.arrive_and_wait();
+        });
+    }
+
+    //
+    // reading while pushing sees some of the samples
+    //
+    size_t seen = acc.size();
+    EXPECT_LE(seen, 8000u);
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(acc.size(), 8000u);
+    EXPECT_EQ(acc.getMean(), 499.5);
+    EXPECT_EQ(acc.getFilteredMean(), 499.5);
+    EXPECT_EQ(acc.getQuantile(0.5), 499);
+    EXPECT_EQ(acc.getQuantile(0.999), 998);
+}
+
+TEST_F(AccumulatorTest, concurrentSharedShard) {
+
+    //
+    // no shards of their own, so every thread goes through the shared shard
+    //
+    ConcurrentAccumulator acc(100, 0);
+
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&acc, t]() {
+            for (int64_t i = 0; i < 5000; i++) {
+                acc.push(t);
+            }
+        });
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(acc.size(), 100u);
+    EXPECT_GE(acc.getQuantile(0.0), 0);
+    EXPECT_LE(acc.getQuantile(1.0), 3);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -17,13 +17,18 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "common/clock.h"
+#include "common/FramePacer.h"
 #include "common/logging.h"
+#include "common/platform.h"
 
 #include "gtest/gtest.h"
 
 #include <thread> // for std::this_thread::sleep_for
 #include <chrono> // for std::chrono::seconds
+#include <cstdlib> // for setenv
+#include <ctime> // for strftime, tzset
 #include <locale>
+#include <string>
 
 
 #define TAG "ClockTest"
@@ -66,6 +71,141 @@ TEST_F(ClockTest, uptimeMillis) {
     EXPECT_LT(diff, 1000);
 }
 
+static_assert(std::chrono::is_clock_v<common::MonotonicClock>);
+static_assert(std::chrono::is_clock_v<common::FastClock>);
+static_assert(common::MonotonicClock::is_steady && !common::FastClock::is_steady);
+
+
+TEST_F(ClockTest, uptimeNanos) {
+
+    int64_t before = uptimeMicros();
+    int64_t nanos = uptimeNanos();
+    int64_t after = uptimeMicros();
+
+    EXPECT_GE(nanos / 1000, before);
+    EXPECT_LE(nanos / 1000, after);
+}
+
+TEST_F(ClockTest, chronoClocks) {
+
+    auto start = common::MonotonicClock::now();
+    auto fastStart = common::FastClock::now();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::chrono::nanoseconds elapsed = common::MonotonicClock::now() - start;
+    std::chrono::nanoseconds fastElapsed = common::FastClock::now() - fastStart;
+
+    EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(300));
+    EXPECT_GE(fastElapsed, std::chrono::milliseconds(99));
+    EXPECT_LT(fastElapsed, std::chrono::milliseconds(300));
+
+    //
+    // same epoch
+    //
+    auto diff = common::FastClock::now().time_since_epoch() - common::MonotonicClock::now().time_since_epoch();
+    EXPECT_LT(std::chrono::abs(diff), std::chrono::milliseconds(1));
+}
+
+TEST_F(ClockTest, uptimeNanosFast) {
+
+    LOGI("fastClockUsesCycles: %d", fastClockUsesCycles());
+
+    int64_t prev = uptimeNanosFast();
+
+    for (int i = 0; i < 1000000; i++) {
+        int64_t now = uptimeNanosFast();
+        ASSERT_GE(now, prev);
+        prev = now;
+    }
+
+    //
+    // tracks the monotonic clock across rechecks
+    //
+    for (int i = 0; i < 5; i++) {
+
+        int64_t before = uptimeMicros();
+        int64_t fast = uptimeNanosFast() / 1000;
+        int64_t after = uptimeMicros();
+
+        EXPECT_GE(fast, before - 1000);
+        EXPECT_LE(fast, after + 1000);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    int64_t start = uptimeNanosFast();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    int64_t diff = uptimeNanosFast() - start;
+
+    EXPECT_GE(diff, 200000000);
+    EXPECT_LT(diff, 400000000);
+}
+
+TEST_F(ClockTest, readCycles) {
+
+    uint64_t start = readCycles();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_GT(readCycles(), start);
+}
+
+TEST_F(ClockTest, uptimeMillisCoarse) {
+
+    EXPECT_EQ(GetCoarseClockSource(), COARSECLOCK_OFF);
+
+    for (int source : { COARSECLOCK_TICKER, COARSECLOCK_KERNEL, COARSECLOCK_AUTO }) {
+
+        StartCoarseClock(source);
+
+        int actual = GetCoarseClockSource();
+
+        if (source == COARSECLOCK_AUTO) {
+            EXPECT_TRUE(actual == COARSECLOCK_KERNEL || actual == COARSECLOCK_TICKER);
+        } else if (source == COARSECLOCK_TICKER) {
+            EXPECT_EQ(actual, COARSECLOCK_TICKER);
+        }
+
+        int64_t prev = uptimeMillisCoarse();
+
+        int64_t start = uptimeMillis();
+
+        while (uptimeMillis() - start < 50) {
+
+            int64_t coarse = uptimeMillisCoarse();
+            int64_t precise = uptimeMillis();
+
+            ASSERT_GE(coarse, prev);
+            ASSERT_LE(coarse, precise);
+
+            //
+            // a kernel tick is at most 10 ms, but the ticker thread may be preempted for a long time on a loaded
+            // machine, so this only catches a clock that is not running at all
+            //
+            ASSERT_GE(coarse, precise - 1000);
+
+            prev = coarse;
+        }
+
+        //
+        // the coarse clock catches up eventually
+        //
+        while (uptimeMillisCoarse() <= start && uptimeMillis() - start < 2000) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        EXPECT_GT(uptimeMillisCoarse(), start);
+
+        StopCoarseClock();
+
+        EXPECT_EQ(GetCoarseClockSource(), COARSECLOCK_OFF);
+    }
+}
+
 TEST_F(ClockTest, timeSinceEpoch) {
 
     int64_t start = timeSinceEpochSeconds();
@@ -99,6 +239,179 @@ TEST_F(ClockTest, formatTime) {
     LOGI("formatTime: buf: %s", buf);
 }
 
+#if !IS_PLATFORM_WINDOWS
+
+//
+// POSIX TZ strings, so that no time zone database is needed
+//
+static void SetTimeZone(const char *tz) {
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+TEST_F(ClockTest, formatTimeMatchesStrftime) {
+
+    const char *oldTz = std::getenv("TZ");
+    std::string savedTz = (oldTz != nullptr) ? oldTz : "";
+
+    //
+    // each zone gets its own years, because the UTC offset is cached for 15 minutes
+    //
+    struct Zone {
+        const char *tz;
+        int64_t start;
+    };
+
+    Zone zones[] = {
+        { "UTC0", 0 },
+        { "EST5EDT,M3.2.0,M11.1.0", 1000000000 }, // 2001
+        { "NPT-5:45", 1300000000 }, // 2011
+        { "AEST-10AEDT,M10.1.0,M4.1.0/3", 1600000000 }, // 2020
+        { "<-0330>3:30", -1000000000 }, // 1938
+    };
+
+    for (const Zone &zone : zones) {
+
+        SetTimeZone(zone.tz);
+
+        //
+        // steps of a little over 15 minutes for a year and a half, which crosses DST transitions
+        //
+        for (int64_t t = zone.start; t < zone.start + (548 * 86400); t += 901) {
+
+            auto timeV = static_cast<time_t>(t);
+
+            tm local;
+            ASSERT_NE(localtime_r(&timeV, &local), nullptr);
+
+            char expected[FORMATTIME_LEN + 1];
+            strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", &local);
+
+            char actual[FORMATTIME_LEN + 1];
+            formatTime(timeV, actual, sizeof(actual));
+
+            ASSERT_STREQ(actual, expected) << zone.tz << " " << t;
+        }
+    }
+
+    if (oldTz != nullptr) {
+        SetTimeZone(savedTz.c_str());
+    } else {
+        unsetenv("TZ");
+        tzset();
+    }
+}
+
+TEST_F(ClockTest, formatTimeIso8601) {
+
+    const char *oldTz = std::getenv("TZ");
+    std::string savedTz = (oldTz != nullptr) ? oldTz : "";
+
+    char buf[FORMATTIME_ISO8601_MICROS_LEN + 1];
+
+    SetTimeZone("UTC0");
+
+    formatTimeIso8601Millis(1735689599123, buf, FORMATTIME_ISO8601_MILLIS_LEN + 1);
+    EXPECT_STREQ(buf, "2024-12-31T23:59:59.123+00:00");
+
+    formatTimeIso8601Micros(1735689599123456, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "2024-12-31T23:59:59.123456+00:00");
+
+    //
+    // before 1970, the fraction still counts up from the second before
+    //
+    formatTimeIso8601Millis(-1, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "1969-12-31T23:59:59.999+00:00");
+
+    SetTimeZone("NPT-5:45");
+
+    formatTimeIso8601Millis(1704067199123, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "2024-01-01T05:44:59.123+05:45");
+
+    SetTimeZone("EST5");
+
+    formatTimeIso8601Micros(1672531200000001, buf, sizeof(buf));
+    EXPECT_STREQ(buf, "2022-12-31T19:00:00.000001-05:00");
+
+    if (oldTz != nullptr) {
+        SetTimeZone(savedTz.c_str());
+    } else {
+        unsetenv("TZ");
+        tzset();
+    }
+}
+
+#endif // !IS_PLATFORM_WINDOWS
+
+TEST_F(ClockTest, sleepUntilMicros) {
+
+    for (int i = 0; i < 50; i++) {
+
+        int64_t deadline = uptimeMicros() + 2000;
+
+        int64_t woke = sleepUntilMicros(deadline);
+
+        EXPECT_GE(woke, deadline);
+        EXPECT_LE(woke, uptimeMicros());
+    }
+
+    EXPECT_GE(sleepSpinMicros(), 50);
+    EXPECT_LE(sleepSpinMicros(), 2000);
+
+    //
+    // a deadline that has passed returns at once
+    //
+    int64_t now = uptimeMicros();
+
+    EXPECT_LT(sleepUntilMicros(now - 1000000) - now, 1000);
+}
+
+TEST_F(ClockTest, framePacer) {
+
+    //
+    // a loaded machine may wake late and skip deadlines, so check invariants rather than exact deadlines
+    //
+    FramePacer pacer(5000, 16);
+
+    int64_t first = pacer.waitForNextFrame();
+    int64_t prev = first;
+
+    for (int i = 1; i < 20; i++) {
+
+        int64_t missedBefore = pacer.missedFrames();
+
+        int64_t deadline = pacer.waitForNextFrame();
+
+        //
+        // in phase, increasing, and every skipped period is counted as missed
+        //
+        EXPECT_EQ((deadline - first) % 5000, 0);
+        EXPECT_GT(deadline, prev);
+        EXPECT_EQ(pacer.missedFrames() - missedBefore, ((deadline - prev) / 5000) - 1);
+        EXPECT_GE(uptimeMicros(), deadline);
+
+        prev = deadline;
+    }
+
+    EXPECT_EQ(pacer.getOvershoot().size(), 16u);
+    EXPECT_GE(pacer.getOvershoot().getMean(), 0.0);
+
+    //
+    // a frame that takes 2.5 periods skips at least 2 deadlines and stays in phase
+    //
+    int64_t missedBefore = pacer.missedFrames();
+
+    int64_t before = pacer.waitForNextFrame();
+
+    sleepUntilMicros(before + 12500);
+
+    int64_t after = pacer.waitForNextFrame();
+
+    EXPECT_EQ((after - first) % 5000, 0);
+    EXPECT_GE(after, before + (3 * 5000));
+    EXPECT_EQ(pacer.missedFrames() - missedBefore, (((before - prev) / 5000) - 1) + (((after - before) / 5000) - 1));
+}
+
 
 
 
@@ -0,0 +1,1334 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/binary_log.h"
+#include "common/file.h"
+#include "common/flight_recorder.h"
+#include "common/log_file_sink.h"
+#include "common/log_kv.h"
+#include "common/log_shm_sink.h"
+#include "common/log_stats.h"
+#include "common/logging.h"
+#include "common/string_utils.h"
+#include "common/trace.h"
+#include "common/unusual_message.h"
+
+#include "gtest/gtest.h"
+
+#include <unistd.h> // for getpid
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <regex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#define TAG "LoggingTest"
+
+
+using enum Status;
+
+
+class LoggingTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+
+//        SetLogLevel(LOGLEVEL_TRACE);
+        SetLogLevel(LOGLEVEL_INFO);
+//        SetLogLevel(LOGLEVEL_ERROR);
+    }
+    
+    static void TearDownTestSuite() {
+        
+    }
+    
+    void SetUp() override {
+        
+    }
+    
+    void TearDown() override {
+
+    }
+};
+
+
+static int sideEffectCount = 0;
+
+static int sideEffect() {
+    sideEffectCount++;
+    return sideEffectCount;
+}
+
+
+TEST_F(LoggingTest, asyncKeepsOrder) {
+
+    StartAsyncLogging(64, LOGASYNC_OVERFLOW_BLOCK);
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 1000; i++) {
+        LOGI("line %d", i);
+    }
+
+    FlushLogs();
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    StopAsyncLogging();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 1000);
+
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(lines[static_cast<size_t>(i)], "line " + std::to_string(i));
+    }
+}
+
+
+TEST_F(LoggingTest, asyncMultipleProducers) {
+
+    StartAsyncLogging(256, LOGASYNC_OVERFLOW_BLOCK);
+
+    testing::internal::CaptureStderr();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 500; i++) {
+                LOGI("thread %d line %d", t, i);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    FlushLogs();
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    StopAsyncLogging();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    EXPECT_EQ(lines.size(), 2000);
+}
+
+
+TEST_F(LoggingTest, asyncDropCountsMessages) {
+
+    StartAsyncLogging(4, LOGASYNC_OVERFLOW_DROP);
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 10000; i++) {
+        LOGI("line %d", i);
+    }
+
+    FlushLogs();
+
+    size_t dropped = AsyncLogDroppedCount();
+
+    StopAsyncLogging();
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    size_t written = 0;
+    for (const auto &line : split(out, '\n')) {
+        if (line.starts_with("line ")) {
+            written++;
+        }
+    }
+
+    EXPECT_EQ(written + dropped, 10000);
+}
+
+
+TEST_F(LoggingTest, asyncBlockKeepsEveryMessage) {
+
+    //
+    // a tiny ring, so producers keep waiting for room
+    //
+    StartAsyncLogging(4, LOGASYNC_OVERFLOW_BLOCK);
+
+    testing::internal::CaptureStderr();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 2000; i++) {
+                LOGI("thread %d line %d", t, i);
+            }
+        });
+    }
+
+    //
+    // stop while producers are still blocked on the full ring
+    //
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    StopAsyncLogging();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    //
+    // every message is written exactly once, either by the drainer or synchronously after the stop
+    //
+    std::set<std::string> unique(lines.begin(), lines.end());
+
+    EXPECT_EQ(lines.size(), 8000);
+    EXPECT_EQ(unique.size(), 8000);
+}
+
+
+//
+// a sink that logs and flushes from inside write, as a sink reporting its own errors would
+//
+static std::vector<std::string> reentrantSinkLines;
+
+static void ReentrantSinkWrite(void *context, int level, const char *tag, const char *buf, size_t len) {
+
+    (void)context;
+    (void)level;
+    (void)tag;
+
+    std::string line(buf, len);
+
+    reentrantSinkLines.push_back(line);
+
+    if (line.starts_with("outer ")) {
+        LOGW("inner %s", line.substr(6, line.size() - 7).c_str());
+        FlushLogs();
+    }
+}
+
+static const LogSink reentrantSink = { ReentrantSinkWrite, nullptr, nullptr };
+
+TEST_F(LoggingTest, asyncSinkThatLogsDoesNotDeadlock) {
+
+    reentrantSinkLines.clear();
+
+    SetLogSink(&reentrantSink);
+
+    //
+    // a tiny ring with BLOCK, so a push from the drainer would wait for itself
+    //
+    StartAsyncLogging(2, LOGASYNC_OVERFLOW_BLOCK);
+
+    for (int i = 0; i < 100; i++) {
+        LOGI("outer %d", i);
+    }
+
+    FlushLogs();
+
+    StopAsyncLogging();
+
+    SetLogSink(nullptr);
+
+    size_t outer = 0;
+    size_t inner = 0;
+    for (const std::string &line : reentrantSinkLines) {
+        if (line.starts_with("outer ")) {
+            outer++;
+        } else if (line.starts_with("inner ")) {
+            inner++;
+        }
+    }
+
+    EXPECT_EQ(outer, 100u);
+    EXPECT_EQ(inner, 100u);
+}
+
+
+TEST_F(LoggingTest, binaryRoundTrip) {
+
+    std::string binPath = (std::filesystem::temp_directory_path() / "common_test_binary.log").string();
+    std::string textPath = (std::filesystem::temp_directory_path() / "common_test_binary.txt").string();
+
+    ASSERT_EQ(StartBinaryLogging(binPath.c_str()), OK);
+
+    EXPECT_TRUE(IsBinaryLogging());
+
+    for (int i = 0; i < 3; i++) {
+        LOGI("frame %d took %.2f ms in %s", i, 16.5 + i, "render");
+    }
+
+    std::thread t([]() {
+        LOGW("from thread %s", "worker");
+    });
+    t.join();
+
+    //
+    // below current level: not recorded
+    //
+    LOGD("debug %d", 1);
+
+    StopBinaryLogging();
+
+    EXPECT_FALSE(IsBinaryLogging());
+
+    {
+        ScopedFile in{ binPath.c_str(), "rb" };
+        ScopedFile out{ textPath.c_str(), "w" };
+        ASSERT_EQ(DecodeBinaryLog(in.get(), out.get(), false), OK);
+    }
+
+    std::vector<uint8_t> text;
+    ASSERT_EQ(openFile(textPath.c_str(), text), OK);
+
+    std::string str(text.begin(), text.end());
+
+    //
+    // the worker thread buffer is flushed when the thread exits, before the main thread buffer
+    //
+    EXPECT_EQ(str,
+        "from thread worker\n"
+        "frame 0 took 16.50 ms in render\n"
+        "frame 1 took 17.50 ms in render\n"
+        "frame 2 took 18.50 ms in render\n");
+
+    EXPECT_EQ(deleteFile(binPath.c_str()), OK);
+    EXPECT_EQ(deleteFile(textPath.c_str()), OK);
+}
+
+
+//
+// a header followed by one record with an out of range length or id
+//
+static Status DecodeCorruptBinaryLog(uint8_t type, uint32_t id, uint32_t length) {
+
+    FILE *in = std::tmpfile();
+    FILE *out = std::tmpfile();
+
+    int64_t zero = 0;
+    std::fwrite(BINARY_LOG_MAGIC, 1, 8, in);
+    std::fwrite(&zero, 8, 1, in);
+    std::fwrite(&zero, 8, 1, in);
+
+    std::fwrite(&type, 1, 1, in);
+    std::fwrite(&id, 4, 1, in);
+    if (type == BINARY_LOG_RECORD_SITE) {
+        int32_t levelAndLine[2] = { LOGLEVEL_INFO, 1 };
+        std::fwrite(levelAndLine, 4, 2, in);
+    } else {
+        std::fwrite(&zero, 8, 1, in);
+    }
+    std::fwrite(&length, 4, 1, in);
+
+    std::rewind(in);
+
+    Status res = DecodeBinaryLog(in, out, false);
+
+    std::fclose(in);
+    std::fclose(out);
+
+    return res;
+}
+
+TEST_F(LoggingTest, binaryDecodeRejectsCorruptSizes) {
+
+    EXPECT_EQ(DecodeCorruptBinaryLog(BINARY_LOG_RECORD_SITE, UINT32_MAX, 0), ERR);
+    EXPECT_EQ(DecodeCorruptBinaryLog(BINARY_LOG_RECORD_SITE, 1, UINT32_MAX), ERR);
+    EXPECT_EQ(DecodeCorruptBinaryLog(BINARY_LOG_RECORD_EVENT, 1, UINT32_MAX), ERR);
+}
+
+
+
+TEST_F(LoggingTest, directCallsFollowGlobalLevel) {
+
+    testing::internal::CaptureStderr();
+
+    LOGD_expanded(TAG, "direct debug\n");
+    LOGI_expanded(TAG, "direct info\n");
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(out.find("direct debug"), std::string::npos);
+    EXPECT_NE(out.find("direct info"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, everyN) {
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 10; i++) {
+        LOGW_EVERY_N(3, "every 3: %d", i);
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 7);
+    EXPECT_NE(lines[0].find("every 3: 0"), std::string::npos);
+    EXPECT_NE(lines[1].find("suppressed 2 messages"), std::string::npos);
+    EXPECT_NE(lines[2].find("every 3: 3"), std::string::npos);
+    EXPECT_NE(lines[6].find("every 3: 9"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, everyNWithoutPositiveN) {
+
+    testing::internal::CaptureStderr();
+
+    int n = 0;
+
+    for (int i = 0; i < 3; i++) {
+        LOGW_EVERY_N(n, "every 0: %d", i);
+    }
+
+    n = -5;
+
+    for (int i = 0; i < 3; i++) {
+        LOGW_EVERY_N(n, "every -5: %d", i);
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    //
+    // every message is logged, and nothing is reported as suppressed
+    //
+    ASSERT_EQ(lines.size(), 6);
+    EXPECT_NE(lines[2].find("every 0: 2"), std::string::npos);
+    EXPECT_NE(lines[5].find("every -5: 2"), std::string::npos);
+    EXPECT_EQ(out.find("suppressed"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, fileSinkRotates) {
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "common_test_file_sink";
+
+    std::filesystem::remove_all(dir);
+
+    //
+    // every line is 20 bytes, so 50 lines fill a segment
+    //
+    ASSERT_EQ(StartFileLogging(dir.string().c_str(), 1000, 3), OK);
+
+    for (int i = 0; i < 200; i++) {
+        LOGI("file sink line %04d", i);
+    }
+
+    StopFileLogging();
+
+    EXPECT_FALSE(fileExists((dir / "log-00000000.txt").string().c_str()));
+
+    std::string text;
+    for (int i = 1; i < 4; i++) {
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "log-%08d.txt", i);
+
+        std::vector<uint8_t> buf;
+        ASSERT_EQ(openFile((dir / name).string().c_str(), buf), OK);
+
+        text.append(buf.begin(), buf.end());
+    }
+
+    std::vector<std::string> lines = split(text, '\n');
+
+    ASSERT_EQ(lines.size(), 150);
+    EXPECT_EQ(lines[0], "file sink line 0050");
+    EXPECT_EQ(lines[149], "file sink line 0199");
+
+    std::filesystem::remove_all(dir);
+}
+
+
+TEST_F(LoggingTest, fileSinkTruncatesUnevenSegments) {
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "common_test_file_sink_uneven";
+
+    std::filesystem::remove_all(dir);
+
+    //
+    // lines of 7 to 16 bytes, so segments do not fill exactly
+    //
+    ASSERT_EQ(StartFileLogging(dir.string().c_str(), 1000, 100), OK);
+
+    std::string expected;
+    for (int i = 0; i < 300; i++) {
+        std::string line = "x" + std::string(static_cast<size_t>(i % 10), '-') + std::to_string(i);
+        LOGI("%s", line.c_str());
+        expected += line + "\n";
+    }
+
+    StopFileLogging();
+
+    std::string text;
+    size_t segments = 0;
+    for (int i = 0;; i++) {
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "log-%08d.txt", i);
+
+        if (!fileExists((dir / name).string().c_str())) {
+            break;
+        }
+
+        std::vector<uint8_t> buf;
+        ASSERT_EQ(openFile((dir / name).string().c_str(), buf), OK);
+
+        EXPECT_LE(buf.size(), 1000u);
+        EXPECT_EQ(std::count(buf.begin(), buf.end(), 0), 0) << name;
+
+        text.append(buf.begin(), buf.end());
+        segments++;
+    }
+
+    EXPECT_GT(segments, 1u);
+    EXPECT_EQ(text, expected);
+
+    std::filesystem::remove_all(dir);
+}
+
+
+TEST_F(LoggingTest, fileSinkKeepsMessageWhenRotationFails) {
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "common_test_file_sink_fail";
+
+    std::filesystem::remove_all(dir);
+
+    ASSERT_EQ(StartFileLogging(dir.string().c_str(), 1000, 3), OK);
+
+    //
+    // the next segment cannot be created, and the error about it is logged from inside the sink
+    //
+    std::filesystem::remove_all(dir);
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 51; i++) {
+        LOGI("file sink line %04d", i);
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    StopFileLogging();
+
+    EXPECT_NE(out.find("cannot open"), std::string::npos);
+    EXPECT_NE(out.find("file sink line 0050\n"), std::string::npos) << out;
+
+    std::filesystem::remove_all(dir);
+}
+
+
+TEST_F(LoggingTest, kvWritesJsonLines) {
+
+    testing::internal::CaptureStderr();
+
+    std::string name = "a \"quoted\"\nname";
+
+    LOGI_KV("frame", "ms", 16.5, "fps", 60, "late", false, "name", name, "none", nullptr, "nan", std::nan(""));
+    LOGI_KV("empty");
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(out,
+        "{\"level\":\"I\",\"tag\":\"LoggingTest\",\"msg\":\"frame\",\"ms\":16.5,\"fps\":60,\"late\":false,"
+        "\"name\":\"a \\\"quoted\\\"\\nname\",\"none\":null,\"nan\":null}\n"
+        "{\"level\":\"I\",\"tag\":\"LoggingTest\",\"msg\":\"empty\"}\n");
+}
+
+
+TEST_F(LoggingTest, kvDisabledSiteDoesNotEvaluateArguments) {
+
+    testing::internal::CaptureStderr();
+
+    sideEffectCount = 0;
+
+    LOGD_KV("disabled", "value", sideEffect());
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(out, "");
+    EXPECT_EQ(sideEffectCount, 0);
+}
+
+
+TEST_F(LoggingTest, kvTruncatesLongRecords) {
+
+    testing::internal::CaptureStderr();
+
+    std::string big(3000, 'x');
+
+    LOGW_KV("big", "first", 1, "a", big, "b", big, "last", 2);
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_LT(out.size(), LOG_KV_BUFFER_SIZE);
+    EXPECT_EQ(out.find("{\"level\":\"W\",\"tag\":\"LoggingTest\",\"msg\":\"big\",\"first\":1,\"a\":\"xxx"), 0);
+    EXPECT_EQ(out.find("\"b\""), std::string::npos);
+    EXPECT_EQ(out.find("\"last\""), std::string::npos);
+    EXPECT_EQ(out.substr(out.size() - 19), ",\"truncated\":true}\n");
+}
+
+
+TEST_F(LoggingTest, flightRecorderKeepsDisabledLevels) {
+
+    ASSERT_EQ(StartFlightRecorder(8), OK);
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 20; i++) {
+        LOGD("recorded %d %s", i, "debug");
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(out, "");
+
+    StopFlightRecorder();
+
+    //
+    // not recorded, and arguments are not evaluated any more
+    //
+    sideEffectCount = 0;
+    LOGD("not recorded %d", sideEffect());
+    EXPECT_EQ(sideEffectCount, 0);
+
+    FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    DumpFlightRecorder(fileno(file));
+
+    std::rewind(file);
+
+    std::string dump;
+    char buf[256];
+    while (std::fgets(buf, sizeof(buf), file) != nullptr) {
+        dump += buf;
+    }
+    std::fclose(file);
+
+    std::vector<std::string> lines = split(dump, '\n');
+
+    ASSERT_EQ(lines.size(), 10);
+    EXPECT_EQ(lines[0], "--- flight recorder begin ---");
+    EXPECT_TRUE(std::regex_match(lines[1], std::regex(R"(\d+\.\d{6} T\d+ D/LoggingTest: recorded 12 debug)"))) << lines[1];
+    EXPECT_NE(lines[8].find("D/LoggingTest: recorded 19 debug"), std::string::npos);
+    EXPECT_EQ(lines[9], "--- flight recorder end ---");
+}
+
+
+//
+// recurse until the stack runs out
+//
+static int overflowStack(volatile char *prev, size_t depth) { // NOLINT(misc-no-recursion)
+
+    volatile char frame[1024];
+    frame[0] = *prev;
+
+    if (depth == 0) {
+        return 0;
+    }
+
+    return overflowStack(frame, depth - 1) + frame[0];
+}
+
+static void previousSignalHandler(int sig) {
+
+    (void)sig;
+
+    static const char MESSAGE[] = "previous handler\n";
+    (void)!::write(STDERR_FILENO, MESSAGE, sizeof(MESSAGE) - 1);
+
+    ::_exit(7);
+}
+
+static void crashWithStackOverflow() {
+
+    (void)StartFlightRecorder(8);
+    InstallFlightRecorderSignalHandlers();
+
+    LOGD("before the overflow %d", 42);
+
+    volatile char start = 0;
+    overflowStack(&start, SIZE_MAX);
+}
+
+static void crashWithPreviousHandler() {
+
+    struct sigaction action = {};
+    action.sa_handler = previousSignalHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, nullptr);
+
+    //
+    // installing twice still chains to the handler from before
+    //
+    (void)StartFlightRecorder(8);
+    InstallFlightRecorderSignalHandlers();
+    InstallFlightRecorderSignalHandlers();
+
+    LOGD("before the signal");
+
+    std::raise(SIGSEGV);
+}
+
+TEST_F(LoggingTest, flightRecorderDumpsOnStackOverflow) {
+
+    EXPECT_DEATH(crashWithStackOverflow(), "before the overflow 42");
+}
+
+TEST_F(LoggingTest, flightRecorderChainsToPreviousHandler) {
+
+    EXPECT_EXIT(crashWithPreviousHandler(), testing::ExitedWithCode(7), "before the signal(.|\n)*flight recorder end(.|\n)*previous handler");
+}
+
+
+TEST_F(LoggingTest, flightRecorderConcurrentWriters) {
+
+    ASSERT_EQ(StartFlightRecorder(8), OK);
+
+    //
+    // many laps of a small ring, so that writers keep landing on the same slots
+    //
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 2000; i++) {
+                LOGD("writer %d record %d value %.3f", t, i, i * 0.5);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    StopFlightRecorder();
+
+    FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    DumpFlightRecorder(fileno(file));
+
+    std::rewind(file);
+
+    std::string dump;
+    char buf[256];
+    while (std::fgets(buf, sizeof(buf), file) != nullptr) {
+        dump += buf;
+    }
+    std::fclose(file);
+
+    std::vector<std::string> lines = split(dump, '\n');
+
+    ASSERT_GE(lines.size(), 2);
+    EXPECT_LE(lines.size(), 10);
+
+    //
+    // every record that was dumped is whole
+    //
+    std::regex record(R"(\d+\.\d{6} T\d+ D/LoggingTest: writer (\d) record (\d+) value (\d+\.\d{3}))");
+
+    for (size_t i = 1; i + 1 < lines.size(); i++) {
+        std::smatch m;
+        ASSERT_TRUE(std::regex_match(lines[i], m, record)) << lines[i];
+        EXPECT_DOUBLE_EQ(std::stod(m[3].str()), std::stoi(m[2].str()) * 0.5);
+    }
+}
+
+
+static int capturedCount = 0;
+
+static void countCaptured(std::string_view message) {
+    (void)message;
+    capturedCount++;
+}
+
+TEST_F(LoggingTest, firstN) {
+
+    capturedCount = 0;
+    SetUnusualMessageCapturer(countCaptured);
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 10; i++) {
+        LOGE_andCaptureUnusual_FIRST_N(2, "first 2: %d", i);
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_NE(lines[0].find("first 2: 0"), std::string::npos);
+    EXPECT_NE(lines[1].find("first 2: 1"), std::string::npos);
+
+    EXPECT_EQ(capturedCount, 2);
+
+    SetUnusualMessageCapturer(nullptr);
+}
+
+
+static std::string lastCaptured;
+
+static void logAndKeepCaptured(std::string_view message) {
+
+    //
+    // logging from the capturer must not overwrite message
+    //
+    LOGI("capturer saw %zu bytes", message.size());
+
+    lastCaptured = message;
+}
+
+TEST_F(LoggingTest, captureFormatsOnce) {
+
+    SetUnusualMessageCapturer(logAndKeepCaptured);
+    SetLogPrefix(LOGPREFIX_LEVEL | LOGPREFIX_TAG);
+
+    testing::internal::CaptureStderr();
+
+    LOGE_andCaptureUnusual("bad value %s %d", "abc", 42);
+
+    std::string captured1 = lastCaptured;
+
+    std::string big(2000, 'y');
+
+    LOGW_andCaptureUnusual("long %s end", big.c_str());
+
+    std::string captured2 = lastCaptured;
+
+    SetLogPrefix(LOGPREFIX_NONE);
+    SetUnusualMessageCapturer(nullptr);
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(captured1, "bad value abc 42");
+    EXPECT_EQ(captured2, "long " + big + " end");
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 4) << out;
+    EXPECT_EQ(lines[0], "E/LoggingTest: bad value abc 42");
+    EXPECT_EQ(lines[1], "I/LoggingTest: capturer saw 16 bytes");
+    EXPECT_EQ(lines[2], "W/LoggingTest: long " + big + " end");
+    EXPECT_EQ(lines[3], "I/LoggingTest: capturer saw 2009 bytes");
+}
+
+
+TEST_F(LoggingTest, everyMillis) {
+
+    testing::internal::CaptureStderr();
+
+    for (int j = 0; j < 2; j++) {
+
+        for (int i = 0; i < 5; i++) {
+            LOGI_EVERY_MS(200, "every 200ms: %d %d", j, i);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 3);
+    EXPECT_NE(lines[0].find("every 200ms: 0 0"), std::string::npos);
+    EXPECT_NE(lines[1].find("suppressed 4 messages"), std::string::npos);
+    EXPECT_NE(lines[2].find("every 200ms: 1 0"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, sharedMemoryRing) {
+
+    std::string name = "/common-test-" + std::to_string(::getpid());
+
+    ASSERT_EQ(StartSharedMemoryLogging(name.c_str(), 8), OK);
+
+    for (int i = 0; i < 10; i++) {
+        LOGI("shm line %d", i);
+    }
+    LOGD("not written");
+
+    std::string big(LOG_SHM_TEXT_SIZE + 10, 'z');
+    LOGW("%s", big.c_str());
+
+    SharedMemoryLogReader reader;
+    ASSERT_EQ(reader.open(name.c_str()), OK);
+
+    std::vector<SharedMemoryLogRecord> records;
+    std::vector<std::string> texts;
+
+    uint64_t lost = reader.poll([&](const SharedMemoryLogRecord &r) {
+        records.push_back(r);
+        texts.emplace_back(r.text);
+    }, true);
+
+    EXPECT_EQ(lost, 0);
+
+    //
+    // 11 records in a ring of 8
+    //
+    ASSERT_EQ(records.size(), 8);
+    EXPECT_EQ(texts[0], "shm line 3");
+    EXPECT_EQ(texts[6], "shm line 9");
+    EXPECT_EQ(records[0].level, LOGLEVEL_INFO);
+    EXPECT_EQ(records[0].pid, static_cast<uint32_t>(::getpid()));
+    EXPECT_EQ(records[0].thread, LogThreadNumber());
+    EXPECT_FALSE(records[0].truncated);
+    EXPECT_EQ(texts[7], big.substr(0, LOG_SHM_TEXT_SIZE));
+    EXPECT_TRUE(records[7].truncated);
+
+    LOGI("after the first poll");
+
+    texts.clear();
+    reader.poll([&](const SharedMemoryLogRecord &r) {
+        texts.emplace_back(r.text);
+    }, false);
+
+    ASSERT_EQ(texts.size(), 1);
+    EXPECT_EQ(texts[0], "after the first poll");
+
+    StopSharedMemoryLogging();
+
+    EXPECT_EQ(RemoveSharedMemoryLog(name.c_str()), OK);
+}
+
+
+TEST_F(LoggingTest, sharedMemoryConcurrentWriters) {
+
+    std::string name = "/common-test-concurrent-" + std::to_string(::getpid());
+
+    ASSERT_EQ(StartSharedMemoryLogging(name.c_str(), 8), OK);
+
+    SharedMemoryLogReader reader;
+    ASSERT_EQ(reader.open(name.c_str()), OK);
+
+    //
+    // many laps of a small ring, so that writers keep landing on the same slots
+    //
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 2000; i++) {
+                LOGI("writer %d record %d check %d", t, i, (t * 100000) + i);
+            }
+        });
+    }
+
+    //
+    // every record that is read is whole
+    //
+    std::regex record(R"(writer (\d) record (\d+) check (\d+))");
+    size_t read = 0;
+    bool whole = true;
+
+    auto check = [&](const SharedMemoryLogRecord &r) {
+        std::string text(r.text);
+        std::smatch m;
+        if (r.tag != "LoggingTest" || !std::regex_match(text, m, record) ||
+                std::stoi(m[3].str()) != (std::stoi(m[1].str()) * 100000) + std::stoi(m[2].str())) {
+            ADD_FAILURE() << r.tag << ": " << text;
+            whole = false;
+        }
+        read++;
+    };
+
+    for (int i = 0; i < 100; i++) {
+        reader.poll(check, true);
+        std::this_thread::yield();
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    reader.poll(check, true);
+
+    StopSharedMemoryLogging();
+
+    EXPECT_TRUE(whole);
+    EXPECT_GT(read, 0u);
+
+    EXPECT_EQ(RemoveSharedMemoryLog(name.c_str()), OK);
+}
+
+
+static LogLevelCounts countsFor(const std::vector<LogTagStats> &stats, const char *tag, int level) {
+
+    for (const LogTagStats &s : stats) {
+        if (s.tag == tag) {
+            return s.levels[level - LOGLEVEL_FATAL];
+        }
+    }
+
+    return {};
+}
+
+TEST_F(LoggingTest, statsCountMessagesBytesAndSuppressed) {
+
+    StartLogStats();
+
+    sideEffectCount = 0;
+
+    std::vector<LogTagStats> before = GetLogStats();
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 3; i++) {
+        LOGI("counted %d", i);
+        LOGD("suppressed %d", sideEffect());
+    }
+
+    std::thread t([]() {
+        LOGW("from a thread that exits");
+    });
+    t.join();
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<LogTagStats> after = GetLogStats();
+
+    StopLogStats();
+
+    LogLevelCounts info0 = countsFor(before, "LoggingTest", LOGLEVEL_INFO);
+    LogLevelCounts info1 = countsFor(after, "LoggingTest", LOGLEVEL_INFO);
+    LogLevelCounts debug0 = countsFor(before, "LoggingTest", LOGLEVEL_DEBUG);
+    LogLevelCounts debug1 = countsFor(after, "LoggingTest", LOGLEVEL_DEBUG);
+    LogLevelCounts warn0 = countsFor(before, "LoggingTest", LOGLEVEL_WARN);
+    LogLevelCounts warn1 = countsFor(after, "LoggingTest", LOGLEVEL_WARN);
+
+    EXPECT_EQ(info1.messages - info0.messages, 3);
+    EXPECT_EQ(info1.bytes - info0.bytes, 3 * std::string("counted 0\n").size());
+    EXPECT_EQ(debug1.messages - debug0.messages, 0);
+    EXPECT_EQ(debug1.suppressed - debug0.suppressed, 3);
+    EXPECT_EQ(sideEffectCount, 0);
+    EXPECT_EQ(warn1.messages - warn0.messages, 1);
+
+    EXPECT_EQ(out.size(), 3 * std::string("counted 0\n").size() + std::string("from a thread that exits\n").size());
+}
+
+
+TEST_F(LoggingTest, prefix) {
+
+    testing::internal::CaptureStderr();
+
+    SetLogPrefix(LOGPREFIX_THREAD | LOGPREFIX_LEVEL | LOGPREFIX_TAG);
+    LOGW("with thread, level, and tag");
+
+    SetLogPrefix(LOGPREFIX_LEVEL);
+    LOGI("with level");
+
+    SetLogPrefix(LOGPREFIX_WALLTIME | LOGPREFIX_UPTIME);
+    LOGI("with times");
+
+    SetLogPrefix(LOGPREFIX_ALL);
+    LOGI_KV("kv is not prefixed");
+
+    SetLogPrefix(LOGPREFIX_NONE);
+    LOGI("without prefix");
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 5);
+    EXPECT_EQ(lines[0], "T" + std::to_string(LogThreadNumber()) + " W/LoggingTest: with thread, level, and tag");
+    EXPECT_EQ(lines[1], "I: with level");
+    EXPECT_TRUE(std::regex_match(lines[2], std::regex(R"(\d{4}-\d\d-\d\d \d\d:\d\d:\d\d\.\d{3} \d+\.\d{6} with times)"))) << lines[2];
+    EXPECT_EQ(lines[3].find("{\"level\":\"I\""), 0);
+    EXPECT_EQ(lines[4], "without prefix");
+}
+
+
+TEST_F(LoggingTest, rateLimitedDisabledSiteDoesNotCount) {
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 5; i++) {
+        if (i == 3) {
+            SetLogLevelForTag(TAG, LOGLEVEL_DEBUG);
+        }
+        LOGD_FIRST_N(1, "debug first 1: %d", i);
+    }
+
+    ClearLogLevelForTag(TAG);
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_NE(lines[0].find("debug first 1: 3"), std::string::npos);
+}
+
+
+static void LogFromOtherTag();
+static void TraceFromOtherTag();
+static void LogFromOtherTagLater();
+
+
+TEST_F(LoggingTest, tagLevelOverridesGlobal) {
+
+    testing::internal::CaptureStderr();
+
+    LOGD("from LoggingTest");
+    LogFromOtherTag();
+
+    SetLogLevelForTag("LoggingOtherTest", LOGLEVEL_DEBUG);
+
+    LOGD("from LoggingTest");
+    LogFromOtherTag();
+
+    ClearLogLevelForTag("LoggingOtherTest");
+
+    LOGD("from LoggingTest");
+    LogFromOtherTag();
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_NE(lines[0].find("from LoggingOtherTest"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, disabledSiteDoesNotEvaluateArguments) {
+
+    sideEffectCount = 0;
+
+    testing::internal::CaptureStderr();
+
+    for (int i = 0; i < 10; i++) {
+        LOGD("value %d", sideEffect());
+    }
+
+    SetLogLevelForTag(TAG, LOGLEVEL_DEBUG);
+
+    LOGD("value %d", sideEffect());
+
+    ClearLogLevelForTag(TAG);
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(sideEffectCount, 1);
+    EXPECT_NE(out.find("value 1"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, entryExitFollowsTagLevel) {
+
+    testing::internal::CaptureStderr();
+
+    TraceFromOtherTag();
+
+    SetLogLevelForTag("LoggingOtherTest", LOGLEVEL_TRACE);
+
+    TraceFromOtherTag();
+
+    ClearLogLevelForTag("LoggingOtherTest");
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_NE(lines[0].find("enter TraceFromOtherTag"), std::string::npos);
+    EXPECT_NE(lines[1].find("exit TraceFromOtherTag"), std::string::npos);
+}
+
+
+TEST_F(LoggingTest, tracingRecordsEntryExitSpans) {
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "common_test_trace.json";
+
+    testing::internal::CaptureStderr();
+
+    ASSERT_EQ(StartTracing(), OK);
+
+    TraceFromOtherTag();
+
+    std::thread t(TraceFromOtherTag);
+    t.join();
+
+    StopTracing();
+
+    //
+    // not recorded
+    //
+    TraceFromOtherTag();
+
+    ASSERT_EQ(WriteChromeTrace(path.string().c_str()), OK);
+
+    //
+    // LOGT is disabled, so tracing must not print anything
+    //
+    EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+
+    std::vector<uint8_t> buf;
+    ASSERT_EQ(openFile(path.string().c_str(), buf), OK);
+
+    std::string json(buf.begin(), buf.end());
+
+    EXPECT_EQ(json.find("{\"traceEvents\":["), 0);
+
+    size_t spans = 0;
+    for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos; pos = json.find("\"ph\":\"X\"", pos + 1)) {
+        spans++;
+    }
+    EXPECT_EQ(spans, 2);
+
+    EXPECT_NE(json.find("\"name\":\"TraceFromOtherTag\""), std::string::npos);
+    EXPECT_NE(json.find("\"cat\":\"LoggingOtherTest\""), std::string::npos);
+    EXPECT_EQ(TraceDroppedCount(), 0);
+
+    std::filesystem::remove(path);
+}
+
+
+struct FoundSite {
+    const char *fmt;
+    int line;
+    int enabled;
+};
+
+static void FindSite(void *context, const LogSite *site, int enabled) {
+
+    auto found = static_cast<FoundSite *>(context);
+
+    if (std::strcmp(site->fmt, found->fmt) == 0) {
+        found->line = site->line;
+        found->enabled = enabled;
+    }
+}
+
+
+TEST_F(LoggingTest, dynamicDebugTogglesSitesByPattern) {
+
+    //
+    // added before the site is ever reached
+    //
+    EnableLogSites("LoggingOther*");
+
+    testing::internal::CaptureStderr();
+
+    LogFromOtherTagLater();
+
+    FoundSite found = { "dynamic debug %d" COMMON_LOGGING_C, 0, -1 };
+
+    for (int i = 0; i < 4; i++) {
+
+        if (i == 1) {
+
+            ForEachLogSite(FindSite, &found);
+
+            ASSERT_NE(found.line, 0);
+            EXPECT_EQ(found.enabled, 0);
+
+            //
+            // file:line picks out that one site
+            //
+            std::string fileLine = "TestLogging.cpp:" + std::to_string(found.line);
+            EnableLogSites(fileLine.c_str());
+
+        } else if (i == 2) {
+
+            //
+            // later rules win
+            //
+            DisableLogSites("*");
+
+        } else if (i == 3) {
+
+            ClearLogSiteRules();
+        }
+
+        LOGD("dynamic debug %d", i);
+        LOGD("not this one");
+    }
+
+    //
+    // LOGE is never turned off
+    //
+    DisableLogSites("*");
+
+    LogFromOtherTagLater();
+    LOGI("info off");
+    LOGE("error still on");
+
+    ClearLogSiteRules();
+
+    LogFromOtherTagLater();
+    LOGI("info back on");
+
+    std::string out = testing::internal::GetCapturedStderr();
+
+    std::vector<std::string> lines = split(out, '\n');
+
+    ASSERT_EQ(lines.size(), 4);
+    EXPECT_NE(lines[0].find("later from LoggingOtherTest"), std::string::npos);
+    EXPECT_NE(lines[1].find("dynamic debug 1"), std::string::npos);
+    EXPECT_NE(lines[2].find("error still on"), std::string::npos);
+    EXPECT_NE(lines[3].find("info back on"), std::string::npos);
+}
+
+
+#undef TAG
+#define TAG "LoggingOtherTest"
+
+
+static void LogFromOtherTag() {
+    LOGD("from LoggingOtherTest");
+}
+
+static void TraceFromOtherTag() {
+    LOG_ENTRY_EXIT;
+}
+
+static void LogFromOtherTagLater() {
+    LOGD("later from LoggingOtherTest");
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,271 @@
+// Copyright (C) 2026 by Brenton Bostick
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "common/logging.h"
+#include "common/printf_args.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <clocale>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+
+#define TAG "PrintfArgsTest"
+
+
+class PrintfArgsTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+
+//        SetLogLevel(LOGLEVEL_TRACE);
+        SetLogLevel(LOGLEVEL_INFO);
+//        SetLogLevel(LOGLEVEL_ERROR);
+    }
+    
+    static void TearDownTestSuite() {
+        
+    }
+    
+    void SetUp() override {
+        
+    }
+    
+    void TearDown() override {
+
+    }
+};
+
+
+//
+// encode, format the encoded bytes, and compare with vsnprintf
+//
+static void ExpectRoundTripV(bool signalSafe, const char *fmt, va_list args) {
+
+    PrintfSpec specs[16];
+    size_t count = ParsePrintfFormat(fmt, specs, 16);
+    ASSERT_LE(count, 16);
+
+    va_list args2;
+    va_copy(args2, args);
+
+    char expected[512];
+    std::vsnprintf(expected, sizeof(expected), fmt, args);
+
+    uint8_t encoded[1024];
+    bool overflow;
+    size_t len = EncodePrintfArgs(specs, count, args2, encoded, sizeof(encoded), &overflow);
+
+    va_end(args2);
+
+    ASSERT_FALSE(overflow);
+
+    char actual[512];
+    size_t n = signalSafe ?
+        FormatEncodedPrintfArgsSignalSafe(fmt, specs, count, encoded, len, actual, sizeof(actual)) :
+        FormatEncodedPrintfArgs(fmt, specs, count, encoded, len, actual, sizeof(actual));
+
+    EXPECT_EQ(std::string(actual), std::string(expected));
+    EXPECT_EQ(n, std::string(expected).size());
+}
+
+static void ExpectRoundTrip(const char *fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    ExpectRoundTripV(false, fmt, args);
+    va_end(args);
+}
+
+//
+// only for formats without flags or width, which the signal-safe formatter ignores
+//
+static void ExpectSignalSafeRoundTrip(const char *fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    ExpectRoundTripV(true, fmt, args);
+    va_end(args);
+}
+
+
+TEST_F(PrintfArgsTest, roundTrip) {
+
+    ExpectRoundTrip("no args");
+    ExpectRoundTrip("100%% done");
+    ExpectRoundTrip("%d %i %u %x %X %o %c", -5, 7, 8u, 255u, 255u, 8u, 'z');
+    ExpectRoundTrip("%ld %lld %zu %jd %td", -5L, -6LL, static_cast<size_t>(7), static_cast<intmax_t>(8), static_cast<ptrdiff_t>(-9));
+    ExpectRoundTrip("%f %.3e %10.2g %a", 1.5, 12345.678, 0.000123, 2.0);
+    ExpectRoundTrip("[%s] [%10s] [%-4s] [%.2s]", "abc", "right", "l", "truncated");
+    ExpectRoundTrip("%*d|%-*.*f|", 6, 42, 10, 3, 3.14159);
+    ExpectRoundTrip("%hhd %hd", 65, 1234);
+    ExpectRoundTrip("trailing text after %d args\n", 1);
+}
+
+TEST_F(PrintfArgsTest, signalSafeRoundTrip) {
+
+    int x = 0;
+
+    ExpectSignalSafeRoundTrip("no args");
+    ExpectSignalSafeRoundTrip("100%% done");
+    ExpectSignalSafeRoundTrip("%d %i %u %x %X %o %c", -5, 7, 8u, 255u, 255u, 8u, 'z');
+    ExpectSignalSafeRoundTrip("%d %u %x", INT32_MIN, UINT32_MAX, -1);
+    ExpectSignalSafeRoundTrip("%ld %lld %llu %zu %jd %td %lx", -5L, INT64_MIN, UINT64_MAX, static_cast<size_t>(7), static_cast<intmax_t>(8), static_cast<ptrdiff_t>(-9), -1L);
+    ExpectSignalSafeRoundTrip("%f %.3e %.2g %G %.0f", 1.5, 12345.678, 0.000123, 1e20, 2.5);
+    ExpectSignalSafeRoundTrip("[%s] [%.2s] [%.10s]", "abc", "truncated", "short");
+    ExpectSignalSafeRoundTrip("%p", static_cast<void *>(&x));
+    ExpectSignalSafeRoundTrip("trailing text after %d args\n", 1);
+}
+
+TEST_F(PrintfArgsTest, overflow) {
+
+    PrintfSpec specs[4];
+    size_t count = ParsePrintfFormat("%s", specs, 4);
+
+    EXPECT_EQ(count, 1);
+    EXPECT_EQ(specs[0].kind, PrintfArgKind::STRING);
+
+    count = ParsePrintfFormat("%d %d %d %d %d %d", specs, 4);
+
+    EXPECT_EQ(count, 6);
+}
+
+//
+// format with FormatPrintfV and compare with vsnprintf, into a big buffer and into a small one
+//
+static void ExpectFormatsLikeVsnprintf(const PrintfFormat *format, const char *fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    va_list args2;
+    va_copy(args2, args);
+    va_list args3;
+    va_copy(args3, args);
+    va_list args4;
+    va_copy(args4, args);
+
+    char expected[512];
+    int expectedLen = std::vsnprintf(expected, sizeof(expected), fmt, args);
+
+    char actual[512];
+    int actualLen = FormatPrintfV(actual, sizeof(actual), fmt, format, args2);
+
+    EXPECT_EQ(std::string(actual), std::string(expected));
+    EXPECT_EQ(actualLen, expectedLen);
+
+    char expectedSmall[8];
+    std::vsnprintf(expectedSmall, sizeof(expectedSmall), fmt, args3);
+
+    char actualSmall[8];
+    FormatPrintfV(actualSmall, sizeof(actualSmall), fmt, format, args4);
+
+    EXPECT_EQ(std::string(actualSmall), std::string(expectedSmall));
+
+    va_end(args4);
+    va_end(args3);
+    va_end(args2);
+    va_end(args);
+}
+
+#define EXPECT_FORMATS_LIKE_VSNPRINTF(fmt, ...) \
+    do { \
+        static constexpr auto parsed = ParsePrintfFormatStatic<ParsePrintfFormat(fmt, nullptr, 0)>(fmt); \
+        static constexpr PrintfFormat format = parsed.format(); \
+        ExpectFormatsLikeVsnprintf(&format, fmt __VA_OPT__(,) __VA_ARGS__); \
+    } while (false)
+
+
+static_assert(ParsePrintfFormat("%d %s %%", nullptr, 0) == 3);
+static_assert(ParsePrintfFormatStatic<1>("%.3f").specs[0].precision == 3);
+static_assert(ParsePrintfFormatStatic<1>("%.3f").specs[0].plain);
+static_assert(!ParsePrintfFormatStatic<1>("%5d").specs[0].plain);
+static_assert(!ParsePrintfFormatStatic<1>("%hd").specs[0].plain);
+static_assert(ParsePrintfFormatStatic<1>("%zu").direct);
+static_assert(!ParsePrintfFormatStatic<1>("%n").direct);
+static_assert(!ParsePrintfFormatStatic<1>("%1$d").direct);
+static_assert(!ParsePrintfFormatStatic<0>("trailing %").direct);
+
+
+TEST_F(PrintfArgsTest, parsedFormatMatchesVsnprintf) {
+
+    const char *null = nullptr;
+
+    EXPECT_FORMATS_LIKE_VSNPRINTF("no args");
+    EXPECT_FORMATS_LIKE_VSNPRINTF("100%% done\n");
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%d %i %u %x %X %o %c", -5, 7, 8u, 0xabcu, 0xabcu, 8u, 'z');
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%d %d %u", INT32_MIN, INT32_MAX, UINT32_MAX);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%ld %lld %llu %zu %zd %jd %td %lx", -5L, INT64_MIN, UINT64_MAX, SIZE_MAX,
+        static_cast<ptrdiff_t>(-7), static_cast<intmax_t>(8), static_cast<ptrdiff_t>(-9), -1L);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%f %F %e %E %g %G", 1.5, -2.25, 12345.678, 0.000123, 1e-5, 1e20);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%.0f %.3f %.10e %.0e %.1g %.0g %.17g", 2.5, 3.14159, 1.0 / 3, 15.0, 0.15, 123.0, 0.1);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%f %g %e %F %G", INFINITY, -INFINITY, NAN, INFINITY, -NAN);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%f %g %f", -0.0, 0.0, 1e300);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%a %A", 2.0, 0.5);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("[%s] [%10s] [%-4s] [%.2s] [%.10s] [%s]", "abc", "right", "l", "truncated", "short", null);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%*d|%-*.*f|%+d|% d|%05d|%#x|%.3d", 6, 42, 10, 3, 3.14159, 5, 5, -5, 255u, 7);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%hhd %hd %hhu", 300, 70000, 257);
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%p %Lf %lc %ls", static_cast<void *>(&null), 1.25L, static_cast<wint_t>('w'), L"wide");
+    EXPECT_FORMATS_LIKE_VSNPRINTF("frame ms=%f fps=%d name=%s\n", 16.5, 60, "main");
+}
+
+TEST_F(PrintfArgsTest, floatsUseLocaleDecimalPoint) {
+
+    //
+    // any locale with ',' as the decimal point
+    //
+    const char *commaLocales[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "nl_NL.UTF-8" };
+
+    const char *found = nullptr;
+    for (const char *name : commaLocales) {
+        if (std::setlocale(LC_NUMERIC, name) != nullptr) {
+            found = name;
+            break;
+        }
+    }
+
+    if (found == nullptr) {
+        GTEST_SKIP() << "no locale with ',' as the decimal point is installed";
+    }
+
+    EXPECT_FORMATS_LIKE_VSNPRINTF("%f %.3f %e %g", 1.5, 3.14159, 12345.678, 0.25);
+
+    std::setlocale(LC_NUMERIC, "C");
+}
+
+TEST_F(PrintfArgsTest, nullFormatIsVsnprintf) {
+
+    ExpectFormatsLikeVsnprintf(nullptr, "%d %s %.2f", 1, "two", 3.0);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+